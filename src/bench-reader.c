@@ -0,0 +1,108 @@
+/*
+ * Benchmark for the Reader
+ * This feeds the same generated file into the reader at different chunk
+ * sizes and prints the resulting throughput. Throughput is expected to be
+ * largely independent of the chunk size, even if the file contains overlong
+ * lines.
+ */
+
+#undef NDEBUG
+#include <assert.h>
+#include <c-stdaux.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "c-ini.h"
+
+#define BENCH_N_GROUPS (1024U)
+#define BENCH_N_ENTRIES (32U)
+#define BENCH_N_LONG (256U * 1024U)
+
+static char *bench_generate(size_t *n_datap) {
+        char *data = NULL;
+        size_t i, j, n_data = 0;
+        FILE *f;
+
+        f = open_memstream(&data, &n_data);
+        c_assert(f);
+
+        for (i = 0; i < BENCH_N_GROUPS; ++i) {
+                fprintf(f, "[Group %zu]\n", i);
+                fprintf(f, "# comment in group %zu\n", i);
+
+                for (j = 0; j < BENCH_N_ENTRIES; ++j)
+                        fprintf(f, "Key%zu = value of key %zu in group %zu\n", j, j, i);
+
+                /* every now and then, add an overlong line */
+                if (!(i % 256)) {
+                        fputs("Long=", f);
+                        for (j = 0; j < BENCH_N_LONG; ++j)
+                                fputc('a' + j % 26, f);
+                        fputc('\n', f);
+                }
+
+                fputc('\n', f);
+        }
+
+        c_assert(!fclose(f));
+
+        *n_datap = n_data;
+        return data;
+}
+
+static uint64_t bench_now(void) {
+        struct timespec ts;
+
+        c_assert(!clock_gettime(CLOCK_MONOTONIC, &ts));
+        return (uint64_t)ts.tv_sec * UINT64_C(1000000000) + ts.tv_nsec;
+}
+
+static void bench_feed(const char *data, size_t n_data, size_t n_chunk) {
+        _c_cleanup_(c_ini_reader_freep) CIniReader *reader = NULL;
+        _c_cleanup_(c_ini_domain_unrefp) CIniDomain *domain = NULL;
+        uint64_t ts;
+        size_t i, n;
+        int r;
+
+        r = c_ini_reader_new(&reader);
+        c_assert(!r);
+
+        ts = bench_now();
+
+        for (i = 0; i < n_data; i += n) {
+                n = c_min(n_chunk, n_data - i);
+                r = c_ini_reader_feed(reader, (const uint8_t *)data + i, n);
+                c_assert(!r);
+        }
+
+        r = c_ini_reader_seal(reader, &domain);
+        c_assert(!r);
+
+        ts = bench_now() - ts;
+
+        c_assert(c_ini_domain_find(domain, "Group 0", -1));
+
+        if (n_chunk < n_data)
+                fprintf(stderr, "chunk size %10zu: ", n_chunk);
+        else
+                fprintf(stderr, "chunk size %10s: ", "whole");
+
+        fprintf(stderr, "%8.1f MiB/s\n", (double)n_data / (1024 * 1024) / ((double)ts / 1000000000));
+}
+
+int main(int argc, char **argv) {
+        const size_t chunks[] = { 1, 64, 4096, SIZE_MAX };
+        _c_cleanup_(c_freep) char *data = NULL;
+        size_t i, n_data;
+
+        data = bench_generate(&n_data);
+
+        fprintf(stderr, "input size: %zu bytes\n", n_data);
+
+        for (i = 0; i < sizeof(chunks) / sizeof(*chunks); ++i)
+                bench_feed(data, n_data, chunks[i]);
+
+        return 0;
+}
@@ -0,0 +1,171 @@
+/*
+ * Ini-File Arena Allocator
+ *
+ * A domain owns an arena, which all its raw lines, groups, and entries are
+ * allocated from. Objects are never freed individually. Instead, every object
+ * pins the arena via a reference, and the arena releases all its blocks at
+ * once when the last reference is dropped. This avoids the allocation storm
+ * of small objects when parsing, as well as the corresponding teardown work.
+ *
+ * All functions accept a NULL arena, in which case they fall back to the
+ * regular heap allocator.
+ *
+ * Additionally, an arena can take ownership of memory mappings. This allows
+ * objects to borrow data from a mapped file, while the arena keeps the
+ * mapping alive as long as any such object is.
+ */
+
+#include <c-stdaux.h>
+#include <errno.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include "c-ini.h"
+#include "c-ini-private.h"
+
+int c_ini_arena_new(CIniArena **arenap) {
+        CIniArena *arena;
+
+        arena = calloc(1, sizeof(*arena));
+        if (!arena)
+                return -ENOMEM;
+
+        *arena = (CIniArena)C_INI_ARENA_NULL(*arena);
+
+        *arenap = arena;
+        return 0;
+}
+
+static CIniArena *c_ini_arena_free_internal(CIniArena *arena) {
+        CIniArenaMapping *mapping;
+        CIniArenaBlock *block;
+
+        if (!arena)
+                return NULL;
+
+        for (mapping = arena->mappings; mapping; mapping = mapping->next)
+                munmap(mapping->p, mapping->n);
+
+        while ((block = arena->blocks)) {
+                arena->blocks = block->next;
+                free(block);
+        }
+
+        free(arena);
+
+        return NULL;
+}
+
+CIniArena *c_ini_arena_ref(CIniArena *arena) {
+        if (arena)
+                c_ini_ref_inc(&arena->n_refs);
+        return arena;
+}
+
+CIniArena *c_ini_arena_unref(CIniArena *arena) {
+        if (arena && c_ini_ref_dec(&arena->n_refs))
+                c_ini_arena_free_internal(arena);
+        return NULL;
+}
+
+static CIniArenaBlock *c_ini_arena_block_new(size_t n_data) {
+        CIniArenaBlock *block;
+
+        if (n_data > SIZE_MAX - sizeof(*block))
+                return NULL;
+
+        block = calloc(1, sizeof(*block) + n_data);
+        if (!block)
+                return NULL;
+
+        block->n_data = n_data;
+        return block;
+}
+
+void *c_ini_arena_alloc(CIniArena *arena, size_t n) {
+        CIniArenaBlock *block;
+        size_t z;
+        void *p;
+
+        /*
+         * Allocate @n bytes of zeroed memory from the arena. The memory is
+         * suitably aligned for any object and stays valid until the arena is
+         * destroyed. Without an arena, this is a plain heap allocation.
+         */
+
+        if (!arena)
+                return calloc(1, n);
+
+        if (n > SIZE_MAX - _Alignof(max_align_t))
+                return NULL;
+
+        z = c_align_to(n, _Alignof(max_align_t));
+
+        block = arena->blocks;
+        if (!block || block->n_data - block->i_data < z) {
+                if (z > arena->z_next / 4) {
+                        /*
+                         * Oversized allocations get a dedicated block. It is
+                         * linked behind the current block, so the remaining
+                         * space of the current block can still be used.
+                         */
+                        block = c_ini_arena_block_new(z);
+                        if (!block)
+                                return NULL;
+
+                        if (arena->blocks) {
+                                block->next = arena->blocks->next;
+                                arena->blocks->next = block;
+                        } else {
+                                arena->blocks = block;
+                        }
+                } else {
+                        block = c_ini_arena_block_new(arena->z_next);
+                        if (!block)
+                                return NULL;
+
+                        block->next = arena->blocks;
+                        arena->blocks = block;
+
+                        /* grow blocks geometrically, up to a maximum */
+                        if (arena->z_next < C_INI_ARENA_BLOCK_MAX)
+                                arena->z_next *= 2;
+                }
+        }
+
+        p = (uint8_t *)block->data + block->i_data;
+        block->i_data += z;
+        return p;
+}
+
+void c_ini_arena_free(CIniArena *arena, void *p) {
+        /*
+         * Memory of an arena is only released when the arena is destroyed.
+         * Only heap allocations (i.e., without arena) are released here.
+         */
+        if (!arena)
+                free(p);
+}
+
+int c_ini_arena_add_mapping(CIniArena *arena, void *p, size_t n) {
+        CIniArenaMapping *mapping;
+
+        /*
+         * Transfer ownership of the memory mapping at @p of size @n to the
+         * arena. It is unmapped when the arena is destroyed. On failure, the
+         * caller retains ownership.
+         */
+
+        c_assert(arena);
+
+        mapping = c_ini_arena_alloc(arena, sizeof(*mapping));
+        if (!mapping)
+                return -ENOMEM;
+
+        mapping->p = p;
+        mapping->n = n;
+        mapping->next = arena->mappings;
+        arena->mappings = mapping;
+
+        return 0;
+}
@@ -0,0 +1,141 @@
+/*
+ * Ini-File Batch Lookups
+ *
+ * Looking up many keys of a group one by one descends the lookup tree from
+ * its root for every key. A batch lookup instead resolves its keys in tree
+ * order, and continues each search from the entry found for the previous key.
+ * If the next key is close by, it is reached by stepping forward through the
+ * tree. Only if it is not found within a few steps, the tree is descended
+ * again. Dense batches are thus resolved in a single ordered traversal, while
+ * sparse batches never cost more than individual lookups.
+ *
+ * Keys are sorted by the library, unless they already are in tree order. The
+ * results are always reported in the order of the keys.
+ *
+ * Groups with a hash index, and frozen groups, resolve each key via their
+ * index, since those lookups do not descend a tree.
+ */
+
+#include <c-rbtree.h>
+#include <c-stdaux.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include "c-ini.h"
+#include "c-ini-private.h"
+
+#define C_INI_BATCH_STEPS (8U)
+
+static int c_ini_batch_compare(const char *a, size_t n_a, const uint8_t *b, size_t n_b) {
+        /* same order as the lookup trees */
+        if (n_a != n_b)
+                return n_a < n_b ? -1 : 1;
+        return n_a ? memcmp(a, b, n_a) : 0;
+}
+
+static int c_ini_batch_compare_keys(const void *a, const void *b) {
+        const CIniSpan *ka = *(const CIniSpan * const *)a;
+        const CIniSpan *kb = *(const CIniSpan * const *)b;
+
+        return c_ini_batch_compare(ka->data, ka->n_data, (const uint8_t *)kb->data, kb->n_data);
+}
+
+static CRBNode *c_ini_batch_descend(CIniGroup *group, const CIniSpan *key) {
+        CRBNode *iter = group->map_entries.root, *bound = NULL;
+        CIniEntry *entry;
+
+        /* find the leftmost entry not less than @key */
+        while (iter) {
+                entry = c_rbnode_entry(iter, CIniEntry, rb_group);
+                if (c_ini_batch_compare(key->data, key->n_data, entry->key, entry->n_key) > 0) {
+                        iter = iter->right;
+                } else {
+                        bound = iter;
+                        iter = iter->left;
+                }
+        }
+
+        return bound;
+}
+
+static CRBNode *c_ini_batch_advance(CIniGroup *group, CRBNode *node, const CIniSpan *key) {
+        CIniEntry *entry;
+        unsigned int i;
+
+        /*
+         * All entries before @node are less than the previous key, and thus
+         * less than @key. Hence, the first entry not less than @key that is
+         * reached by stepping forward is the leftmost one.
+         */
+        for (i = 0; node && i < C_INI_BATCH_STEPS; ++i) {
+                entry = c_rbnode_entry(node, CIniEntry, rb_group);
+                if (c_ini_batch_compare(key->data, key->n_data, entry->key, entry->n_key) <= 0)
+                        return node;
+
+                node = c_rbnode_next(node);
+        }
+
+        return node ? c_ini_batch_descend(group, key) : NULL;
+}
+
+static void c_ini_batch_resolve(CIniGroup *group,
+                                const CIniSpan * const *sorted,
+                                const CIniSpan *keys,
+                                size_t n_keys,
+                                CIniEntry **entries) {
+        const CIniSpan *key;
+        CIniEntry *entry;
+        CRBNode *node;
+        size_t i;
+
+        node = c_rbtree_first(&group->map_entries);
+        for (i = 0; i < n_keys; ++i) {
+                key = sorted ? sorted[i] : &keys[i];
+                node = c_ini_batch_advance(group, node, key);
+
+                entry = c_rbnode_entry(node, CIniEntry, rb_group);
+                if (entry && c_ini_batch_compare(key->data, key->n_data, entry->key, entry->n_key))
+                        entry = NULL;
+
+                entries[key - keys] = entry;
+        }
+}
+
+_c_public_ int c_ini_group_find_many(CIniGroup *group,
+                                     const CIniSpan *keys,
+                                     size_t n_keys,
+                                     CIniEntry **entries) {
+        _c_cleanup_(c_freep) const CIniSpan **sorted = NULL;
+        size_t i;
+
+        /*
+         * Look up all @keys and store the results in @entries, in the same
+         * order. Keys that are not found yield NULL. Like c_ini_group_find(),
+         * duplicates resolve to the earliest addition.
+         */
+
+        if (c_ini_is_frozen(group) || group->indexed) {
+                for (i = 0; i < n_keys; ++i)
+                        entries[i] = c_ini_group_find(group, keys[i].data, keys[i].n_data);
+                return 0;
+        }
+
+        for (i = 1; i < n_keys; ++i)
+                if (c_ini_batch_compare(keys[i - 1].data, keys[i - 1].n_data,
+                                        (const uint8_t *)keys[i].data, keys[i].n_data) > 0)
+                        break;
+
+        if (i < n_keys) {
+                sorted = malloc(n_keys * sizeof(*sorted));
+                if (!sorted)
+                        return -ENOMEM;
+
+                for (i = 0; i < n_keys; ++i)
+                        sorted[i] = &keys[i];
+
+                qsort(sorted, n_keys, sizeof(*sorted), c_ini_batch_compare_keys);
+        }
+
+        c_ini_batch_resolve(group, sorted, keys, n_keys, entries);
+        return 0;
+}
@@ -0,0 +1,344 @@
+/*
+ * Ini-File Caches
+ *
+ * Parsing a large set of ini-files on every start-up is wasteful if they
+ * rarely change. Instead, a sealed domain can be written to a binary cache
+ * file, which a process maps into memory and queries right away, without any
+ * parsing or per-object allocation. The cache holds the frozen block of the
+ * domain (see c_ini_domain_freeze()), so the loaded domain behaves like any
+ * frozen domain.
+ *
+ * A cache records the size, modification time, and content hash of the source
+ * files it was generated from. When loading a cache, the caller passes the
+ * current list of source files, and the cache is refused with -ESTALE if the
+ * list differs, or if any file changed in size or content. If only the
+ * modification time of a file differs, its content is hashed and compared,
+ * so a touched but otherwise unchanged file does not invalidate the cache.
+ *
+ * Caches are replaced atomically when written, so a process that still maps
+ * the previous version is not affected. The new cache is synced to disk
+ * before it replaces the old one, so a crash never leaves a truncated cache
+ * behind under the final name.
+ */
+
+#include <c-stdaux.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "c-ini.h"
+#include "c-ini-private.h"
+
+static int c_ini_cache_hash_fd(int fd, size_t n_size, uint64_t *hashp) {
+        void *p;
+
+        if (!n_size) {
+                *hashp = c_ini_hash(NULL, 0);
+                return 0;
+        }
+
+        p = mmap(NULL, n_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p == MAP_FAILED)
+                return -errno;
+
+        *hashp = c_ini_hash(p, n_size);
+        munmap(p, n_size);
+        return 0;
+}
+
+static int c_ini_cache_stamp(CIniCacheSource *source, const char *path, const CIniCacheSource *known) {
+        _c_cleanup_(c_closep) int fd = -1;
+        struct stat st;
+        int r;
+
+        /*
+         * Record the current state of the file at @path in @source. If @known
+         * is given, the content hash is only computed if the file differs from
+         * @known in its modification time, but not in its size. Otherwise,
+         * the hash of @known is retained.
+         */
+
+        fd = open(path, O_RDONLY | O_CLOEXEC | O_NOCTTY);
+        if (fd < 0)
+                return -errno;
+
+        if (fstat(fd, &st) < 0)
+                return -errno;
+        if (!S_ISREG(st.st_mode))
+                return -EINVAL;
+        if ((uintmax_t)st.st_size > SIZE_MAX)
+                return -EFBIG;
+
+        source->size = st.st_size;
+        source->mtime_sec = st.st_mtim.tv_sec;
+        source->mtime_nsec = st.st_mtim.tv_nsec;
+
+        if (known && (known->size != source->size ||
+                      (known->mtime_sec == source->mtime_sec &&
+                       known->mtime_nsec == source->mtime_nsec))) {
+                source->hash = known->hash;
+                return 0;
+        }
+
+        r = c_ini_cache_hash_fd(fd, st.st_size, &source->hash);
+        if (r)
+                return r;
+
+        return 0;
+}
+
+static int c_ini_cache_write_all(int fd, const void *data, size_t n_data) {
+        const uint8_t *p = data;
+        ssize_t l;
+
+        while (n_data) {
+                l = write(fd, p, n_data);
+                if (l < 0) {
+                        if (errno == EINTR)
+                                continue;
+                        return -errno;
+                }
+
+                p += l;
+                n_data -= l;
+        }
+
+        return 0;
+}
+
+static int c_ini_cache_serialize(CIniDomain *domain,
+                                 const char * const *sources,
+                                 void **headp,
+                                 size_t *n_headp,
+                                 void **frozenp,
+                                 size_t *n_frozenp) {
+        _c_cleanup_(c_ini_freep) void *head = NULL, *frozen = NULL;
+        CIniCacheHeader *header;
+        CIniCacheSource *source;
+        size_t i, n_sources = 0, n_head, n_frozen, i_path;
+        int r;
+
+        /* serialize the frozen block, without back-pointer */
+
+        if (domain->frozen) {
+                n_frozen = domain->frozen->n_size;
+                frozen = malloc(n_frozen);
+                if (!frozen)
+                        return -ENOMEM;
+
+                c_memcpy(frozen, domain->frozen, n_frozen);
+        } else {
+                r = c_ini_frozen_measure(domain, &n_frozen);
+                if (r)
+                        return r;
+
+                frozen = calloc(1, n_frozen);
+                if (!frozen)
+                        return -ENOMEM;
+
+                r = c_ini_frozen_fill(domain, frozen, n_frozen);
+                if (r)
+                        return r;
+        }
+
+        ((CIniFrozen *)frozen)->domain = NULL;
+
+        /* serialize header, source stamps, and paths */
+
+        n_head = sizeof(*header);
+        for (i = 0; sources && sources[i]; ++i) {
+                n_head += sizeof(*source) + strlen(sources[i]) + 1;
+                ++n_sources;
+        }
+        if (n_sources > UINT32_MAX)
+                return -E2BIG;
+        n_head = c_align_to(n_head, _Alignof(max_align_t));
+
+        head = calloc(1, n_head);
+        if (!head)
+                return -ENOMEM;
+
+        header = head;
+        *header = (CIniCacheHeader){
+                .signature = C_INI_CACHE_SIGNATURE,
+                .version = C_INI_CACHE_VERSION,
+                .byteorder = C_INI_CACHE_BYTEORDER,
+                .wordsize = sizeof(unsigned long),
+                .n_sources = n_sources,
+                .sources = sizeof(*header),
+                .frozen = n_head,
+                .n_frozen = n_frozen,
+        };
+
+        source = (CIniCacheSource *)(header + 1);
+        i_path = sizeof(*header) + n_sources * sizeof(*source);
+        for (i = 0; i < n_sources; ++i, ++source) {
+                r = c_ini_cache_stamp(source, sources[i], NULL);
+                if (r)
+                        return r;
+
+                source->path = i_path;
+                source->n_path = strlen(sources[i]);
+                c_memcpy((uint8_t *)head + i_path, sources[i], source->n_path);
+                i_path += source->n_path + 1;
+        }
+
+        *headp = head;
+        *n_headp = n_head;
+        *frozenp = frozen;
+        *n_frozenp = n_frozen;
+        head = NULL;
+        frozen = NULL;
+        return 0;
+}
+
+_c_public_ int c_ini_domain_write_cache(CIniDomain *domain, const char *path, const char * const *sources) {
+        _c_cleanup_(c_ini_freep) void *head = NULL, *frozen = NULL;
+        _c_cleanup_(c_ini_freep) char *tmp = NULL;
+        _c_cleanup_(c_closep) int fd = -1;
+        size_t n_head, n_frozen;
+        int r;
+
+        /*
+         * The stamps of the sources are taken now, so the caller should write
+         * the cache right after parsing the sources. If a source is modified
+         * in between, the cache records the new state, yet holds the old data.
+         */
+
+        r = c_ini_cache_serialize(domain, sources, &head, &n_head, &frozen, &n_frozen);
+        if (r)
+                return r;
+
+        r = asprintf(&tmp, "%s.XXXXXX", path);
+        if (r < 0) {
+                tmp = NULL;
+                return -ENOMEM;
+        }
+
+        fd = mkostemp(tmp, O_CLOEXEC);
+        if (fd < 0)
+                return -errno;
+
+        r = 0;
+        if (fchmod(fd, 0644) < 0)
+                r = -errno;
+        if (!r)
+                r = c_ini_cache_write_all(fd, head, n_head);
+        if (!r)
+                r = c_ini_cache_write_all(fd, frozen, n_frozen);
+        if (!r && fsync(fd) < 0)
+                r = -errno;
+        if (!r && rename(tmp, path) < 0)
+                r = -errno;
+        if (r) {
+                unlink(tmp);
+                return r;
+        }
+
+        return 0;
+}
+
+static int c_ini_cache_verify(const uint8_t *p, size_t n, const char * const *sources) {
+        static const uint8_t signature[] = C_INI_CACHE_SIGNATURE;
+        const CIniCacheHeader *header = (const CIniCacheHeader *)p;
+        const CIniCacheSource *known;
+        CIniCacheSource source;
+        size_t i;
+        int r;
+
+        if (n < sizeof(*header) || memcmp(header->signature, signature, sizeof(signature)))
+                return -EBADMSG;
+
+        /* caches of other versions or machines are simply regenerated */
+        if (header->version != C_INI_CACHE_VERSION ||
+            header->byteorder != C_INI_CACHE_BYTEORDER ||
+            header->wordsize != sizeof(unsigned long))
+                return -ESTALE;
+
+        if (header->sources != sizeof(*header) ||
+            header->n_sources > (n - header->sources) / sizeof(*known) ||
+            header->frozen % _Alignof(max_align_t) ||
+            header->frozen > n ||
+            header->n_frozen != n - header->frozen ||
+            !c_ini_frozen_verify((const CIniFrozen *)(p + header->frozen), header->n_frozen))
+                return -EBADMSG;
+
+        known = (const CIniCacheSource *)(p + header->sources);
+        for (i = 0; sources && sources[i]; ++i, ++known) {
+                if (i >= header->n_sources)
+                        return -ESTALE;
+
+                if (known->path >= n || known->n_path >= n - known->path ||
+                    p[known->path + known->n_path])
+                        return -EBADMSG;
+
+                if (strcmp((const char *)p + known->path, sources[i]))
+                        return -ESTALE;
+
+                r = c_ini_cache_stamp(&source, sources[i], known);
+                if (r == -ENOENT)
+                        return -ESTALE;
+                else if (r)
+                        return r;
+
+                if (source.size != known->size || source.hash != known->hash)
+                        return -ESTALE;
+        }
+
+        if (i != header->n_sources)
+                return -ESTALE;
+
+        return 0;
+}
+
+_c_public_ int c_ini_domain_load_cache(CIniDomain **domainp, const char *path, const char * const *sources) {
+        _c_cleanup_(c_ini_arena_unrefp) CIniArena *arena = NULL;
+        _c_cleanup_(c_closep) int fd = -1;
+        const CIniCacheHeader *header;
+        struct stat st;
+        size_t n;
+        void *p;
+        int r;
+
+        fd = open(path, O_RDONLY | O_CLOEXEC | O_NOCTTY);
+        if (fd < 0)
+                return -errno;
+
+        if (fstat(fd, &st) < 0)
+                return -errno;
+        if (!S_ISREG(st.st_mode))
+                return -EINVAL;
+        if ((uintmax_t)st.st_size > SIZE_MAX)
+                return -EFBIG;
+        if ((size_t)st.st_size < sizeof(*header))
+                return -EBADMSG;
+
+        n = st.st_size;
+
+        /*
+         * The mapping is private and writable, since the frozen block carries
+         * a back-pointer to its domain. Only the page that holds it is ever
+         * copied, everything else stays shared with the page cache.
+         */
+        p = mmap(NULL, n, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        if (p == MAP_FAILED)
+                return -errno;
+
+        r = c_ini_cache_verify(p, n, sources);
+        if (!r)
+                r = c_ini_arena_new(&arena);
+        if (!r)
+                r = c_ini_arena_add_mapping(arena, p, n);
+        if (r) {
+                munmap(p, n);
+                return r;
+        }
+
+        header = p;
+        return c_ini_domain_new_frozen(domainp, arena, (CIniFrozen *)((uint8_t *)p + header->frozen));
+}
@@ -0,0 +1,81 @@
+/*
+ * Ini-File Callbacks
+ *
+ * Consumers that stream a file once, to pick out a few values or to forward
+ * entries into their own structures, have no use for a domain. If callbacks
+ * are set on a reader, each complete line is classified by the same logic
+ * as for domains, and then reported to the callbacks right away. No raw
+ * lines, groups, or entries are created, so memory use is bounded by the
+ * longest line, regardless of the size of the input.
+ *
+ * Only C_INI_MODE_EXTENDED_WHITESPACE affects callbacks. Duplicate groups and
+ * entries are reported as they appear, and it is up to the callbacks to merge
+ * or discard them. Blank lines are not reported.
+ */
+
+#include <c-stdaux.h>
+#include <stdlib.h>
+#include "c-ini.h"
+#include "c-ini-private.h"
+
+_c_public_ void c_ini_reader_set_callbacks(CIniReader *reader, const CIniCallbacks *callbacks, void *userdata) {
+        /*
+         * Set the callbacks to report lines to, or NULL to build a domain
+         * again. The callbacks are referenced, not copied. They must not be
+         * changed in the middle of a parsing round.
+         */
+        c_assert(!reader->domain && !reader->n_line);
+
+        reader->callbacks = callbacks;
+        reader->userdata = userdata;
+}
+
+static int c_ini_reader_dispatch_line(CIniReader *reader, const uint8_t *data, size_t n_data, const CIniLine *line) {
+        const CIniCallbacks *callbacks = reader->callbacks;
+
+        switch (line->type) {
+        case C_INI_LINE_GROUP:
+                if (!callbacks->group)
+                        return 0;
+
+                return callbacks->group((const char *)data + line->i_key,
+                                        line->n_key,
+                                        reader->userdata);
+        case C_INI_LINE_ENTRY:
+                if (!callbacks->entry)
+                        return 0;
+
+                return callbacks->entry((const char *)data + line->i_key,
+                                        line->n_key,
+                                        (const char *)data + line->i_value,
+                                        line->n_value,
+                                        reader->userdata);
+        case C_INI_LINE_COMMENT:
+                if (!callbacks->comment)
+                        return 0;
+
+                return callbacks->comment((const char *)data + line->i_value,
+                                          line->n_value,
+                                          reader->userdata);
+        case C_INI_LINE_MALFORMED:
+                reader->malformed = true;
+                if (!callbacks->malformed)
+                        return 0;
+
+                /* report the line without its line break */
+                if (n_data && data[n_data - 1] == '\n')
+                        --n_data;
+
+                return callbacks->malformed((const char *)data, n_data, reader->userdata);
+        default:
+                return 0;
+        }
+}
+
+int c_ini_reader_dispatch(CIniReader *reader, const uint8_t *data, size_t n_data, const CIniLine *line) {
+        int r;
+
+        /* positive values must not be mistaken for codes of the library */
+        r = c_ini_reader_dispatch_line(reader, data, n_data, line);
+        return r > 0 ? C_INI_E_CALLBACK : r;
+}
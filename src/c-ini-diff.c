@@ -0,0 +1,283 @@
+/*
+ * Ini-File Domain Diffs
+ *
+ * Two domains are compared by walking their lookup trees in parallel. Both
+ * trees are sorted by the same order, so a single merge pass reports all
+ * added and removed groups in O(n + m). For groups present in both domains,
+ * their entry trees are merged the same way, reporting added, removed, and
+ * changed entries. Frozen domains provide the same order via their sorted
+ * indices.
+ *
+ * The comparison follows lookup semantics: if a domain contains duplicate
+ * groups or entries, only the one returned by a lookup is compared, and the
+ * remaining duplicates are ignored.
+ *
+ * Values of different length are never compared. Otherwise, the hashes of
+ * both values are compared first, and only equal hashes are confirmed by
+ * comparing the values. The hash is computed on first use and cached in the
+ * entry, like its decoded value. Hence, the first diff of a domain reads each
+ * value once more than a plain comparison would. But a domain that is diffed
+ * repeatedly, like the current configuration of a daemon against each of its
+ * reloads, rejects changed values by their cached hash alone. Frozen entries
+ * cannot cache a hash, so their values are compared directly.
+ */
+
+#include <c-rbtree.h>
+#include <c-stdaux.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include "c-ini.h"
+#include "c-ini-private.h"
+
+typedef struct CIniDiffCursor CIniDiffCursor;
+
+struct CIniDiffCursor {
+        CRBNode *node;
+        CIniFrozen *frozen;
+        CIniGroup *frozen_group;
+        size_t i;
+};
+
+#define C_INI_DIFF_CURSOR_NULL(_x) {                                            \
+        }
+
+static void c_ini_diff_cursor_init_groups(CIniDiffCursor *cursor, CIniDomain *domain) {
+        *cursor = (CIniDiffCursor)C_INI_DIFF_CURSOR_NULL(*cursor);
+
+        if (domain->frozen)
+                cursor->frozen = domain->frozen;
+        else
+                cursor->node = c_rbtree_first(&domain->map_groups);
+}
+
+static void c_ini_diff_cursor_init_entries(CIniDiffCursor *cursor, CIniGroup *group) {
+        *cursor = (CIniDiffCursor)C_INI_DIFF_CURSOR_NULL(*cursor);
+
+        if (c_ini_is_frozen(group))
+                cursor->frozen_group = group;
+        else
+                cursor->node = c_rbtree_first(&group->map_entries);
+}
+
+static CIniGroup *c_ini_diff_cursor_group(CIniDiffCursor *cursor) {
+        if (cursor->frozen)
+                return c_ini_frozen_sorted_group(cursor->frozen, cursor->i);
+        return c_rbnode_entry(cursor->node, CIniGroup, rb_domain);
+}
+
+static CIniEntry *c_ini_diff_cursor_entry(CIniDiffCursor *cursor) {
+        if (cursor->frozen_group)
+                return c_ini_frozen_group_sorted_entry(cursor->frozen_group, cursor->i);
+        return c_rbnode_entry(cursor->node, CIniEntry, rb_group);
+}
+
+static void c_ini_diff_cursor_step(CIniDiffCursor *cursor) {
+        if (cursor->node)
+                cursor->node = c_rbnode_next(cursor->node);
+        else
+                ++cursor->i;
+}
+
+static int c_ini_diff_compare(const char *a, size_t n_a, const char *b, size_t n_b) {
+        /* same order as the lookup trees and the frozen indices */
+        if (n_a != n_b)
+                return n_a < n_b ? -1 : 1;
+        return n_a ? memcmp(a, b, n_a) : 0;
+}
+
+static CIniGroup *c_ini_diff_next_group(CIniDiffCursor *cursor, CIniGroup *group) {
+        const char *label, *next_label;
+        size_t n_label, n_next_label;
+        CIniGroup *next;
+
+        /* skip all duplicates of @group, lookups never return those */
+        label = c_ini_group_get_label(group, &n_label);
+        for (;;) {
+                c_ini_diff_cursor_step(cursor);
+                next = c_ini_diff_cursor_group(cursor);
+                if (!next)
+                        return NULL;
+
+                next_label = c_ini_group_get_label(next, &n_next_label);
+                if (c_ini_diff_compare(label, n_label, next_label, n_next_label))
+                        return next;
+        }
+}
+
+static CIniEntry *c_ini_diff_next_entry(CIniDiffCursor *cursor, CIniEntry *entry) {
+        const char *key, *next_key;
+        size_t n_key, n_next_key;
+        CIniEntry *next;
+
+        /* see c_ini_diff_next_group() */
+        key = c_ini_entry_get_key(entry, &n_key);
+        for (;;) {
+                c_ini_diff_cursor_step(cursor);
+                next = c_ini_diff_cursor_entry(cursor);
+                if (!next)
+                        return NULL;
+
+                next_key = c_ini_entry_get_key(next, &n_next_key);
+                if (c_ini_diff_compare(key, n_key, next_key, n_next_key))
+                        return next;
+        }
+}
+
+static uint64_t c_ini_diff_value_hash(CIniEntry *entry) {
+        uint64_t hash;
+
+        /*
+         * A hash of 0 marks an empty cache, so it is never stored. Racing
+         * threads compute the same hash, so relaxed ordering is sufficient.
+         */
+        hash = atomic_load_explicit(&entry->value_hash, memory_order_relaxed);
+        if (!hash) {
+                hash = c_ini_hash(entry->value, entry->n_value) ?: 1;
+                atomic_store_explicit(&entry->value_hash, hash, memory_order_relaxed);
+        }
+
+        return hash;
+}
+
+static bool c_ini_diff_entry_equal(CIniEntry *a, CIniEntry *b) {
+        const char *value_a, *value_b;
+        size_t n_value_a, n_value_b;
+
+        if (a == b)
+                return true;
+
+        value_a = c_ini_entry_get_value(a, &n_value_a);
+        value_b = c_ini_entry_get_value(b, &n_value_b);
+        if (n_value_a != n_value_b)
+                return false;
+
+        if (!c_ini_is_frozen(a) && !c_ini_is_frozen(b) &&
+            c_ini_diff_value_hash(a) != c_ini_diff_value_hash(b))
+                return false;
+
+        return !c_ini_diff_compare(value_a, n_value_a, value_b, n_value_b);
+}
+
+static int c_ini_diff_groups(CIniGroup *old_group,
+                             CIniGroup *new_group,
+                             CIniDiffFn fn,
+                             void *userdata) {
+        CIniDiffCursor old_cursor, new_cursor;
+        CIniEntry *old_entry, *new_entry;
+        const char *old_key, *new_key;
+        size_t n_old_key, n_new_key;
+        int r, cmp;
+
+        if (old_group == new_group)
+                return 0;
+
+        c_ini_diff_cursor_init_entries(&old_cursor, old_group);
+        c_ini_diff_cursor_init_entries(&new_cursor, new_group);
+        old_entry = c_ini_diff_cursor_entry(&old_cursor);
+        new_entry = c_ini_diff_cursor_entry(&new_cursor);
+
+        while (old_entry || new_entry) {
+                if (!old_entry) {
+                        cmp = 1;
+                } else if (!new_entry) {
+                        cmp = -1;
+                } else {
+                        old_key = c_ini_entry_get_key(old_entry, &n_old_key);
+                        new_key = c_ini_entry_get_key(new_entry, &n_new_key);
+                        cmp = c_ini_diff_compare(old_key, n_old_key, new_key, n_new_key);
+                }
+
+                if (cmp < 0) {
+                        r = fn(C_INI_DIFF_ENTRY_REMOVED, old_group, old_entry, new_group, NULL, userdata);
+                        if (r)
+                                return r;
+
+                        old_entry = c_ini_diff_next_entry(&old_cursor, old_entry);
+                } else if (cmp > 0) {
+                        r = fn(C_INI_DIFF_ENTRY_ADDED, old_group, NULL, new_group, new_entry, userdata);
+                        if (r)
+                                return r;
+
+                        new_entry = c_ini_diff_next_entry(&new_cursor, new_entry);
+                } else {
+                        if (!c_ini_diff_entry_equal(old_entry, new_entry)) {
+                                r = fn(C_INI_DIFF_ENTRY_CHANGED, old_group, old_entry, new_group, new_entry, userdata);
+                                if (r)
+                                        return r;
+                        }
+
+                        old_entry = c_ini_diff_next_entry(&old_cursor, old_entry);
+                        new_entry = c_ini_diff_next_entry(&new_cursor, new_entry);
+                }
+        }
+
+        return 0;
+}
+
+_c_public_ int c_ini_domain_diff(CIniDomain *old_domain,
+                                 CIniDomain *new_domain,
+                                 CIniDiffFn fn,
+                                 void *userdata) {
+        CIniDiffCursor old_cursor, new_cursor;
+        CIniGroup *old_group, *new_group;
+        const char *old_label, *new_label;
+        size_t n_old_label, n_new_label;
+        int r, cmp;
+
+        /*
+         * Report all differences between @old_domain and @new_domain to @fn.
+         * The null groups are compared first, followed by all other groups in
+         * lookup order. Groups that exist in one domain only are reported as
+         * a whole, without reporting their entries. If @fn returns non-zero,
+         * the walk is aborted and the value is returned.
+         */
+
+        r = c_ini_diff_groups(c_ini_domain_get_null_group(old_domain),
+                              c_ini_domain_get_null_group(new_domain),
+                              fn,
+                              userdata);
+        if (r)
+                return r;
+
+        c_ini_diff_cursor_init_groups(&old_cursor, old_domain);
+        c_ini_diff_cursor_init_groups(&new_cursor, new_domain);
+        old_group = c_ini_diff_cursor_group(&old_cursor);
+        new_group = c_ini_diff_cursor_group(&new_cursor);
+
+        while (old_group || new_group) {
+                if (!old_group) {
+                        cmp = 1;
+                } else if (!new_group) {
+                        cmp = -1;
+                } else {
+                        old_label = c_ini_group_get_label(old_group, &n_old_label);
+                        new_label = c_ini_group_get_label(new_group, &n_new_label);
+                        cmp = c_ini_diff_compare(old_label, n_old_label, new_label, n_new_label);
+                }
+
+                if (cmp < 0) {
+                        r = fn(C_INI_DIFF_GROUP_REMOVED, old_group, NULL, NULL, NULL, userdata);
+                        if (r)
+                                return r;
+
+                        old_group = c_ini_diff_next_group(&old_cursor, old_group);
+                } else if (cmp > 0) {
+                        r = fn(C_INI_DIFF_GROUP_ADDED, NULL, NULL, new_group, NULL, userdata);
+                        if (r)
+                                return r;
+
+                        new_group = c_ini_diff_next_group(&new_cursor, new_group);
+                } else {
+                        r = c_ini_diff_groups(old_group, new_group, fn, userdata);
+                        if (r)
+                                return r;
+
+                        old_group = c_ini_diff_next_group(&old_cursor, old_group);
+                        new_group = c_ini_diff_next_group(&new_cursor, new_group);
+                }
+        }
+
+        return 0;
+}
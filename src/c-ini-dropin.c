@@ -0,0 +1,278 @@
+/*
+ * Ini-File Drop-In Loader
+ *
+ * Configuration is often split into a main file and a set of drop-ins, which
+ * are looked up in a list of search directories. Given a file name `foo.conf`
+ * and search directories ordered from highest to lowest priority, this loads:
+ *
+ *  * The main file `foo.conf`, taken from the first search directory that
+ *    contains it.
+ *
+ *  * All drop-ins in `foo.conf.d` with a `.conf` suffix, of all search
+ *    directories. If a drop-in of the same name exists in multiple
+ *    directories, only the one with the highest priority is used. Drop-ins
+ *    are applied in lexical order of their names, regardless of the
+ *    directory they were taken from.
+ *
+ * All files are parsed in parallel, and then linked into the domain in the
+ * order given above, as if they were fed to the reader one after another.
+ * Duplicate groups and entries are thus handled according to the mode of the
+ * reader. Each file starts over with no open group.
+ */
+
+#include <c-stdaux.h>
+#include <dirent.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include "c-ini.h"
+#include "c-ini-private.h"
+
+#define C_INI_DROPIN_SUFFIX ".conf"
+
+typedef struct CIniDropin CIniDropin;
+
+struct CIniDropin {
+        char *path;
+        const char *name;
+        size_t priority;
+};
+
+static void c_ini_dropins_free(CIniDropin *dropins, size_t n_dropins) {
+        size_t i;
+
+        for (i = 0; i < n_dropins; ++i)
+                free(dropins[i].path);
+        free(dropins);
+}
+
+static char *c_ini_path_join(const char *a, const char *b, const char *c) {
+        size_t n_a = strlen(a), n_b = strlen(b), n_c = strlen(c);
+        char *p;
+
+        p = malloc(n_a + 1 + n_b + n_c + 1);
+        if (!p)
+                return NULL;
+
+        c_memcpy(p, a, n_a);
+        p[n_a] = '/';
+        c_memcpy(p + n_a + 1, b, n_b);
+        c_memcpy(p + n_a + 1 + n_b, c, n_c);
+        p[n_a + 1 + n_b + n_c] = 0;
+
+        return p;
+}
+
+static int c_ini_dropin_compare(const void *a, const void *b) {
+        const CIniDropin *da = a, *db = b;
+        int r;
+
+        r = strcmp(da->name, db->name);
+        if (r)
+                return r;
+
+        return (da->priority > db->priority) - (da->priority < db->priority);
+}
+
+static bool c_ini_dropin_filter(const char *name) {
+        size_t n = strlen(name), n_suffix = strlen(C_INI_DROPIN_SUFFIX);
+
+        return name[0] != '.' &&
+               n > n_suffix &&
+               !strcmp(name + n - n_suffix, C_INI_DROPIN_SUFFIX);
+}
+
+static int c_ini_dropins_collect(CIniDropin **dropinsp,
+                                 size_t *n_dropinsp,
+                                 const char * const *dirs,
+                                 const char *name) {
+        CIniDropin *dropins = NULL, *t;
+        size_t i, j, n_dropins = 0, z_dropins = 0;
+        struct dirent *de;
+        struct stat st;
+        char *path, *dirpath;
+        DIR *dir;
+        int r = 0;
+
+        for (i = 0; dirs[i]; ++i) {
+                dirpath = c_ini_path_join(dirs[i], name, ".d");
+                if (!dirpath) {
+                        r = -ENOMEM;
+                        goto error;
+                }
+
+                dir = opendir(dirpath);
+                if (!dir) {
+                        r = -errno;
+                        free(dirpath);
+
+                        if (r == -ENOENT || r == -ENOTDIR) {
+                                r = 0;
+                                continue;
+                        }
+
+                        goto error;
+                }
+
+                while ((de = readdir(dir))) {
+                        if (!c_ini_dropin_filter(de->d_name))
+                                continue;
+                        if (de->d_type != DT_REG &&
+                            de->d_type != DT_LNK &&
+                            de->d_type != DT_UNKNOWN)
+                                continue;
+
+                        if (n_dropins >= z_dropins) {
+                                z_dropins = z_dropins ? z_dropins * 2 : 16;
+                                t = realloc(dropins, z_dropins * sizeof(*dropins));
+                                if (!t) {
+                                        r = -ENOMEM;
+                                        break;
+                                }
+
+                                dropins = t;
+                        }
+
+                        path = c_ini_path_join(dirpath, de->d_name, "");
+                        if (!path) {
+                                r = -ENOMEM;
+                                break;
+                        }
+
+                        dropins[n_dropins++] = (CIniDropin){
+                                .path = path,
+                                .name = strrchr(path, '/') + 1,
+                                .priority = i,
+                        };
+                }
+
+                closedir(dir);
+                free(dirpath);
+                if (r)
+                        goto error;
+        }
+
+        /*
+         * Sort by name, and for equal names by priority. Then drop all but the
+         * first of each name, which is the one with the highest priority.
+         */
+        if (n_dropins)
+                qsort(dropins, n_dropins, sizeof(*dropins), c_ini_dropin_compare);
+
+        for (i = 0, j = 0; i < n_dropins; ++i) {
+                if (j && !strcmp(dropins[j - 1].name, dropins[i].name))
+                        free(dropins[i].path);
+                else
+                        dropins[j++] = dropins[i];
+        }
+        n_dropins = j;
+
+        /*
+         * Finally, prepend the main file of the highest priority. Note that
+         * drop-ins are applied even if there is no main file at all.
+         */
+        for (i = 0; dirs[i]; ++i) {
+                path = c_ini_path_join(dirs[i], name, "");
+                if (!path) {
+                        r = -ENOMEM;
+                        goto error;
+                }
+
+                if (stat(path, &st) >= 0 && !S_ISDIR(st.st_mode)) {
+                        t = realloc(dropins, (n_dropins + 1) * sizeof(*dropins));
+                        if (!t) {
+                                free(path);
+                                r = -ENOMEM;
+                                goto error;
+                        }
+
+                        dropins = t;
+                        memmove(dropins + 1, dropins, n_dropins * sizeof(*dropins));
+                        dropins[0] = (CIniDropin){
+                                .path = path,
+                                .name = strrchr(path, '/') + 1,
+                                .priority = i,
+                        };
+                        ++n_dropins;
+                        break;
+                }
+
+                free(path);
+        }
+
+        *dropinsp = dropins;
+        *n_dropinsp = n_dropins;
+        return 0;
+
+error:
+        c_ini_dropins_free(dropins, n_dropins);
+        return r;
+}
+
+_c_public_ int c_ini_reader_feed_dropins(CIniReader *reader,
+                                         const char * const *dirs,
+                                         const char *name,
+                                         unsigned int n_threads) {
+        CIniDropin *dropins = NULL;
+        CIniTask *tasks = NULL;
+        size_t i, n_dropins = 0;
+        int r;
+
+        r = c_ini_dropins_collect(&dropins, &n_dropins, dirs, name);
+        if (r)
+                return r;
+
+        r = c_ini_reader_flush(reader);
+        if (r)
+                goto exit;
+
+        if (!n_dropins)
+                goto exit;
+
+        /* see c_ini_reader_feed_parallel() */
+        if (reader->callbacks || reader->limited || reader->previous || reader->reuse) {
+                for (i = 0; i < n_dropins; ++i) {
+                        /* skip drop-ins that vanished, see c_ini_task_parse_path() */
+                        r = c_ini_reader_feed_path(reader, dropins[i].path);
+                        if (r == -ENOENT || r == -EISDIR)
+                                r = 0;
+                        if (!r)
+                                r = c_ini_reader_flush(reader);
+                        if (r)
+                                goto exit;
+                }
+
+                goto exit;
+        }
+
+        tasks = calloc(n_dropins, sizeof(*tasks));
+        if (!tasks) {
+                r = -ENOMEM;
+                goto exit;
+        }
+
+        for (i = 0; i < n_dropins; ++i) {
+                c_ini_task_init(&tasks[i], reader);
+                tasks[i].path = dropins[i].path;
+        }
+
+        r = c_ini_task_run_all(tasks, n_dropins, n_threads);
+        if (!r) {
+                for (i = 0; i < n_dropins; ++i) {
+                        reader->current = c_ini_group_unref(reader->current);
+                        c_ini_task_link(&tasks[i], reader);
+                }
+
+                reader->current = c_ini_group_unref(reader->current);
+        }
+
+        for (i = 0; i < n_dropins; ++i)
+                c_ini_task_deinit(&tasks[i]);
+        free(tasks);
+
+exit:
+        c_ini_dropins_free(dropins, n_dropins);
+        return r;
+}
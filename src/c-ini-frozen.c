@@ -0,0 +1,612 @@
+/*
+ * Ini-File Frozen Domains
+ *
+ * Once a domain is sealed, it is never modified again. Yet, it remains a
+ * graph of individually linked groups and entries, each with its own
+ * reference counter, list links, tree nodes, and string pointers. Freezing a
+ * domain compacts it into a single contiguous block with a string table, flat
+ * group and entry arrays, and sorted lookup indices. Iteration and lookups on
+ * the frozen domain walk linear memory, and the per-entry overhead shrinks to
+ * a fraction of its dynamic counterpart.
+ *
+ * The frozen domain is a new domain object. The public accessors detect
+ * frozen objects and dispatch to the functions in this file, so callers can
+ * use frozen and dynamic domains interchangeably. See `CIniFrozen` for a
+ * description of the layout. Strings are always copied into the block, hence
+ * they are zero-terminated even if the source domain borrowed its data.
+ */
+
+#include <c-stdaux.h>
+#include <errno.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include "c-ini.h"
+#include "c-ini-private.h"
+
+typedef struct CIniFrozenSort CIniFrozenSort;
+
+struct CIniFrozenSort {
+        const uint8_t *data;
+        size_t n_data;
+        uint32_t index;
+};
+
+static size_t c_ini_frozen_measure_entry(CIniEntry *entry) {
+        size_t n;
+
+        /* values with escapes store their decoded string as well */
+        n = entry->n_key + 1 + entry->n_value + 1;
+        if (memchr(entry->value, '\\', entry->n_value))
+                n += c_ini_value_decode(NULL, (const char *)entry->value, entry->n_value) + 1;
+
+        return n;
+}
+
+static int c_ini_frozen_layout(CIniDomain *domain, CIniFrozen *layout, size_t *i_stringsp) {
+        size_t n_groups = 1, n_entries = 0, n_strings = 1, n_size;
+        CIniGroup *group;
+        CIniEntry *entry;
+
+        /*
+         * Compute the layout of the frozen block of @domain. The header is
+         * followed by the group and entry arrays, their lookup indices, and
+         * finally the string table. Strings are always zero-terminated. The
+         * null group has an empty label, just like its dynamic counterpart.
+         */
+
+        c_list_for_each_entry(entry, &domain->null_group->list_entries, link_group) {
+                n_strings += c_ini_frozen_measure_entry(entry);
+                ++n_entries;
+        }
+
+        c_list_for_each_entry(group, &domain->list_groups, link_domain) {
+                n_strings += group->n_label + 1;
+                ++n_groups;
+
+                c_list_for_each_entry(entry, &group->list_entries, link_group) {
+                        n_strings += c_ini_frozen_measure_entry(entry);
+                        ++n_entries;
+                }
+        }
+
+        n_size = c_align_to(sizeof(CIniFrozen), _Alignof(CIniFrozenGroup));
+        layout->groups = n_size;
+        n_size += n_groups * sizeof(CIniFrozenGroup);
+        n_size = c_align_to(n_size, _Alignof(CIniFrozenEntry));
+        layout->entries = n_size;
+        n_size += n_entries * sizeof(CIniFrozenEntry);
+        layout->index_groups = n_size;
+        n_size += (n_groups - 1) * sizeof(uint32_t);
+        layout->index_entries = n_size;
+        n_size += n_entries * sizeof(uint32_t);
+        *i_stringsp = n_size;
+        n_size += n_strings;
+
+        /* all offsets are 32-bit */
+        if (n_size > UINT32_MAX)
+                return -EFBIG;
+
+        layout->n_size = n_size;
+        layout->n_groups = n_groups;
+        layout->n_entries = n_entries;
+        return 0;
+}
+
+int c_ini_frozen_measure(CIniDomain *domain, size_t *n_sizep) {
+        CIniFrozen layout = {};
+        size_t i_strings;
+        int r;
+
+        r = c_ini_frozen_layout(domain, &layout, &i_strings);
+        if (r)
+                return r;
+
+        *n_sizep = layout.n_size;
+        return 0;
+}
+
+static uint32_t c_ini_frozen_add_string(uint8_t *base, size_t *i_stringp, const uint8_t *data, size_t n_data) {
+        uint32_t offset = *i_stringp;
+
+        c_memcpy(base + offset, data, n_data);
+        base[offset + n_data] = 0;
+        *i_stringp += n_data + 1;
+
+        return offset;
+}
+
+static int c_ini_frozen_compare(const void *a, const void *b) {
+        const CIniFrozenSort *x = a, *y = b;
+        int r;
+
+        /* order by length, content, and finally by order of addition */
+
+        if (x->n_data != y->n_data)
+                return x->n_data < y->n_data ? -1 : 1;
+
+        r = x->n_data ? memcmp(x->data, y->data, x->n_data) : 0;
+        if (r)
+                return r;
+
+        return x->index < y->index ? -1 : x->index > y->index ? 1 : 0;
+}
+
+static void c_ini_frozen_sort(uint32_t *index, CIniFrozenSort *sort, size_t n_sort) {
+        size_t i;
+
+        qsort(sort, n_sort, sizeof(*sort), c_ini_frozen_compare);
+
+        for (i = 0; i < n_sort; ++i)
+                index[i] = sort[i].index;
+}
+
+static void c_ini_frozen_add_group(uint8_t *base,
+                                   CIniFrozen *frozen,
+                                   size_t *i_stringp,
+                                   CIniGroup *group,
+                                   uint32_t i_group,
+                                   CIniFrozenSort *sort) {
+        CIniFrozenGroup *frozen_group = (CIniFrozenGroup *)(base + frozen->groups) + i_group;
+        CIniFrozenEntry *frozen_entry;
+        CIniEntry *entry;
+        size_t n_sort = 0;
+
+        frozen_group->offset = (uint8_t *)frozen_group - base;
+        frozen_group->label = c_ini_frozen_add_string(base, i_stringp, group->label, group->n_label);
+        frozen_group->n_label = group->n_label;
+        frozen_group->i_entry = frozen->n_entries;
+
+        c_list_for_each_entry(entry, &group->list_entries, link_group) {
+                frozen_entry = (CIniFrozenEntry *)(base + frozen->entries) + frozen->n_entries;
+                frozen_entry->offset = (uint8_t *)frozen_entry - base;
+                frozen_entry->i_group = i_group;
+                frozen_entry->key = c_ini_frozen_add_string(base, i_stringp, entry->key, entry->n_key);
+                frozen_entry->n_key = entry->n_key;
+                frozen_entry->value = c_ini_frozen_add_string(base, i_stringp, entry->value, entry->n_value);
+                frozen_entry->n_value = entry->n_value;
+                frozen_entry->decoded = frozen_entry->value;
+                frozen_entry->n_decoded = frozen_entry->n_value;
+
+                if (memchr(entry->value, '\\', entry->n_value)) {
+                        frozen_entry->decoded = *i_stringp;
+                        frozen_entry->n_decoded = c_ini_value_decode((char *)base + *i_stringp,
+                                                                     (const char *)entry->value,
+                                                                     entry->n_value);
+                        *i_stringp += frozen_entry->n_decoded + 1;
+                }
+
+                sort[n_sort++] = (CIniFrozenSort){
+                        .data = entry->key,
+                        .n_data = entry->n_key,
+                        .index = frozen->n_entries++,
+                };
+        }
+
+        frozen_group->n_entries = n_sort;
+        c_ini_frozen_sort((uint32_t *)(base + frozen->index_entries) + frozen_group->i_entry, sort, n_sort);
+}
+
+int c_ini_frozen_fill(CIniDomain *domain, void *p, size_t n_size) {
+        _c_cleanup_(c_ini_freep) CIniFrozenSort *sort = NULL;
+        CIniFrozen *frozen = p, layout = {};
+        uint8_t *base = p;
+        size_t i_strings, n_sort = 1;
+        CIniGroup *group;
+        uint32_t i_group;
+        int r;
+
+        /*
+         * Serialize @domain into the block @p of size @n_size, as computed by
+         * c_ini_frozen_measure(). The block must be zeroed and suitably
+         * aligned. The back-pointer to the domain is left unset.
+         */
+
+        r = c_ini_frozen_layout(domain, &layout, &i_strings);
+        if (r)
+                return r;
+
+        c_assert(n_size == layout.n_size);
+
+        /* scratch buffer to sort the groups, or the entries of a group */
+        n_sort = c_max(n_sort, (size_t)c_max(layout.n_groups, layout.n_entries));
+
+        sort = malloc(n_sort * sizeof(*sort));
+        if (!sort)
+                return -ENOMEM;
+
+        *frozen = layout;
+        frozen->n_groups = 0;
+        frozen->n_entries = 0;
+
+        c_ini_frozen_add_group(base, frozen, &i_strings, domain->null_group, frozen->n_groups++, sort);
+        c_list_for_each_entry(group, &domain->list_groups, link_domain)
+                c_ini_frozen_add_group(base, frozen, &i_strings, group, frozen->n_groups++, sort);
+
+        c_assert(frozen->n_groups == layout.n_groups);
+        c_assert(frozen->n_entries == layout.n_entries);
+        c_assert(i_strings == layout.n_size);
+
+        i_group = 0;
+        c_list_for_each_entry(group, &domain->list_groups, link_domain) {
+                sort[i_group] = (CIniFrozenSort){
+                        .data = group->label,
+                        .n_data = group->n_label,
+                        .index = i_group + 1,
+                };
+                ++i_group;
+        }
+        c_ini_frozen_sort((uint32_t *)(base + frozen->index_groups), sort, i_group);
+
+        return 0;
+}
+
+static bool c_ini_frozen_verify_string(const uint8_t *base, size_t n_size, uint32_t offset, uint32_t n) {
+        /* strings must be in bounds and zero-terminated */
+        return offset < n_size && n < n_size - offset && !base[offset + n];
+}
+
+static bool c_ini_frozen_verify_order(const uint8_t *base,
+                                      uint32_t offset_a,
+                                      uint32_t n_a,
+                                      uint32_t index_a,
+                                      uint32_t offset_b,
+                                      uint32_t n_b,
+                                      uint32_t index_b) {
+        CIniFrozenSort a = { .data = base + offset_a, .n_data = n_a, .index = index_a };
+        CIniFrozenSort b = { .data = base + offset_b, .n_data = n_b, .index = index_b };
+
+        /* strictly ordered, hence each index is listed at most once */
+        return c_ini_frozen_compare(&a, &b) < 0;
+}
+
+static bool c_ini_frozen_verify_group(const CIniFrozen *frozen, size_t n_size, uint32_t i_group) {
+        const uint8_t *base = (const uint8_t *)frozen;
+        const CIniFrozenGroup *g = (const CIniFrozenGroup *)(base + frozen->groups) + i_group;
+        const CIniFrozenEntry *entries = (const CIniFrozenEntry *)(base + frozen->entries);
+        const CIniFrozenEntry *e, *prev;
+        const uint32_t *index = (const uint32_t *)(base + frozen->index_entries) + g->i_entry;
+        uint32_t i;
+
+        for (i = g->i_entry; i < g->i_entry + g->n_entries; ++i) {
+                e = &entries[i];
+                if (c_ini_ref_get(&e->n_refs) ||
+                    e->offset != (uint8_t *)e - base ||
+                    e->i_group != i_group ||
+                    !c_ini_frozen_verify_string(base, n_size, e->key, e->n_key) ||
+                    !c_ini_frozen_verify_string(base, n_size, e->value, e->n_value) ||
+                    !c_ini_frozen_verify_string(base, n_size, e->decoded, e->n_decoded))
+                        return false;
+        }
+
+        for (i = 0; i < g->n_entries; ++i) {
+                if (index[i] < g->i_entry || index[i] - g->i_entry >= g->n_entries)
+                        return false;
+
+                e = &entries[index[i]];
+                prev = i ? &entries[index[i - 1]] : NULL;
+                if (prev && !c_ini_frozen_verify_order(base,
+                                                       prev->key, prev->n_key, index[i - 1],
+                                                       e->key, e->n_key, index[i]))
+                        return false;
+        }
+
+        return true;
+}
+
+bool c_ini_frozen_verify(const CIniFrozen *frozen, size_t n_size) {
+        const uint8_t *base = (const uint8_t *)frozen;
+        const CIniFrozenGroup *groups, *g, *prev;
+        const uint32_t *index;
+        uint32_t i, i_entry = 0;
+
+        /*
+         * Verify a frozen block of size @n_size that was read from an
+         * external source. Cache files are not trusted, so every offset,
+         * length, and index is checked against the extents of the block, as
+         * well as every invariant the accessors rely on. If this fails, the
+         * block must not be used, and the caller should parse the sources
+         * instead.
+         */
+
+        if (n_size < sizeof(*frozen) || n_size > UINT32_MAX ||
+            frozen->n_size != n_size || frozen->n_groups < 1)
+                return false;
+
+        /* the arrays must not overlap the header, which holds the back-pointer */
+
+        if (frozen->groups % _Alignof(CIniFrozenGroup) ||
+            frozen->groups < sizeof(*frozen) ||
+            frozen->groups > n_size ||
+            frozen->n_groups > (n_size - frozen->groups) / sizeof(CIniFrozenGroup))
+                return false;
+
+        if (frozen->entries % _Alignof(CIniFrozenEntry) ||
+            frozen->entries < sizeof(*frozen) ||
+            frozen->entries > n_size ||
+            frozen->n_entries > (n_size - frozen->entries) / sizeof(CIniFrozenEntry))
+                return false;
+
+        if (frozen->index_groups % _Alignof(uint32_t) ||
+            frozen->index_groups < sizeof(*frozen) ||
+            frozen->index_groups > n_size ||
+            frozen->n_groups - 1 > (n_size - frozen->index_groups) / sizeof(uint32_t))
+                return false;
+
+        if (frozen->index_entries % _Alignof(uint32_t) ||
+            frozen->index_entries < sizeof(*frozen) ||
+            frozen->index_entries > n_size ||
+            frozen->n_entries > (n_size - frozen->index_entries) / sizeof(uint32_t))
+                return false;
+
+        /* groups cover the entry array in order, starting with the null group */
+
+        groups = (const CIniFrozenGroup *)(base + frozen->groups);
+        for (i = 0; i < frozen->n_groups; ++i) {
+                g = &groups[i];
+                if (c_ini_ref_get(&g->n_refs) ||
+                    g->offset != (uint8_t *)g - base ||
+                    g->i_entry != i_entry ||
+                    g->n_entries > frozen->n_entries - i_entry ||
+                    (!i && g->n_label) ||
+                    !c_ini_frozen_verify_string(base, n_size, g->label, g->n_label))
+                        return false;
+
+                i_entry += g->n_entries;
+        }
+
+        if (i_entry != frozen->n_entries)
+                return false;
+
+        for (i = 0; i < frozen->n_groups; ++i)
+                if (!c_ini_frozen_verify_group(frozen, n_size, i))
+                        return false;
+
+        /* the group index lists each group but the null group exactly once */
+
+        index = (const uint32_t *)(base + frozen->index_groups);
+        for (i = 0; i < frozen->n_groups - 1; ++i) {
+                if (index[i] < 1 || index[i] >= frozen->n_groups)
+                        return false;
+
+                g = &groups[index[i]];
+                prev = i ? &groups[index[i - 1]] : NULL;
+                if (prev && !c_ini_frozen_verify_order(base,
+                                                       prev->label, prev->n_label, index[i - 1],
+                                                       g->label, g->n_label, index[i]))
+                        return false;
+        }
+
+        return true;
+}
+
+_c_public_ int c_ini_domain_freeze(CIniDomain *domain, CIniDomain **frozenp) {
+        _c_cleanup_(c_ini_arena_unrefp) CIniArena *arena = NULL;
+        size_t n_size;
+        void *p;
+        int r;
+
+        if (domain->frozen) {
+                *frozenp = c_ini_domain_ref(domain);
+                return 0;
+        }
+
+        r = c_ini_frozen_measure(domain, &n_size);
+        if (r)
+                return r;
+
+        r = c_ini_arena_new(&arena);
+        if (r)
+                return r;
+
+        p = c_ini_arena_alloc(arena, n_size);
+        if (!p)
+                return -ENOMEM;
+
+        r = c_ini_frozen_fill(domain, p, n_size);
+        if (r)
+                return r;
+
+        return c_ini_domain_new_frozen(frozenp, arena, p);
+}
+
+static CIniFrozen *c_ini_frozen_from_entry(CIniFrozenEntry *entry) {
+        return (CIniFrozen *)((uint8_t *)entry - entry->offset);
+}
+
+static CIniFrozen *c_ini_frozen_from_group(CIniFrozenGroup *group) {
+        return (CIniFrozen *)((uint8_t *)group - group->offset);
+}
+
+static CIniFrozenGroup *c_ini_frozen_group_at(CIniFrozen *frozen, uint32_t i) {
+        return (CIniFrozenGroup *)((uint8_t *)frozen + frozen->groups) + i;
+}
+
+static CIniFrozenEntry *c_ini_frozen_entry_at(CIniFrozen *frozen, uint32_t i) {
+        return (CIniFrozenEntry *)((uint8_t *)frozen + frozen->entries) + i;
+}
+
+static const char *c_ini_frozen_string_at(CIniFrozen *frozen, uint32_t offset) {
+        return (const char *)frozen + offset;
+}
+
+CIniEntry *c_ini_frozen_entry_next(CIniEntry *entry) {
+        CIniFrozenEntry *e = (CIniFrozenEntry *)entry;
+        CIniFrozen *frozen = c_ini_frozen_from_entry(e);
+        CIniFrozenGroup *g = c_ini_frozen_group_at(frozen, e->i_group);
+
+        if (e + 1 == c_ini_frozen_entry_at(frozen, g->i_entry + g->n_entries))
+                return NULL;
+        return (CIniEntry *)(e + 1);
+}
+
+CIniEntry *c_ini_frozen_entry_previous(CIniEntry *entry) {
+        CIniFrozenEntry *e = (CIniFrozenEntry *)entry;
+        CIniFrozen *frozen = c_ini_frozen_from_entry(e);
+        CIniFrozenGroup *g = c_ini_frozen_group_at(frozen, e->i_group);
+
+        if (e == c_ini_frozen_entry_at(frozen, g->i_entry))
+                return NULL;
+        return (CIniEntry *)(e - 1);
+}
+
+const char *c_ini_frozen_entry_get_key(CIniEntry *entry, size_t *n_keyp) {
+        CIniFrozenEntry *e = (CIniFrozenEntry *)entry;
+
+        if (n_keyp)
+                *n_keyp = e->n_key;
+        return c_ini_frozen_string_at(c_ini_frozen_from_entry(e), e->key);
+}
+
+const char *c_ini_frozen_entry_get_value(CIniEntry *entry, size_t *n_valuep) {
+        CIniFrozenEntry *e = (CIniFrozenEntry *)entry;
+
+        if (n_valuep)
+                *n_valuep = e->n_value;
+        return c_ini_frozen_string_at(c_ini_frozen_from_entry(e), e->value);
+}
+
+const char *c_ini_frozen_entry_get_string(CIniEntry *entry, size_t *n_stringp) {
+        CIniFrozenEntry *e = (CIniFrozenEntry *)entry;
+
+        if (n_stringp)
+                *n_stringp = e->n_decoded;
+        return c_ini_frozen_string_at(c_ini_frozen_from_entry(e), e->decoded);
+}
+
+CIniDomain *c_ini_frozen_entry_get_domain(CIniEntry *entry) {
+        return c_ini_frozen_from_entry((CIniFrozenEntry *)entry)->domain;
+}
+
+CIniGroup *c_ini_frozen_group_next(CIniGroup *group) {
+        CIniFrozenGroup *g = (CIniFrozenGroup *)group;
+        CIniFrozen *frozen = c_ini_frozen_from_group(g);
+
+        /* the null group is not part of the group list */
+        if (g == c_ini_frozen_group_at(frozen, 0) ||
+            g + 1 == c_ini_frozen_group_at(frozen, frozen->n_groups))
+                return NULL;
+        return (CIniGroup *)(g + 1);
+}
+
+CIniGroup *c_ini_frozen_group_previous(CIniGroup *group) {
+        CIniFrozenGroup *g = (CIniFrozenGroup *)group;
+        CIniFrozen *frozen = c_ini_frozen_from_group(g);
+
+        if (g == c_ini_frozen_group_at(frozen, 0) ||
+            g == c_ini_frozen_group_at(frozen, 1))
+                return NULL;
+        return (CIniGroup *)(g - 1);
+}
+
+const char *c_ini_frozen_group_get_label(CIniGroup *group, size_t *n_labelp) {
+        CIniFrozenGroup *g = (CIniFrozenGroup *)group;
+
+        if (n_labelp)
+                *n_labelp = g->n_label;
+        return c_ini_frozen_string_at(c_ini_frozen_from_group(g), g->label);
+}
+
+CIniEntry *c_ini_frozen_group_iterate(CIniGroup *group) {
+        CIniFrozenGroup *g = (CIniFrozenGroup *)group;
+
+        if (!g->n_entries)
+                return NULL;
+        return (CIniEntry *)c_ini_frozen_entry_at(c_ini_frozen_from_group(g), g->i_entry);
+}
+
+static int c_ini_frozen_compare_string(CIniFrozen *frozen,
+                                       const char *label,
+                                       size_t n_label,
+                                       uint32_t offset,
+                                       uint32_t n) {
+        if (n_label != n)
+                return n_label < n ? -1 : 1;
+        return n ? memcmp(label, c_ini_frozen_string_at(frozen, offset), n) : 0;
+}
+
+CIniEntry *c_ini_frozen_group_find(CIniGroup *group, const char *label, size_t n_label) {
+        CIniFrozenGroup *g = (CIniFrozenGroup *)group;
+        CIniFrozen *frozen = c_ini_frozen_from_group(g);
+        const uint32_t *index = (const uint32_t *)((uint8_t *)frozen + frozen->index_entries) + g->i_entry;
+        CIniFrozenEntry *e;
+        size_t low = 0, high = g->n_entries, i;
+
+        /* find the first matching entry, which is the earliest addition */
+        while (low < high) {
+                i = low + (high - low) / 2;
+                e = c_ini_frozen_entry_at(frozen, index[i]);
+                if (c_ini_frozen_compare_string(frozen, label, n_label, e->key, e->n_key) > 0)
+                        low = i + 1;
+                else
+                        high = i;
+        }
+
+        if (low >= g->n_entries)
+                return NULL;
+
+        e = c_ini_frozen_entry_at(frozen, index[low]);
+        if (c_ini_frozen_compare_string(frozen, label, n_label, e->key, e->n_key))
+                return NULL;
+
+        return (CIniEntry *)e;
+}
+
+CIniDomain *c_ini_frozen_group_get_domain(CIniGroup *group) {
+        return c_ini_frozen_from_group((CIniFrozenGroup *)group)->domain;
+}
+
+CIniGroup *c_ini_frozen_get_null_group(CIniFrozen *frozen) {
+        return (CIniGroup *)c_ini_frozen_group_at(frozen, 0);
+}
+
+CIniGroup *c_ini_frozen_iterate(CIniFrozen *frozen) {
+        if (frozen->n_groups < 2)
+                return NULL;
+        return (CIniGroup *)c_ini_frozen_group_at(frozen, 1);
+}
+
+CIniGroup *c_ini_frozen_find(CIniFrozen *frozen, const char *label, size_t n_label) {
+        const uint32_t *index = (const uint32_t *)((uint8_t *)frozen + frozen->index_groups);
+        CIniFrozenGroup *g;
+        size_t low = 0, high = frozen->n_groups - 1, i;
+
+        /* see c_ini_frozen_group_find() */
+        while (low < high) {
+                i = low + (high - low) / 2;
+                g = c_ini_frozen_group_at(frozen, index[i]);
+                if (c_ini_frozen_compare_string(frozen, label, n_label, g->label, g->n_label) > 0)
+                        low = i + 1;
+                else
+                        high = i;
+        }
+
+        if (low >= frozen->n_groups - 1)
+                return NULL;
+
+        g = c_ini_frozen_group_at(frozen, index[low]);
+        if (c_ini_frozen_compare_string(frozen, label, n_label, g->label, g->n_label))
+                return NULL;
+
+        return (CIniGroup *)g;
+}
+
+CIniGroup *c_ini_frozen_sorted_group(CIniFrozen *frozen, size_t i) {
+        const uint32_t *index = (const uint32_t *)((uint8_t *)frozen + frozen->index_groups);
+
+        /* return the @i-th group in lookup order */
+        if (i >= frozen->n_groups - 1)
+                return NULL;
+        return (CIniGroup *)c_ini_frozen_group_at(frozen, index[i]);
+}
+
+CIniEntry *c_ini_frozen_group_sorted_entry(CIniGroup *group, size_t i) {
+        CIniFrozenGroup *g = (CIniFrozenGroup *)group;
+        CIniFrozen *frozen = c_ini_frozen_from_group(g);
+        const uint32_t *index = (const uint32_t *)((uint8_t *)frozen + frozen->index_entries) + g->i_entry;
+
+        /* return the @i-th entry of @group in lookup order */
+        if (i >= g->n_entries)
+                return NULL;
+        return (CIniEntry *)c_ini_frozen_entry_at(frozen, index[i]);
+}
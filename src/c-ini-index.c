@@ -0,0 +1,127 @@
+/*
+ * Ini-File Hash Index
+ *
+ * Groups and domains can optionally maintain a hash index over their entries
+ * and groups, respectively. The index is an open-addressing hash table with
+ * linear probing. It only stores the precomputed hash of the key together
+ * with a pointer to the object. Key comparison is left to the caller.
+ *
+ * Lookups must return the earliest addition among all objects with the same
+ * key, just like the lookup trees. To guarantee this, new objects are always
+ * placed in the first free slot of their probe sequence, and slots of removed
+ * objects are never reused. Hence, the probe sequence of a key always lists
+ * its objects in order of addition. When the table is rebuilt, the owner adds
+ * all objects again in order of their addition.
+ */
+
+#include <c-stdaux.h>
+#include <errno.h>
+#include <stdlib.h>
+#include "c-ini.h"
+#include "c-ini-private.h"
+
+/* marker for slots of removed objects */
+#define C_INI_INDEX_TOMBSTONE ((void *)1)
+
+void c_ini_index_deinit(CIniIndex *index) {
+        free(index->slots);
+        *index = (CIniIndex)C_INI_INDEX_NULL(*index);
+}
+
+int c_ini_index_reset(CIniIndex *index, size_t n) {
+        CIniIndexSlot *slots;
+        size_t n_slots = 8;
+
+        /*
+         * Reset the index to an empty table with room for at least @n
+         * objects. On failure, the index is left unchanged.
+         */
+
+        while (n_slots / 2 < n) {
+                if (n_slots > SIZE_MAX / 2 / sizeof(*slots))
+                        return -ENOMEM;
+                n_slots *= 2;
+        }
+
+        slots = calloc(n_slots, sizeof(*slots));
+        if (!slots)
+                return -ENOMEM;
+
+        free(index->slots);
+        index->slots = slots;
+        index->n_slots = n_slots;
+        index->n_used = 0;
+        index->n_live = 0;
+
+        return 0;
+}
+
+bool c_ini_index_is_full(CIniIndex *index) {
+        /* keep the load factor, including removed slots, below 3/4 */
+        return (index->n_used + 1) * 4 > index->n_slots * 3;
+}
+
+void c_ini_index_add(CIniIndex *index, uint64_t hash, void *p) {
+        size_t i, mask = index->n_slots - 1;
+
+        c_assert(!c_ini_index_is_full(index));
+
+        for (i = hash & mask; index->slots[i].p; i = (i + 1) & mask)
+                /* empty */ ;
+
+        index->slots[i].hash = hash;
+        index->slots[i].p = p;
+        ++index->n_used;
+        ++index->n_live;
+}
+
+void c_ini_index_remove(CIniIndex *index, uint64_t hash, void *p) {
+        size_t i, mask = index->n_slots - 1;
+
+        for (i = hash & mask; index->slots[i].p; i = (i + 1) & mask) {
+                if (index->slots[i].p == p) {
+                        index->slots[i].p = C_INI_INDEX_TOMBSTONE;
+                        --index->n_live;
+                        return;
+                }
+        }
+
+        c_assert(0);
+}
+
+void *c_ini_index_find(CIniIndex *index, uint64_t hash, CIniIndexMatchFn match, const void *key) {
+        size_t i, mask = index->n_slots - 1;
+        void *p;
+
+        for (i = hash & mask; (p = index->slots[i].p); i = (i + 1) & mask) {
+                if (p != C_INI_INDEX_TOMBSTONE &&
+                    index->slots[i].hash == hash &&
+                    match(key, p))
+                        return p;
+        }
+
+        return NULL;
+}
+
+void *c_ini_index_next(CIniIndex *index, uint64_t hash, size_t *ip) {
+        size_t i, mask = index->n_slots - 1;
+        void *p;
+
+        /*
+         * Iterate all objects with hash @hash in order of addition. @ip is
+         * the iterator and must be initialized to 0 by the caller.
+         */
+
+        if (!index->n_slots)
+                return NULL;
+
+        for (i = *ip; i < index->n_slots && (p = index->slots[(hash + i) & mask].p); ++i) {
+                if (p != C_INI_INDEX_TOMBSTONE && index->slots[(hash + i) & mask].hash == hash) {
+                        *ip = i + 1;
+                        return p;
+                }
+        }
+
+        *ip = i;
+        return NULL;
+}
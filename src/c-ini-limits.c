@@ -0,0 +1,136 @@
+/*
+ * Ini-File Reader Limits
+ *
+ * Readers accept input of any size by default. If the input is not trusted,
+ * limits bound the memory and time spent on it. Limits are checked
+ * incrementally while input is fed: the line-buffer is checked before it
+ * grows, and each complete line is checked before any object is allocated
+ * for it. Hence, a violation is detected as early as possible, and never
+ * after the offending data was retained.
+ *
+ * Violations fail with C_INI_E_LIMIT. The parsing round cannot be continued
+ * afterwards, and the reader should be discarded.
+ *
+ * Limits need the lines in order, so readers with limits parse parallel
+ * feeds and drop-ins serially.
+ */
+
+#include <c-stdaux.h>
+#include <stdlib.h>
+#include "c-ini.h"
+#include "c-ini-private.h"
+
+_c_public_ void c_ini_reader_set_limits(CIniReader *reader, const CIniLimits *limits) {
+        /* the limits are copied, NULL clears them */
+        if (limits) {
+                reader->limits = *limits;
+                reader->limited = true;
+        } else {
+                reader->limits = (CIniLimits)C_INI_LIMITS_NULL(reader->limits);
+                reader->limited = false;
+        }
+}
+
+static bool c_ini_limit_exceeded(size_t limit, size_t n) {
+        return limit && n > limit;
+}
+
+static size_t c_ini_reader_count_entries(CIniReader *reader) {
+        /*
+         * Count the entries of the group the next entry is linked into. With
+         * callbacks, there are no groups, so the entries since the last group
+         * header are counted instead.
+         */
+        if (reader->callbacks)
+                return reader->n_entries;
+
+        return (reader->current ?: reader->domain->null_group)->n_entries;
+}
+
+static bool c_ini_reader_grows(CIniReader *reader, const uint8_t *data, const CIniLine *line) {
+        CIniGroup *group;
+
+        /*
+         * Check whether the entry of @line adds to its group. Unless
+         * duplicates are kept, an entry with a key already present in the
+         * group either replaces it or is discarded, so the group does not
+         * grow. Its line is still bounded by @max_bytes.
+         */
+
+        if (reader->callbacks || reader->mode & C_INI_MODE_KEEP_DUPLICATE_ENTRIES)
+                return true;
+
+        group = reader->current ?: reader->domain->null_group;
+        return !c_ini_group_find(group, (const char *)data + line->i_key, line->n_key);
+}
+
+void c_ini_reader_reset_limits(CIniReader *reader) {
+        reader->n_groups = 0;
+        reader->n_entries = 0;
+        reader->n_bytes = 0;
+}
+
+int c_ini_reader_check_append(CIniReader *reader, size_t n_data) {
+        size_t n = reader->n_line + n_data;
+
+        /*
+         * Check whether @n_data more bytes can be appended to the
+         * line-buffer. Overflows are reported by the line-buffer itself.
+         */
+
+        if (!reader->limited || n < n_data)
+                return 0;
+
+        if (c_ini_limit_exceeded(reader->limits.max_line, n) ||
+            c_ini_limit_exceeded(reader->limits.max_bytes, reader->n_bytes + n))
+                return C_INI_E_LIMIT;
+
+        return 0;
+}
+
+int c_ini_reader_check_line(CIniReader *reader,
+                            const uint8_t *data,
+                            size_t n_data,
+                            const CIniLine *line) {
+        const CIniLimits *limits = &reader->limits;
+
+        /*
+         * Check the complete line @data of @n_data bytes, parsed into @line,
+         * against the limits, and account for it if it passes. This runs
+         * before anything is allocated for the line. The caller passes the
+         * parsed line on, so it is not parsed again.
+         */
+
+        if (!reader->limited || !n_data)
+                return 0;
+
+        if (c_ini_limit_exceeded(limits->max_line, n_data) ||
+            c_ini_limit_exceeded(limits->max_bytes, reader->n_bytes + n_data))
+                return C_INI_E_LIMIT;
+
+        switch (line->type) {
+        case C_INI_LINE_GROUP:
+                if (c_ini_limit_exceeded(limits->max_label, line->n_key) ||
+                    c_ini_limit_exceeded(limits->max_groups, reader->n_groups + 1))
+                        return C_INI_E_LIMIT;
+
+                ++reader->n_groups;
+                reader->n_entries = 0;
+                break;
+        case C_INI_LINE_ENTRY:
+                if (c_ini_limit_exceeded(limits->max_key, line->n_key) ||
+                    c_ini_limit_exceeded(limits->max_value, line->n_value))
+                        return C_INI_E_LIMIT;
+
+                /* only look up the key if the group is full already */
+                if (c_ini_limit_exceeded(limits->max_entries, c_ini_reader_count_entries(reader) + 1) &&
+                    c_ini_reader_grows(reader, data, line))
+                        return C_INI_E_LIMIT;
+
+                ++reader->n_entries;
+                break;
+        }
+
+        reader->n_bytes += n_data;
+        return 0;
+}
@@ -0,0 +1,124 @@
+/*
+ * Ini-File List Values
+ *
+ * The XDG desktop-entry specification defines list values as elements
+ * separated by semicolons, with an optional trailing semicolon. Semicolons
+ * within elements are escaped as "\;". Like glib-keyfiles, elements are
+ * unescaped as strings, so "\s", "\n", "\t", "\r", and "\\" are decoded as
+ * well. Unknown escapes are retained verbatim.
+ *
+ * A list iterator walks the value of an entry and yields each element as a
+ * span of the value, without copying it. Only elements that contain a
+ * backslash are decoded, into a buffer owned by the iterator. The buffer is
+ * reused for all following elements, so iterating a list allocates at most a
+ * handful of times, no matter how many elements it has.
+ *
+ * Separators are found via memchr(3), which is vectorized by the C library.
+ */
+
+#include <c-stdaux.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include "c-ini.h"
+#include "c-ini-private.h"
+
+_c_public_ void c_ini_list_init(CIniList *list, CIniEntry *entry) {
+        *list = (CIniList)C_INI_LIST_NULL(*list);
+        list->data = c_ini_entry_get_value(entry, &list->n_data);
+}
+
+_c_public_ void c_ini_list_deinit(CIniList *list) {
+        free(list->buffer);
+        *list = (CIniList)C_INI_LIST_NULL(*list);
+}
+
+static int c_ini_list_reserve(CIniList *list, size_t n) {
+        char *buffer;
+
+        if (n <= list->z_buffer)
+                return 0;
+
+        n = c_max(n, list->z_buffer * 2);
+        buffer = realloc(list->buffer, n);
+        if (!buffer)
+                return -ENOMEM;
+
+        list->buffer = buffer;
+        list->z_buffer = n;
+        return 0;
+}
+
+static int c_ini_list_decode(CIniList *list, const char **elementp, size_t *n_elementp) {
+        const char *data = list->data, *end = list->data + list->n_data;
+        size_t n = 0;
+        char c;
+        int r;
+
+        /*
+         * Decode the next element into the buffer. The decoded element is
+         * never longer than its encoded form, so reserve that up-front.
+         */
+
+        r = c_ini_list_reserve(list, list->n_data + 1);
+        if (r)
+                return r;
+
+        while (data < end && *data != ';') {
+                if (*data != '\\' || data + 1 >= end) {
+                        list->buffer[n++] = *data++;
+                        continue;
+                }
+
+                c = data[1] == ';' ? ';' : c_ini_unescape(data[1]);
+                if (!c) {
+                        list->buffer[n++] = '\\';
+                        c = data[1];
+                }
+
+                list->buffer[n++] = c;
+                data += 2;
+        }
+
+        list->buffer[n] = 0;
+
+        if (data < end)
+                ++data;
+
+        list->n_data -= data - list->data;
+        list->data = data;
+
+        *elementp = list->buffer;
+        *n_elementp = n;
+        return 1;
+}
+
+_c_public_ int c_ini_list_next(CIniList *list, const char **elementp, size_t *n_elementp) {
+        const char *separator;
+        size_t n;
+
+        /*
+         * Return the next element and 1, or 0 if the list is exhausted. The
+         * element is not zero-terminated, and is only valid until the next
+         * call on the iterator.
+         */
+
+        if (!list->n_data)
+                return 0;
+
+        separator = memchr(list->data, ';', list->n_data);
+        n = separator ? (size_t)(separator - list->data) : list->n_data;
+
+        if (memchr(list->data, '\\', n))
+                return c_ini_list_decode(list, elementp, n_elementp);
+
+        *elementp = list->data;
+        *n_elementp = n;
+
+        if (separator)
+                ++n;
+
+        list->data += n;
+        list->n_data -= n;
+        return 1;
+}
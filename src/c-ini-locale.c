@@ -0,0 +1,199 @@
+/*
+ * Ini-File Localized Keys
+ *
+ * The XDG desktop-entry specification allows keys to be localized as
+ * `Key[LOCALE]`. To look up a key for the locale `lang_COUNTRY@MODIFIER`,
+ * the variants `lang_COUNTRY@MODIFIER`, `lang_COUNTRY`, `lang@MODIFIER`, and
+ * `lang` are tried in this order, before falling back to the untranslated
+ * key. The encoding part of a locale is ignored.
+ *
+ * Rather than looking up each variant individually, groups index all their
+ * localized entries by the hash of their base key when they are linked. A
+ * lookup walks the probe sequence of the base key once, and ranks all
+ * variants it finds against the requested locale. Only if no variant
+ * matches, the untranslated key is looked up.
+ *
+ * Frozen groups, and groups whose index could not be allocated, rank all
+ * their entries in a single linear sweep instead.
+ */
+
+#include <c-stdaux.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include "c-ini.h"
+#include "c-ini-private.h"
+
+void c_ini_locale_parse(CIniLocale *locale, const char *data, size_t n_data) {
+        const char *end = data + n_data, *p;
+
+        /* split `lang_COUNTRY.ENCODING@MODIFIER` into its parts */
+
+        *locale = (CIniLocale)C_INI_LOCALE_NULL(*locale);
+
+        p = memchr(data, '@', n_data);
+        if (p) {
+                locale->modifier = p + 1;
+                locale->n_modifier = end - p - 1;
+                end = p;
+        }
+
+        p = memchr(data, '.', end - data);
+        if (p)
+                end = p;
+
+        p = memchr(data, '_', end - data);
+        if (p) {
+                locale->country = p + 1;
+                locale->n_country = end - p - 1;
+                end = p;
+        }
+
+        locale->lang = data;
+        locale->n_lang = end - data;
+}
+
+static bool c_ini_locale_equal(const char *a, size_t n_a, const char *b, size_t n_b) {
+        return n_a == n_b && !memcmp(a, b, n_a);
+}
+
+unsigned int c_ini_locale_match(const CIniLocale *locale, const char *data, size_t n_data) {
+        CIniLocale variant;
+
+        /*
+         * Rank the locale @data as variant of @locale. Returns 0 if it does
+         * not match, otherwise a higher rank denotes a better match.
+         */
+
+        c_ini_locale_parse(&variant, data, n_data);
+
+        if (!variant.n_lang ||
+            !c_ini_locale_equal(variant.lang, variant.n_lang, locale->lang, locale->n_lang))
+                return 0;
+        if (variant.country &&
+            !c_ini_locale_equal(variant.country, variant.n_country, locale->country, locale->n_country))
+                return 0;
+        if (variant.modifier &&
+            !c_ini_locale_equal(variant.modifier, variant.n_modifier, locale->modifier, locale->n_modifier))
+                return 0;
+
+        return 1 + (variant.country ? 2 : 0) + (variant.modifier ? 1 : 0);
+}
+
+static size_t c_ini_locale_split(const uint8_t *key, size_t n_key) {
+        const uint8_t *p;
+
+        /* return the length of the base key, or @n_key if not localized */
+
+        if (n_key < 3 || key[n_key - 1] != ']')
+                return n_key;
+
+        p = memchr(key, '[', n_key);
+        if (!p || p == key || p + 2 >= key + n_key)
+                return n_key;
+
+        return p - key;
+}
+
+void c_ini_locale_link(CIniEntry *entry, CIniGroup *group) {
+        CIniEntry *iter;
+        int r;
+
+        entry->n_base = c_ini_locale_split(entry->key, entry->n_key);
+        if (entry->n_base == entry->n_key || group->unindexed_locales)
+                return;
+
+        entry->base_hash = c_ini_hash(entry->key, entry->n_base);
+
+        /* see c_ini_group_index_add() */
+
+        if (!c_ini_index_is_full(&group->index_locales)) {
+                c_ini_index_add(&group->index_locales, entry->base_hash, entry);
+                return;
+        }
+
+        r = c_ini_index_reset(&group->index_locales, group->index_locales.n_live + 1);
+        if (r) {
+                c_ini_index_deinit(&group->index_locales);
+                group->unindexed_locales = true;
+                return;
+        }
+
+        c_list_for_each_entry(iter, &group->list_entries, link_group)
+                if (iter->n_base < iter->n_key)
+                        c_ini_index_add(&group->index_locales, iter->base_hash, iter);
+}
+
+void c_ini_locale_unlink(CIniEntry *entry) {
+        if (entry->n_base < entry->n_key && !entry->group->unindexed_locales)
+                c_ini_index_remove(&entry->group->index_locales, entry->base_hash, entry);
+}
+
+static CIniEntry *c_ini_locale_sweep(CIniGroup *group, const char *key, size_t n_key, const CIniLocale *locale) {
+        CIniEntry *entry, *best = NULL;
+        unsigned int rank, best_rank = 0;
+        const char *k;
+        size_t n_k;
+
+        /* rank all localized entries of @group, the earliest one wins ties */
+
+        for (entry = c_ini_group_iterate(group); entry; entry = c_ini_entry_next(entry)) {
+                k = c_ini_entry_get_key(entry, &n_k);
+                if (n_k <= n_key || memcmp(k, key, n_key))
+                        continue;
+                if (c_ini_locale_split((const uint8_t *)k, n_k) != n_key)
+                        continue;
+
+                rank = c_ini_locale_match(locale, k + n_key + 1, n_k - n_key - 2);
+                if (rank > best_rank) {
+                        best = entry;
+                        best_rank = rank;
+                }
+        }
+
+        return best;
+}
+
+_c_public_ CIniEntry *c_ini_group_find_locale(CIniGroup *group,
+                                              const char *key,
+                                              ssize_t n_key,
+                                              const char *locale) {
+        CIniLocale parsed = C_INI_LOCALE_NULL(parsed);
+        CIniEntry *entry, *best = NULL;
+        unsigned int rank, best_rank = 0;
+        uint64_t hash;
+        size_t i = 0;
+
+        /*
+         * Find the entry of @key that best matches @locale, or the
+         * untranslated entry if no localized one matches. If @locale is NULL,
+         * only the untranslated entry is considered.
+         */
+
+        if (n_key < 0)
+                n_key = strlen(key);
+        if (!locale)
+                return c_ini_group_find(group, key, n_key);
+
+        c_ini_locale_parse(&parsed, locale, strlen(locale));
+
+        if (c_ini_is_frozen(group) || group->unindexed_locales) {
+                best = c_ini_locale_sweep(group, key, n_key, &parsed);
+        } else if (group->index_locales.n_live) {
+                hash = c_ini_hash((const uint8_t *)key, n_key);
+                while ((entry = c_ini_index_next(&group->index_locales, hash, &i))) {
+                        if (entry->n_base != (size_t)n_key || memcmp(entry->key, key, n_key))
+                                continue;
+
+                        rank = c_ini_locale_match(&parsed,
+                                                  (const char *)entry->key + n_key + 1,
+                                                  entry->n_key - n_key - 2);
+                        if (rank > best_rank) {
+                                best = entry;
+                                best_rank = rank;
+                        }
+                }
+        }
+
+        return best ?: c_ini_group_find(group, key, n_key);
+}
@@ -0,0 +1,400 @@
+/*
+ * Ini-File Parallel Reader
+ *
+ * Input can be parsed on multiple threads. The input is split into tasks,
+ * each covering complete lines only: either chunks of a single buffer, or
+ * entire files. Each task is run by a worker, which scans and classifies its
+ * lines, and creates the raw lines, groups, and entries from an arena private
+ * to the task. Nothing is linked into the domain by the workers. Once all
+ * tasks are done, the parsed lines are linked into the domain in their
+ * original order, using the exact same logic as the serial reader. Hence, the
+ * result is identical to a serial parse, regardless of the mode of the
+ * reader.
+ */
+
+#include <c-stdaux.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "c-ini.h"
+#include "c-ini-private.h"
+
+typedef struct CIniWorker CIniWorker;
+
+struct CIniWorker {
+        pthread_t thread;
+        CIniTask *tasks;
+        size_t n_tasks;
+        atomic_size_t *next;
+};
+
+void c_ini_task_init(CIniTask *task, CIniReader *reader) {
+        *task = (CIniTask)C_INI_TASK_NULL(*task);
+        task->mode = reader->mode;
+        task->borrow = reader->mode & C_INI_MODE_BORROW_DATA;
+        task->scan = reader->scan;
+}
+
+void c_ini_task_deinit(CIniTask *task) {
+        size_t i;
+
+        for (i = 0; i < task->n_lines; ++i) {
+                c_ini_entry_unref(task->lines[i].entry);
+                c_ini_group_unref(task->lines[i].group);
+                c_ini_raw_unref(task->lines[i].raw);
+        }
+
+        free(task->lines);
+        c_ini_arena_unref(task->arena);
+        *task = (CIniTask)C_INI_TASK_NULL(*task);
+}
+
+static int c_ini_task_parse_line(CIniTask *task, const uint8_t *data, size_t n_data, const CIniScan *scan) {
+        CIniTaskLine *line;
+        size_t z;
+        void *p;
+        int r;
+
+        if (task->n_lines >= task->z_lines) {
+                z = task->z_lines ? task->z_lines * 2 : 1024;
+                if (z < task->z_lines || z > SIZE_MAX / sizeof(*task->lines))
+                        return -ENOMEM;
+
+                p = realloc(task->lines, z * sizeof(*task->lines));
+                if (!p)
+                        return -ENOMEM;
+
+                task->lines = p;
+                task->z_lines = z;
+        }
+
+        line = &task->lines[task->n_lines++];
+        *line = (CIniTaskLine){};
+
+        if (task->borrow)
+                r = c_ini_raw_new_borrowed(&line->raw, task->arena, data, n_data);
+        else
+                r = c_ini_raw_new(&line->raw, task->arena, data, n_data);
+        if (r)
+                return r;
+
+        c_ini_line_parse(&line->line, task->mode, line->raw->data, line->raw->n_data, scan);
+
+        switch (line->line.type) {
+        case C_INI_LINE_GROUP:
+                return c_ini_reader_new_group(&line->group, task->arena, task->mode, line->raw, &line->line);
+        case C_INI_LINE_ENTRY:
+                return c_ini_reader_new_entry(&line->entry, task->arena, task->mode, line->raw, &line->line);
+        default:
+                return 0;
+        }
+}
+
+static int c_ini_task_parse(CIniTask *task, const uint8_t *data, size_t n_data) {
+        CIniScan scan;
+        size_t n;
+        int r;
+
+        /*
+         * The data of a task consists of complete lines only. Only the last
+         * line might lack a trailing newline.
+         */
+
+        while (n_data) {
+                task->scan(data, n_data, &scan);
+                n = c_min(scan.i_newline + 1, n_data);
+
+                r = c_ini_task_parse_line(task, data, n, &scan);
+                if (r)
+                        return r;
+
+                n_data -= n;
+                data += n;
+        }
+
+        return 0;
+}
+
+static int c_ini_task_parse_stream(CIniTask *task, int fd) {
+        _c_cleanup_(c_ini_freep) uint8_t *buffer = NULL;
+        size_t n_buffer = 0, z_buffer = 0;
+        ssize_t l;
+        void *p;
+
+        /*
+         * Files that cannot be mapped are read into a buffer in full. The
+         * buffer is released once the task is parsed, so it must not be
+         * borrowed.
+         */
+
+        for (;;) {
+                if (z_buffer - n_buffer < C_INI_INITIAL_LINE_SIZE) {
+                        if (z_buffer > SIZE_MAX / 2)
+                                return -ENOMEM;
+
+                        z_buffer = z_buffer ? z_buffer * 2 : C_INI_INITIAL_LINE_SIZE;
+                        p = realloc(buffer, z_buffer);
+                        if (!p)
+                                return -ENOMEM;
+
+                        buffer = p;
+                }
+
+                l = read(fd, buffer + n_buffer, z_buffer - n_buffer);
+                if (l < 0) {
+                        if (errno == EINTR)
+                                continue;
+                        return -errno;
+                } else if (!l) {
+                        break;
+                }
+
+                n_buffer += l;
+        }
+
+        task->borrow = false;
+        return c_ini_task_parse(task, buffer, n_buffer);
+}
+
+static int c_ini_task_parse_path(CIniTask *task) {
+        _c_cleanup_(c_closep) int fd = -1;
+        struct stat st;
+        size_t n;
+        void *p;
+        int r;
+
+        /*
+         * Drop-ins can vanish, or turn out to be directories, after they were
+         * collected. Like missing drop-in directories, they are skipped.
+         */
+
+        fd = open(task->path, O_RDONLY | O_CLOEXEC | O_NOCTTY);
+        if (fd < 0)
+                return errno == ENOENT ? 0 : -errno;
+
+        if (fstat(fd, &st) < 0)
+                return -errno;
+        if (S_ISDIR(st.st_mode))
+                return 0;
+
+        /* see c_ini_reader_feed_fd() for details */
+        if (!S_ISREG(st.st_mode) || st.st_size <= 0)
+                return c_ini_task_parse_stream(task, fd);
+        if ((uintmax_t)st.st_size > SIZE_MAX)
+                return -EFBIG;
+
+        n = st.st_size;
+
+        p = mmap(NULL, n, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p == MAP_FAILED)
+                return -errno;
+
+        (void)madvise(p, n, MADV_SEQUENTIAL);
+
+        if (!task->borrow) {
+                r = c_ini_task_parse(task, p, n);
+                munmap(p, n);
+                return r;
+        }
+
+        r = c_ini_arena_add_mapping(task->arena, p, n);
+        if (r) {
+                munmap(p, n);
+                return r;
+        }
+
+        return c_ini_task_parse(task, p, n);
+}
+
+static void c_ini_task_run(CIniTask *task) {
+        int r;
+
+        r = c_ini_arena_new(&task->arena);
+        if (r)
+                goto exit;
+
+        if (task->path)
+                r = c_ini_task_parse_path(task);
+        else
+                r = c_ini_task_parse(task, task->data, task->n_data);
+
+exit:
+        task->r = r;
+}
+
+static void *c_ini_worker_run(void *userdata) {
+        CIniWorker *worker = userdata;
+        size_t i;
+
+        /* pick tasks in order, until all are taken */
+        while ((i = atomic_fetch_add(worker->next, 1)) < worker->n_tasks)
+                c_ini_task_run(&worker->tasks[i]);
+
+        return NULL;
+}
+
+static size_t c_ini_task_n_threads(unsigned int n_threads) {
+        long n_cpus;
+
+        if (!n_threads) {
+                n_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+                n_threads = n_cpus > 0 ? n_cpus : 1;
+        }
+
+        return n_threads;
+}
+
+int c_ini_task_run_all(CIniTask *tasks, size_t n_tasks, unsigned int n_threads) {
+        _c_cleanup_(c_ini_freep) CIniWorker *workers = NULL;
+        atomic_size_t next = 0;
+        size_t i, n_workers;
+        int r;
+
+        /*
+         * Run all tasks on up to @n_threads threads, including the calling
+         * thread. If a thread cannot be spawned, the remaining threads pick up
+         * its share. Returns the first error of any task, in task order.
+         */
+
+        n_workers = c_min(c_ini_task_n_threads(n_threads), n_tasks);
+        if (n_workers > 1) {
+                workers = calloc(n_workers, sizeof(*workers));
+                if (!workers)
+                        return -ENOMEM;
+        }
+
+        for (i = 1; i < n_workers; ++i) {
+                workers[i].tasks = tasks;
+                workers[i].n_tasks = n_tasks;
+                workers[i].next = &next;
+
+                if (pthread_create(&workers[i].thread, NULL, c_ini_worker_run, &workers[i]))
+                        break;
+        }
+
+        n_workers = i;
+
+        c_ini_worker_run(&(CIniWorker){ .tasks = tasks, .n_tasks = n_tasks, .next = &next });
+
+        for (i = 1; i < n_workers; ++i)
+                pthread_join(workers[i].thread, NULL);
+
+        for (i = 0; i < n_tasks; ++i) {
+                r = tasks[i].r;
+                if (r)
+                        return r;
+        }
+
+        return 0;
+}
+
+void c_ini_task_link(CIniTask *task, CIniReader *reader) {
+        CIniTaskLine *line;
+        size_t i;
+        int r;
+
+        /*
+         * Link all lines of the task in order. All objects were created
+         * already, so this cannot fail.
+         */
+
+        for (i = 0; i < task->n_lines; ++i) {
+                line = &task->lines[i];
+
+                r = c_ini_reader_link_line(reader, line->raw, &line->line, line->group, line->entry);
+                c_assert(!r);
+        }
+}
+
+_c_public_ int c_ini_reader_feed_parallel(CIniReader *reader,
+                                          const uint8_t *data,
+                                          size_t n_data,
+                                          unsigned int n_threads) {
+        bool borrow = reader->mode & C_INI_MODE_BORROW_DATA;
+        CIniTask *tasks = NULL;
+        size_t i, j, n, n_tasks;
+        const uint8_t *p;
+        int r;
+
+        /*
+         * Callbacks and limits need the lines in order, and the pool of
+         * reused objects is not safe for concurrent use, so parse serially.
+         */
+        if (reader->callbacks || reader->limited || reader->previous || reader->reuse)
+                return c_ini_reader_feed_internal(reader, data, n_data, borrow);
+
+        /*
+         * If a line was carried over from a previous call, complete it first.
+         * Similarly, the trailing incomplete line is carried over to the next
+         * call. Both are handled by the serial reader.
+         */
+
+        if (reader->n_line) {
+                p = memchr(data, '\n', n_data);
+                n = p ? (size_t)(p - data + 1) : n_data;
+
+                r = c_ini_reader_feed_internal(reader, data, n, borrow);
+                if (r)
+                        return r;
+
+                data += n;
+                n_data -= n;
+        }
+
+        p = memrchr(data, '\n', n_data);
+        n = p ? (size_t)(p - data + 1) : 0;
+
+        n_tasks = c_min(n / C_INI_PARALLEL_CHUNK_SIZE, c_ini_task_n_threads(n_threads));
+        if (n_tasks < 2)
+                return c_ini_reader_feed_internal(reader, data, n_data, borrow);
+
+        r = c_ini_reader_prepare(reader);
+        if (r)
+                return r;
+
+        tasks = calloc(n_tasks, sizeof(*tasks));
+        if (!tasks)
+                return -ENOMEM;
+
+        /*
+         * Split the data into chunks of roughly equal size, and move each
+         * split point forward to the next line boundary.
+         */
+        for (i = 0, j = 0; i < n_tasks; ++i) {
+                CIniTask *task = &tasks[i];
+                size_t end = (i + 1 == n_tasks) ? n : (n / n_tasks) * (i + 1);
+
+                if (end < j)
+                        end = j;
+                if (end < n) {
+                        p = memchr(data + end, '\n', n - end);
+                        end = p - data + 1;
+                }
+
+                c_ini_task_init(task, reader);
+                task->data = data + j;
+                task->n_data = end - j;
+                j = end;
+        }
+
+        r = c_ini_task_run_all(tasks, n_tasks, n_threads);
+        if (!r) {
+                for (i = 0; i < n_tasks; ++i)
+                        c_ini_task_link(&tasks[i], reader);
+        }
+
+        for (i = 0; i < n_tasks; ++i)
+                c_ini_task_deinit(&tasks[i]);
+        free(tasks);
+
+        if (r)
+                return r;
+
+        return c_ini_reader_feed_internal(reader, data + n, n_data - n, borrow);
+}
@@ -4,15 +4,127 @@
 #include <c-rbtree.h>
 #include <c-stdaux.h>
 #include <inttypes.h>
+#include <stdatomic.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdlib.h>
 #include "c-ini.h"
 
+#ifndef C_INI_ATOMIC_REFS
+#  define C_INI_ATOMIC_REFS 0
+#endif
+
+typedef struct CIniArena CIniArena;
+typedef struct CIniArenaBlock CIniArenaBlock;
+typedef struct CIniArenaMapping CIniArenaMapping;
 typedef struct CIniBytes CIniBytes;
+typedef struct CIniCacheHeader CIniCacheHeader;
+typedef struct CIniCacheSource CIniCacheSource;
+typedef struct CIniDecoded CIniDecoded;
+typedef struct CIniFrozen CIniFrozen;
+typedef struct CIniFrozenEntry CIniFrozenEntry;
+typedef struct CIniFrozenGroup CIniFrozenGroup;
+typedef struct CIniIndex CIniIndex;
+typedef struct CIniIndexSlot CIniIndexSlot;
+typedef bool (*CIniIndexMatchFn) (const void *key, void *p);
+typedef struct CIniLine CIniLine;
+typedef struct CIniLocale CIniLocale;
 typedef struct CIniRaw CIniRaw;
+typedef struct CIniReuse CIniReuse;
+typedef struct CIniReuseLine CIniReuseLine;
+typedef struct CIniScan CIniScan;
+typedef struct CIniValue CIniValue;
+typedef int (*CIniValueParseFn) (const char *data, size_t n_data, CIniValue *value);
+typedef struct CIniTask CIniTask;
+typedef struct CIniTaskLine CIniTaskLine;
+typedef void (*CIniScanFn) (const uint8_t *data, size_t n_data, CIniScan *scan);
+
+/*
+ * Reference counters are plain integers by default, so references must not be
+ * acquired or released concurrently. If built with `C_INI_ATOMIC_REFS`, they
+ * are atomic, and objects can be referenced and released from any thread.
+ */
+#if C_INI_ATOMIC_REFS
+typedef atomic_ulong CIniRef;
+#else
+typedef unsigned long CIniRef;
+#endif
 
 /* initial size of the line buffer */
 #define C_INI_INITIAL_LINE_SIZE (4096U)
+/* maximum size of the line buffer to retain across lines */
+#define C_INI_RETAINED_LINE_SIZE (64U * 1024U)
+/* minimum size of a chunk for parallel parsing */
+#define C_INI_PARALLEL_CHUNK_SIZE (64U * 1024U)
+
+/* initial and maximum size of arena blocks */
+#define C_INI_ARENA_BLOCK_MIN (16U * 1024U)
+#define C_INI_ARENA_BLOCK_MAX (1024U * 1024U)
+
+struct CIniArenaBlock {
+        CIniArenaBlock *next;
+        size_t n_data;
+        size_t i_data;
+        max_align_t data[];
+};
+
+struct CIniArenaMapping {
+        CIniArenaMapping *next;
+        void *p;
+        size_t n;
+};
+
+struct CIniArena {
+        CIniRef n_refs;
+        CIniArenaBlock *blocks;
+        CIniArenaMapping *mappings;
+        size_t z_next;
+};
+
+#define C_INI_ARENA_NULL(_x) {                                                  \
+                .n_refs = 1,                                                    \
+                .z_next = C_INI_ARENA_BLOCK_MIN,                                \
+        }
+
+struct CIniScan {
+        size_t i_newline;
+        size_t i_assignment;
+        size_t i_bracket;
+};
+
+#define C_INI_SCAN_NULL {                                                       \
+                .i_newline = SIZE_MAX,                                          \
+                .i_assignment = SIZE_MAX,                                       \
+                .i_bracket = SIZE_MAX,                                          \
+        }
+
+/* scanners in order of preference, each implies the ones before it */
+enum {
+        C_INI_SCANNER_GENERIC,
+        C_INI_SCANNER_SSE2,
+        C_INI_SCANNER_AVX2,
+};
+
+/* line types are reported to tokenizers as is */
+enum {
+        C_INI_LINE_BLANK                = C_INI_TOKEN_BLANK,
+        C_INI_LINE_COMMENT              = C_INI_TOKEN_COMMENT,
+        C_INI_LINE_GROUP                = C_INI_TOKEN_GROUP,
+        C_INI_LINE_ENTRY                = C_INI_TOKEN_ENTRY,
+        C_INI_LINE_MALFORMED            = C_INI_TOKEN_MALFORMED,
+};
+
+struct CIniLine {
+        unsigned int type;
+        size_t i_key;
+        size_t n_key;
+        size_t i_value;
+        size_t n_value;
+};
+
+#define C_INI_LINE_NULL {                                                       \
+                .type = C_INI_LINE_BLANK,                                       \
+        }
 
 struct CIniBytes {
         uint8_t *data;
@@ -24,16 +136,100 @@ struct CIniBytes {
                 .n_data = (_n_data),                                            \
         }
 
+/*
+ * Localized keys have the form `Key[LOCALE]`, where the locale has the form
+ * `lang_COUNTRY.ENCODING@MODIFIER`, and all but `lang` are optional. The
+ * encoding is ignored for matching.
+ */
+struct CIniLocale {
+        const char *lang;
+        size_t n_lang;
+        const char *country;
+        size_t n_country;
+        const char *modifier;
+        size_t n_modifier;
+};
+
+#define C_INI_LOCALE_NULL(_x) {                                                 \
+        }
+
+struct CIniIndexSlot {
+        uint64_t hash;
+        void *p;
+};
+
+struct CIniIndex {
+        CIniIndexSlot *slots;
+        size_t n_slots;
+        size_t n_used;
+        size_t n_live;
+};
+
+#define C_INI_INDEX_NULL(_x) {                                                  \
+        }
+
+/*
+ * Typed values are parsed on first access and cached in their entry. The
+ * cache holds a single type, the first one requested, and records parser
+ * errors as well. It is claimed and published atomically, so concurrent
+ * readers of a sealed domain either see a complete cache or parse themselves.
+ */
+enum {
+        C_INI_VALUE_NONE,
+        C_INI_VALUE_BUSY,
+        C_INI_VALUE_BOOL,
+        C_INI_VALUE_INT64,
+        C_INI_VALUE_UINT64,
+        C_INI_VALUE_DOUBLE,
+        C_INI_VALUE_SIZE,
+};
+
+struct CIniValue {
+        int r;
+        union {
+                bool b;
+                int64_t i64;
+                uint64_t u64;
+                double d;
+        };
+};
+
+/*
+ * Values that contain escape sequences are decoded on first access, and the
+ * decoded string is cached in their entry. Values without escapes are
+ * returned as is, which is cached as `C_INI_DECODED_VERBATIM`.
+ */
+struct CIniDecoded {
+        size_t n_data;
+        char data[];
+};
+
+#define C_INI_DECODED_VERBATIM ((CIniDecoded *)&c_ini_decoded_verbatim)
+
+extern const CIniDecoded c_ini_decoded_verbatim;
+
 struct CIniEntry {
-        unsigned long n_refs;
+        CIniRef n_refs;
         CIniGroup *group;
         CList link_group;
         CRBNode rb_group;
+        CIniArena *arena;
+        CIniRaw *raw;
 
+        uint64_t hash;
+        uint64_t base_hash;
         uint8_t *key;
         size_t n_key;
+        size_t n_base;
         uint8_t *value;
         size_t n_value;
+
+        atomic_uint cache_type;
+        CIniValue cache;
+        _Atomic(CIniDecoded *) decoded;
+        _Atomic(uint64_t) value_hash;
+
+        uint8_t storage[];
 };
 
 #define C_INI_ENTRY_NULL(_x) {                                                  \
@@ -43,16 +239,26 @@ struct CIniEntry {
         }
 
 struct CIniGroup {
-        unsigned long n_refs;
+        CIniRef n_refs;
         CList link_domain;
         CRBNode rb_domain;
         CIniDomain *domain;
+        CIniArena *arena;
+        CIniRaw *raw;
 
+        uint64_t hash;
         uint8_t *label;
         size_t n_label;
 
         CList list_entries;
         CRBTree map_entries;
+        CIniIndex index_entries;
+        size_t n_entries;
+        CIniIndex index_locales;
+        bool indexed : 1;
+        bool unindexed_locales : 1;
+
+        uint8_t storage[];
 };
 
 #define C_INI_GROUP_NULL(_x) {                                                  \
@@ -61,15 +267,19 @@ struct CIniGroup {
                 .rb_domain = C_RBNODE_INIT((_x).rb_domain),                     \
                 .list_entries = C_LIST_INIT((_x).list_entries),                 \
                 .map_entries = C_RBTREE_INIT,                                   \
+                .index_entries = C_INI_INDEX_NULL((_x).index_entries),          \
+                .index_locales = C_INI_INDEX_NULL((_x).index_locales),          \
         }
 
 struct CIniRaw {
-        unsigned long n_refs;
+        CIniRef n_refs;
         CList link_domain;
         CIniDomain *domain;
+        CIniArena *arena;
 
+        const uint8_t *data;
         size_t n_data;
-        uint8_t data[];
+        uint8_t storage[];
 };
 
 #define C_INI_RAW_NULL(_x) {                                                    \
@@ -77,13 +287,99 @@ struct CIniRaw {
                 .link_domain = C_LIST_INIT((_x).link_domain),                   \
         }
 
+/*
+ * A frozen domain stores all its groups, entries, and strings in a single
+ * block, which is position-independent and does not contain any pointers
+ * (except for the back-pointer to the owning domain, which is set when the
+ * block is attached). All references are 32-bit offsets relative to the start
+ * of the block, or indices into the group and entry arrays.
+ *
+ * Group 0 is the null group, all other groups follow in order. The entries of
+ * a group are stored consecutively, in order. For lookups, the block contains
+ * sorted indices of all groups and, for each group, of all its entries. Ties
+ * are ordered by index, so lookups find the earliest addition. Values that
+ * contain escape sequences store their decoded string in the table as well.
+ *
+ * Frozen groups and entries are handed out as `CIniGroup` and `CIniEntry`
+ * pointers. They start with a reference counter that is always 0, which
+ * tells them apart from dynamic objects. Their references are forwarded to
+ * the owning domain.
+ */
+struct CIniFrozen {
+        CIniDomain *domain;
+        uint32_t n_size;
+        uint32_t n_groups;
+        uint32_t n_entries;
+        uint32_t groups;
+        uint32_t entries;
+        uint32_t index_groups;
+        uint32_t index_entries;
+};
+
+struct CIniFrozenGroup {
+        CIniRef n_refs;
+        uint32_t offset;
+        uint32_t label;
+        uint32_t n_label;
+        uint32_t i_entry;
+        uint32_t n_entries;
+};
+
+struct CIniFrozenEntry {
+        CIniRef n_refs;
+        uint32_t offset;
+        uint32_t i_group;
+        uint32_t key;
+        uint32_t n_key;
+        uint32_t value;
+        uint32_t n_value;
+        uint32_t decoded;
+        uint32_t n_decoded;
+};
+
+/*
+ * Cache files start with a header, followed by the stamps of all source files
+ * the cache was generated from, their paths, and finally the frozen block of
+ * the domain. All offsets are relative to the start of the file. The frozen
+ * block uses native types, hence cache files are only valid on machines with
+ * the same byte-order and word-size as the writer.
+ */
+#define C_INI_CACHE_SIGNATURE { 'c', '-', 'i', 'n', 'i', 'c', 'a', 'c' }
+#define C_INI_CACHE_VERSION (2U)
+#define C_INI_CACHE_BYTEORDER (0x01020304U)
+
+struct CIniCacheHeader {
+        uint8_t signature[8];
+        uint32_t version;
+        uint32_t byteorder;
+        uint32_t wordsize;
+        uint32_t n_sources;
+        uint64_t sources;
+        uint64_t frozen;
+        uint64_t n_frozen;
+};
+
+struct CIniCacheSource {
+        uint64_t size;
+        int64_t mtime_sec;
+        int64_t mtime_nsec;
+        uint64_t hash;
+        uint64_t path;
+        uint64_t n_path;
+};
+
 struct CIniDomain {
-        unsigned long n_refs;
+        CIniRef n_refs;
+        unsigned int mode;
+        CIniArena *arena;
+        CIniFrozen *frozen;
         CIniGroup *null_group;
 
         CList list_raws;
         CList list_groups;
         CRBTree map_groups;
+        CIniIndex index_groups;
+        bool indexed : 1;
 };
 
 #define C_INI_DOMAIN_NULL(_x) {                                                 \
@@ -91,14 +387,44 @@ struct CIniDomain {
                 .list_raws = C_LIST_INIT((_x).list_raws),                       \
                 .list_groups = C_LIST_INIT((_x).list_groups),                   \
                 .map_groups = C_RBTREE_INIT,                                    \
+                .index_groups = C_INI_INDEX_NULL((_x).index_groups),            \
+        }
+
+struct CIniReuseLine {
+        CIniRaw *raw;
+        CIniGroup *group;
+        CIniEntry *entry;
+};
+
+struct CIniReuse {
+        CIniIndex index;
+        CIniReuseLine *lines;
+        size_t n_lines;
+};
+
+#define C_INI_REUSE_NULL(_x) {                                                  \
+                .index = C_INI_INDEX_NULL((_x).index),                          \
         }
 
 struct CIniReader {
         unsigned int mode;
+        CIniScanFn scan;
+
+        const CIniCallbacks *callbacks;
+        void *userdata;
+
+        CIniLimits limits;
+        bool limited : 1;
+        size_t n_groups;
+        size_t n_entries;
+        size_t n_bytes;
 
         CIniDomain *domain;
         CIniGroup *current;
 
+        CIniDomain *previous;
+        CIniReuse *reuse;
+
         bool malformed : 1;
 
         uint8_t *line;
@@ -107,40 +433,171 @@ struct CIniReader {
 };
 
 #define C_INI_READER_NULL(_x) {                                                 \
+                .limits = C_INI_LIMITS_NULL((_x).limits),                       \
         }
 
+struct CIniTaskLine {
+        CIniRaw *raw;
+        CIniLine line;
+        CIniGroup *group;
+        CIniEntry *entry;
+};
+
+struct CIniTask {
+        unsigned int mode;
+        bool borrow;
+        CIniScanFn scan;
+
+        const char *path;
+        const uint8_t *data;
+        size_t n_data;
+
+        CIniArena *arena;
+        CIniTaskLine *lines;
+        size_t n_lines;
+        size_t z_lines;
+        int r;
+};
+
+#define C_INI_TASK_NULL(_x) {                                                   \
+        }
+
+/* arenas */
+
+int c_ini_arena_new(CIniArena **arenap);
+CIniArena *c_ini_arena_ref(CIniArena *arena);
+CIniArena *c_ini_arena_unref(CIniArena *arena);
+
+void *c_ini_arena_alloc(CIniArena *arena, size_t n);
+void c_ini_arena_free(CIniArena *arena, void *p);
+int c_ini_arena_add_mapping(CIniArena *arena, void *p, size_t n);
+
+/* indices */
+
+void c_ini_index_deinit(CIniIndex *index);
+int c_ini_index_reset(CIniIndex *index, size_t n);
+
+bool c_ini_index_is_full(CIniIndex *index);
+void c_ini_index_add(CIniIndex *index, uint64_t hash, void *p);
+void c_ini_index_remove(CIniIndex *index, uint64_t hash, void *p);
+void *c_ini_index_find(CIniIndex *index, uint64_t hash, CIniIndexMatchFn match, const void *key);
+void *c_ini_index_next(CIniIndex *index, uint64_t hash, size_t *ip);
+
+/* scanners */
+
+unsigned int c_ini_scan_detect(void);
+CIniScanFn c_ini_scan_select(unsigned int scanner);
+
 /* entries */
 
-int c_ini_entry_new(CIniEntry **entryp, const uint8_t *key, size_t n_key, const uint8_t *value, size_t n_value);
+int c_ini_entry_new(CIniEntry **entryp, CIniArena *arena, const uint8_t *key, size_t n_key, const uint8_t *value, size_t n_value);
+int c_ini_entry_new_borrowed(CIniEntry **entryp, CIniArena *arena, CIniRaw *raw, const uint8_t *key, size_t n_key, const uint8_t *value, size_t n_value);
 
 void c_ini_entry_link(CIniEntry *entry, CIniGroup *group);
 void c_ini_entry_unlink(CIniEntry *entry);
 
 /* groups */
 
-int c_ini_group_new(CIniGroup **groupp, const uint8_t *label, size_t n_label);
+int c_ini_group_new(CIniGroup **groupp, CIniArena *arena, const uint8_t *label, size_t n_label);
+int c_ini_group_new_borrowed(CIniGroup **groupp, CIniArena *arena, CIniRaw *raw, const uint8_t *label, size_t n_label);
 
 void c_ini_group_link(CIniGroup *group, CIniDomain *domain);
 void c_ini_group_unlink(CIniGroup *group);
 
 /* raws */
 
-int c_ini_raw_new(CIniRaw **rawp, const uint8_t *data, size_t n_data);
+int c_ini_raw_new(CIniRaw **rawp, CIniArena *arena, const uint8_t *data, size_t n_data);
+int c_ini_raw_new_borrowed(CIniRaw **rawp, CIniArena *arena, const uint8_t *data, size_t n_data);
 CIniRaw *c_ini_raw_ref(CIniRaw *raw);
 CIniRaw *c_ini_raw_unref(CIniRaw *raw);
 
 void c_ini_raw_link(CIniRaw *raw, CIniDomain *domain);
 void c_ini_raw_unlink(CIniRaw *raw);
 
+/* reuse pools */
+
+int c_ini_reuse_new(CIniReuse **reusep, CIniDomain *domain, unsigned int mode);
+CIniReuse *c_ini_reuse_free(CIniReuse *reuse);
+
+CIniReuseLine *c_ini_reuse_take(CIniReuse *reuse, const uint8_t *data, size_t n_data);
+void c_ini_reuse_line_clear(CIniReuseLine *line);
+
 /* domains */
 
 int c_ini_domain_new(CIniDomain **domainp);
+int c_ini_domain_new_frozen(CIniDomain **domainp, CIniArena *arena, CIniFrozen *frozen);
+void c_ini_domain_enable_index(CIniDomain *domain);
+
+/* frozen domains */
+
+int c_ini_frozen_measure(CIniDomain *domain, size_t *n_sizep);
+int c_ini_frozen_fill(CIniDomain *domain, void *p, size_t n_size);
+
+bool c_ini_frozen_verify(const CIniFrozen *frozen, size_t n_size);
+
+CIniEntry *c_ini_frozen_entry_next(CIniEntry *entry);
+CIniEntry *c_ini_frozen_entry_previous(CIniEntry *entry);
+const char *c_ini_frozen_entry_get_key(CIniEntry *entry, size_t *n_keyp);
+const char *c_ini_frozen_entry_get_value(CIniEntry *entry, size_t *n_valuep);
+const char *c_ini_frozen_entry_get_string(CIniEntry *entry, size_t *n_stringp);
+CIniDomain *c_ini_frozen_entry_get_domain(CIniEntry *entry);
+
+CIniGroup *c_ini_frozen_group_next(CIniGroup *group);
+CIniGroup *c_ini_frozen_group_previous(CIniGroup *group);
+const char *c_ini_frozen_group_get_label(CIniGroup *group, size_t *n_labelp);
+CIniEntry *c_ini_frozen_group_iterate(CIniGroup *group);
+CIniEntry *c_ini_frozen_group_find(CIniGroup *group, const char *label, size_t n_label);
+CIniDomain *c_ini_frozen_group_get_domain(CIniGroup *group);
+
+CIniGroup *c_ini_frozen_get_null_group(CIniFrozen *frozen);
+CIniGroup *c_ini_frozen_iterate(CIniFrozen *frozen);
+CIniGroup *c_ini_frozen_find(CIniFrozen *frozen, const char *label, size_t n_label);
+
+CIniGroup *c_ini_frozen_sorted_group(CIniFrozen *frozen, size_t i);
+CIniEntry *c_ini_frozen_group_sorted_entry(CIniGroup *group, size_t i);
+
+/* locales */
+
+void c_ini_locale_parse(CIniLocale *locale, const char *data, size_t n_data);
+unsigned int c_ini_locale_match(const CIniLocale *locale, const char *data, size_t n_data);
+void c_ini_locale_link(CIniEntry *entry, CIniGroup *group);
+void c_ini_locale_unlink(CIniEntry *entry);
+
+/* values */
+
+size_t c_ini_value_decode(char *dst, const char *src, size_t n_src);
+
+/* lines */
+
+void c_ini_line_parse(CIniLine *line, unsigned int mode, const uint8_t *data, size_t n_data, const CIniScan *scan);
 
 /* readers */
 
 int c_ini_reader_init(CIniReader *reader);
 void c_ini_reader_deinit(CIniReader *reader);
 
+int c_ini_reader_new_group(CIniGroup **groupp, CIniArena *arena, unsigned int mode, CIniRaw *raw, const CIniLine *line);
+int c_ini_reader_new_entry(CIniEntry **entryp, CIniArena *arena, unsigned int mode, CIniRaw *raw, const CIniLine *line);
+int c_ini_reader_link_line(CIniReader *reader, CIniRaw *raw, const CIniLine *line, CIniGroup *group, CIniEntry *entry);
+
+int c_ini_reader_prepare(CIniReader *reader);
+int c_ini_reader_flush(CIniReader *reader);
+int c_ini_reader_feed_internal(CIniReader *reader, const uint8_t *data, size_t n_data, bool borrow);
+
+int c_ini_reader_dispatch(CIniReader *reader, const uint8_t *data, size_t n_data, const CIniLine *line);
+
+int c_ini_reader_check_append(CIniReader *reader, size_t n_data);
+int c_ini_reader_check_line(CIniReader *reader, const uint8_t *data, size_t n_data, const CIniLine *line);
+void c_ini_reader_reset_limits(CIniReader *reader);
+
+/* tasks */
+
+void c_ini_task_init(CIniTask *task, CIniReader *reader);
+void c_ini_task_deinit(CIniTask *task);
+
+int c_ini_task_run_all(CIniTask *tasks, size_t n_tasks, unsigned int n_threads);
+void c_ini_task_link(CIniTask *task, CIniReader *reader);
+
 int c_ini_reader_parse(CIniDomain **domainp,
                        unsigned int mode,
                        const uint8_t *data,
@@ -152,6 +609,84 @@ static inline void c_ini_freep(void *p) {
         free(*(void **)p);
 }
 
+static inline uint64_t c_ini_hash(const uint8_t *data, size_t n_data) {
+        uint64_t hash = UINT64_C(0xcbf29ce484222325);
+        size_t i;
+
+        /* FNV-1a */
+        for (i = 0; i < n_data; ++i) {
+                hash ^= data[i];
+                hash *= UINT64_C(0x100000001b3);
+        }
+
+        return hash;
+}
+
+static inline void c_ini_reuse_freep(CIniReuse **reuse) {
+        if (*reuse)
+                c_ini_reuse_free(*reuse);
+}
+
+static inline unsigned long c_ini_ref_get(const CIniRef *ref) {
+#if C_INI_ATOMIC_REFS
+        return atomic_load_explicit(ref, memory_order_relaxed);
+#else
+        return *ref;
+#endif
+}
+
+static inline void c_ini_ref_inc(CIniRef *ref) {
+#if C_INI_ATOMIC_REFS
+        /* the caller already owns a reference, so no ordering is needed */
+        atomic_fetch_add_explicit(ref, 1, memory_order_relaxed);
+#else
+        ++*ref;
+#endif
+}
+
+static inline bool c_ini_ref_dec(CIniRef *ref) {
+#if C_INI_ATOMIC_REFS
+        /*
+         * All accesses of a thread to an object must happen before the object
+         * is destroyed by another thread. Hence, each decrement has release
+         * semantics, and the thread that drops the last reference acquires
+         * the final value, which synchronizes it with all previous releases.
+         * This is equivalent to an acquire fence, but understood by
+         * sanitizers.
+         */
+        if (atomic_fetch_sub_explicit(ref, 1, memory_order_release) != 1)
+                return false;
+
+        (void)atomic_load_explicit(ref, memory_order_acquire);
+        return true;
+#else
+        return !--*ref;
+#endif
+}
+
+static inline bool c_ini_is_frozen(const void *object) {
+        /* frozen groups and entries have a reference counter of 0 */
+        return !c_ini_ref_get(object);
+}
+
+static inline char c_ini_unescape(char c) {
+        /* escape sequences of strings, or 0 if unknown */
+        switch (c) {
+        case 's':
+                return ' ';
+        case 'n':
+                return '\n';
+        case 't':
+                return '\t';
+        case 'r':
+                return '\r';
+        case '\\':
+                return '\\';
+        default:
+                return 0;
+        }
+}
+
 static inline bool c_ini_is_whitespace(char c) {
         return c == 0x09 || /* horizontal tab */
                c == 0x0a || /* line feed */
@@ -160,6 +695,11 @@ static inline bool c_ini_is_whitespace(char c) {
                c == 0x20;   /* white space */
 }
 
+static inline void c_ini_arena_unrefp(CIniArena **arena) {
+        if (*arena)
+                c_ini_arena_unref(*arena);
+}
+
 static inline void c_ini_raw_unrefp(CIniRaw **raw) {
         if (*raw)
                 c_ini_raw_unref(*raw);
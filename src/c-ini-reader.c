@@ -5,20 +5,27 @@
 #include <c-stdaux.h>
 #include <c-utf8.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <inttypes.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <sys/types.h>
+#include <unistd.h>
 #include "c-ini.h"
 #include "c-ini-private.h"
 
 int c_ini_reader_init(CIniReader *reader) {
         *reader = (CIniReader)C_INI_READER_NULL(*reader);
+        reader->scan = c_ini_scan_select(c_ini_scan_detect());
         return 0;
 }
 
 void c_ini_reader_deinit(CIniReader *reader) {
         free(reader->line);
+        c_ini_reuse_free(reader->reuse);
+        c_ini_domain_unref(reader->previous);
         c_ini_group_unref(reader->current);
         c_ini_domain_unref(reader->domain);
         *reader = (CIniReader)C_INI_READER_NULL(*reader);
@@ -49,7 +56,9 @@ _c_public_ void c_ini_reader_set_mode(CIniReader *reader, unsigned int mode) {
                             C_INI_MODE_KEEP_DUPLICATE_GROUPS |
                             C_INI_MODE_MERGE_GROUPS |
                             C_INI_MODE_KEEP_DUPLICATE_ENTRIES |
-                            C_INI_MODE_OVERRIDE_ENTRIES)));
+                            C_INI_MODE_OVERRIDE_ENTRIES |
+                            C_INI_MODE_BORROW_DATA |
+                            C_INI_MODE_HASH_INDEX)));
         /* KEEP_DUPLICATE_GROUPS cannot be combined with MERGE_GROUPS */
         c_assert(!(mode & C_INI_MODE_KEEP_DUPLICATE_GROUPS) ||
                  !(mode & C_INI_MODE_MERGE_GROUPS));
@@ -74,19 +83,16 @@ _c_public_ CIniReader *c_ini_reader_free(CIniReader *reader) {
         return NULL;
 }
 
-static int c_ini_reader_parse_entry(CIniReader *reader,
-                                    CIniRaw *raw,
-                                    size_t i_key,
-                                    size_t i_assignment,
-                                    size_t n) {
-        _c_cleanup_(c_ini_entry_unrefp) CIniEntry *entry = NULL;
-        const uint8_t *key = raw->data + i_key;
-        const uint8_t *value = raw->data + i_assignment + 1;
+static void c_ini_line_parse_entry(CIniLine *line,
+                                   unsigned int mode,
+                                   const uint8_t *data,
+                                   size_t i_key,
+                                   size_t i_assignment,
+                                   size_t n) {
+        const uint8_t *key = data + i_key;
+        const uint8_t *value = data + i_assignment + 1;
         size_t n_key = i_assignment - i_key;
         size_t n_value = n - (i_assignment - i_key + 1);
-        CIniGroup *group;
-        CIniEntry *dup;
-        int r;
 
         /*
          * The caller verified that this line is a normal assignment. Leading
@@ -101,7 +107,7 @@ static int c_ini_reader_parse_entry(CIniReader *reader,
          * mode, all whitespace are allowed. Skip it here. Note that leading
          * whitespace are already skipped by the caller.
          */
-        if (reader->mode & C_INI_MODE_EXTENDED_WHITESPACE) {
+        if (mode & C_INI_MODE_EXTENDED_WHITESPACE) {
                 while (n_key > 0 && c_ini_is_whitespace(key[n_key - 1]))
                         --n_key;
                 while (n_value > 0 && c_ini_is_whitespace(value[0])) {
@@ -117,14 +123,190 @@ static int c_ini_reader_parse_entry(CIniReader *reader,
                 }
         }
 
+        line->type = C_INI_LINE_ENTRY;
+        line->i_key = key - data;
+        line->n_key = n_key;
+        line->i_value = value - data;
+        line->n_value = n_value;
+}
+
+void c_ini_line_parse(CIniLine *line,
+                      unsigned int mode,
+                      const uint8_t *data,
+                      size_t n_data,
+                      const CIniScan *scan) {
+        const uint8_t *start = data;
+        size_t n = n_data;
+
+        /*
+         * Classify a single line of @n_data bytes at @data, and locate its
+         * components. This does not allocate nor modify any state, so it can
+         * be used by all parsers. The caller scanned the line already. @scan
+         * contains the offsets of the first assignment operator and the first
+         * closing bracket, if any. Both are relative to @data. Neither can be
+         * part of the leading whitespace or the trailing line break, which are
+         * stripped below.
+         */
+
+        *line = (CIniLine)C_INI_LINE_NULL;
+
+        /*
+         * Lines must be separated by a '\n' character, and that character
+         * only. The last line is not required to be terminated by a newline.
+         * Lets cut off the newline here, if it is present.
+         */
+        if (n > 0 && data[n - 1] == '\n')
+                --n;
+
+        /*
+         * Trailing carriage returns are ignored, if the specific quirk is
+         * enabled.
+         */
+        if (mode & C_INI_MODE_EXTENDED_WHITESPACE) {
+                if (n > 0 && data[n - 1] == '\r')
+                        --n;
+        }
+
+        /*
+         * If requested, skip any leading whitespace.
+         */
+        if (mode & C_INI_MODE_EXTENDED_WHITESPACE) {
+                while (n > 0 && c_ini_is_whitespace(data[0])) {
+                        ++data;
+                        --n;
+                }
+        }
+
+        /*
+         * Blank lines, and lines starting with '#' are considered comments and
+         * are ignored. Bail out early, if a comment is detected.
+         */
+        if (n < 1) {
+                line->type = C_INI_LINE_BLANK;
+                return;
+        } else if (data[0] == '#') {
+                line->type = C_INI_LINE_COMMENT;
+                line->i_value = data + 1 - start;
+                line->n_value = n - 1;
+                return;
+        }
+
+        /*
+         * If a line starts with '[' and ends with ']', we always treat it as a
+         * group, regardless whether it is correctly formatted. This avoids
+         * accidentally merging two groups just because the group-header is
+         * malformatted.
+         */
+        if (data[0] == '[') {
+                const uint8_t *tmp = data + 1, *end;
+                size_t n_tmp = n - 1;
+
+                if (scan->i_bracket != SIZE_MAX) {
+                        end = start + scan->i_bracket;
+
+                        /* If requested, skip trailing whitespace */
+                        if (mode & C_INI_MODE_EXTENDED_WHITESPACE) {
+                                while (n_tmp > 0 && c_ini_is_whitespace(tmp[n_tmp - 1]))
+                                        --n_tmp;
+                        }
+
+                        if (end - tmp + 1 == (ssize_t)n_tmp) {
+                                line->type = C_INI_LINE_GROUP;
+                                line->i_key = tmp - start;
+                                line->n_key = n_tmp - 1;
+                                return;
+                        }
+                }
+        }
+
+        /*
+         * If the line contains any assignment, we parse it into a key-value
+         * pair.
+         */
+        if (scan->i_assignment != SIZE_MAX) {
+                c_ini_line_parse_entry(line,
+                                       mode,
+                                       start,
+                                       data - start,
+                                       scan->i_assignment,
+                                       n);
+                return;
+        }
+
         /*
-         * Create a new entry. Always do this, even if we discard it later. We
-         * want to perform validations regardless whether we keep it or not.
+         * We couldn't detect this line. Our parsers will ignore it, but it is
+         * still kept around, so a serializer will include it later on.
          */
-        r = c_ini_entry_new(&entry, key, n_key, value, n_value);
+        line->type = C_INI_LINE_MALFORMED;
+}
+
+int c_ini_reader_new_group(CIniGroup **groupp,
+                           CIniArena *arena,
+                           unsigned int mode,
+                           CIniRaw *raw,
+                           const CIniLine *line) {
+        const uint8_t *label = raw->data + line->i_key;
+        int r;
+
+        c_assert(line->type == C_INI_LINE_GROUP);
+
+        if (mode & C_INI_MODE_BORROW_DATA)
+                return c_ini_group_new_borrowed(groupp, arena, raw, label, line->n_key);
+
+        /* remember the source line, so the group can be reused on reload */
+        r = c_ini_group_new(groupp, arena, label, line->n_key);
         if (r)
                 return r;
 
+        (*groupp)->raw = c_ini_raw_ref(raw);
+        return 0;
+}
+
+int c_ini_reader_new_entry(CIniEntry **entryp,
+                           CIniArena *arena,
+                           unsigned int mode,
+                           CIniRaw *raw,
+                           const CIniLine *line) {
+        const uint8_t *key = raw->data + line->i_key;
+        const uint8_t *value = raw->data + line->i_value;
+        int r;
+
+        c_assert(line->type == C_INI_LINE_ENTRY);
+
+        if (mode & C_INI_MODE_BORROW_DATA)
+                return c_ini_entry_new_borrowed(entryp, arena, raw, key, line->n_key, value, line->n_value);
+
+        /* see c_ini_reader_new_group() */
+        r = c_ini_entry_new(entryp, arena, key, line->n_key, value, line->n_value);
+        if (r)
+                return r;
+
+        (*entryp)->raw = c_ini_raw_ref(raw);
+        return 0;
+}
+
+static int c_ini_reader_link_entry(CIniReader *reader,
+                                   CIniRaw *raw,
+                                   const CIniLine *line,
+                                   CIniEntry *entry) {
+        _c_cleanup_(c_ini_entry_unrefp) CIniEntry *new = NULL;
+        CIniGroup *group;
+        CIniEntry *dup;
+        int r;
+
+        /*
+         * Create a new entry, unless the caller did already. Always do this,
+         * even if we discard it later. We want to perform validations
+         * regardless whether we keep it or not.
+         */
+        if (!entry) {
+                r = c_ini_reader_new_entry(&new, reader->domain->arena, reader->mode, raw, line);
+                if (r)
+                        return r;
+
+                entry = new;
+        }
+
         /*
          * If there is no open group, it means the file started with
          * assignments without a prior group header. In this case, we always
@@ -137,7 +319,7 @@ static int c_ini_reader_parse_entry(CIniReader *reader,
          * entries override previous entries. If duplicates are kept, then we
          * don't merge entries. If neither is set, duplicates are discarded.
          */
-        dup = c_ini_group_find(group, (const char *)key, n_key);
+        dup = c_ini_group_find(group, (const char *)entry->key, entry->n_key);
         if (dup && reader->mode & C_INI_MODE_OVERRIDE_ENTRIES) {
                 c_ini_entry_unlink(dup);
                 dup = NULL; /* unref'ed during unlink */
@@ -149,23 +331,24 @@ static int c_ini_reader_parse_entry(CIniReader *reader,
         return 0;
 }
 
-static int c_ini_reader_parse_group(CIniReader *reader,
-                                    CIniRaw *raw,
-                                    size_t i_label,
-                                    size_t n_label) {
-        _c_cleanup_(c_ini_group_unrefp) CIniGroup *group = NULL;
-        const uint8_t *label = raw->data + i_label;
+static int c_ini_reader_link_group(CIniReader *reader,
+                                   CIniRaw *raw,
+                                   const CIniLine *line,
+                                   CIniGroup *group) {
+        _c_cleanup_(c_ini_group_unrefp) CIniGroup *new = NULL;
+        const uint8_t *label = raw->data + line->i_key;
+        size_t n_label = line->n_key;
         CIniGroup *dup;
         int r;
 
         /*
-         * The caller verified that the current line opens a new group. The
-         * opening and closing brackets where already stripped, the remaining
-         * bits are indexed from @i_label with length @n_label.
+         * The line opens a new group. The opening and closing brackets where
+         * already stripped, the remaining bits are indexed from @line->i_key
+         * with length @line->n_key.
          * All parsers treat the content inside of the brackets as literal
          * group label. Not whitespaces are stripped, nor are any other
          * conversions applied. Hence, we simply create the new group and
-         * append it.
+         * append it. If the caller created the group already, we use it.
          *
          * Note that even if in strict mode, we must always open a new group
          * here. That is, this line definitely opens a new group. If the writer
@@ -176,6 +359,11 @@ static int c_ini_reader_parse_group(CIniReader *reader,
          * from the lookup trees (similar to discarded duplicates).
          */
 
+        if (group) {
+                label = group->label;
+                n_label = group->n_label;
+        }
+
         dup = c_ini_domain_find(reader->domain, (const char *)label, n_label);
         if (dup && reader->mode & C_INI_MODE_MERGE_GROUPS) {
                 /* ref/unref in right order, both might be the same */
@@ -183,9 +371,13 @@ static int c_ini_reader_parse_group(CIniReader *reader,
                 c_ini_group_unref(reader->current);
                 reader->current = dup;
         } else {
-                r = c_ini_group_new(&group, label, n_label);
-                if (r)
-                        return r;
+                if (!group) {
+                        r = c_ini_reader_new_group(&new, reader->domain->arena, reader->mode, raw, line);
+                        if (r)
+                                return r;
+
+                        group = new;
+                }
 
                 if (!dup || reader->mode & C_INI_MODE_KEEP_DUPLICATE_GROUPS)
                         c_ini_group_link(group, reader->domain);
@@ -197,92 +389,171 @@ static int c_ini_reader_parse_group(CIniReader *reader,
         return 0;
 }
 
-static int c_ini_reader_parse_line(CIniReader *reader, CIniRaw *raw) {
-        const uint8_t *end, *data = raw->data;
-        size_t n = raw->n_data;
-
+int c_ini_reader_link_line(CIniReader *reader,
+                           CIniRaw *raw,
+                           const CIniLine *line,
+                           CIniGroup *group,
+                           CIniEntry *entry) {
         /*
-         * Lines must be separated by a '\n' character, and that character
-         * only. The last line is not required to be terminated by a newline.
-         * Lets cut off the newline here, if it is present.
+         * Link a parsed line into the domain of the reader. If the caller
+         * already created the group or entry of the line (via
+         * c_ini_reader_new_group() or c_ini_reader_new_entry()), it is passed
+         * in @group or @entry. Otherwise, it is created as needed.
          */
-        if (n > 0 && data[n - 1] == '\n')
-                --n;
+
+        c_ini_raw_link(raw, reader->domain);
+
+        switch (line->type) {
+        case C_INI_LINE_GROUP:
+                return c_ini_reader_link_group(reader, raw, line, group);
+        case C_INI_LINE_ENTRY:
+                return c_ini_reader_link_entry(reader, raw, line, entry);
+        case C_INI_LINE_MALFORMED:
+                reader->malformed = true;
+                return 0;
+        default:
+                return 0;
+        }
+}
+
+static void c_ini_reader_parse_line(CIniReader *reader,
+                                    CIniLine *line,
+                                    const uint8_t *data,
+                                    size_t n_data,
+                                    const CIniScan *scan) {
+        CIniScan rescan;
 
         /*
-         * Trailing carriage returns are ignored, if the specific quirk is
-         * enabled.
+         * If the line was not scanned as a whole, yet, do it now. This
+         * happens for lines that were assembled from multiple chunks.
          */
-        if (reader->mode & C_INI_MODE_EXTENDED_WHITESPACE) {
-                if (n > 0 && data[n - 1] == '\r')
-                        --n;
+        if (!scan) {
+                reader->scan(data, n_data, &rescan);
+                scan = &rescan;
         }
 
+        c_ini_line_parse(line, reader->mode, data, n_data, scan);
+}
+
+static int c_ini_reader_commit_raw(CIniReader *reader,
+                                   CIniRaw *raw,
+                                   const CIniScan *scan,
+                                   const CIniLine *parsed) {
+        CIniLine line;
+
+        /* parse the line, unless the caller did already */
+        if (!parsed) {
+                c_ini_reader_parse_line(reader, &line, raw->data, raw->n_data, scan);
+                parsed = &line;
+        }
+
+        return c_ini_reader_link_line(reader, raw, parsed, NULL, NULL);
+}
+
+static int c_ini_reader_commit_reused(CIniReader *reader, CIniReuseLine *reused, const CIniLine *parsed) {
+        CIniLine line = C_INI_LINE_NULL;
+        int r;
+
         /*
-         * If requested, skip any leading whitespace.
+         * The line was found in the objects of the previous domain. If it
+         * produced a group or entry, link it again. Otherwise, the line is
+         * parsed again, but its raw line is still reused.
          */
-        if (reader->mode & C_INI_MODE_EXTENDED_WHITESPACE) {
-                while (n > 0 && c_ini_is_whitespace(data[0])) {
-                        ++data;
-                        --n;
-                }
+
+        if (reused->group) {
+                line.type = C_INI_LINE_GROUP;
+                r = c_ini_reader_link_line(reader, reused->raw, &line, reused->group, NULL);
+        } else if (reused->entry) {
+                line.type = C_INI_LINE_ENTRY;
+                r = c_ini_reader_link_line(reader, reused->raw, &line, NULL, reused->entry);
+        } else {
+                r = c_ini_reader_commit_raw(reader, reused->raw, NULL, parsed);
         }
 
+        c_ini_reuse_line_clear(reused);
+        return r;
+}
+
+static const CIniLine *c_ini_reader_parse_early(CIniReader *reader,
+                                                CIniLine *line,
+                                                const uint8_t *data,
+                                                size_t n_data,
+                                                const CIniScan *scan) {
         /*
-         * Blank lines, and lines starting with '#' are considered comments and
-         * are ignored. Bail out early, if a comment is detected.
+         * Limits and callbacks need the parsed line before anything else is
+         * done with it. Otherwise, parsing is deferred until the line is
+         * known not to be reused. Either way, each line is parsed once.
          */
-        if (n < 1 || data[0] == '#')
-                return 0;
+        if (!reader->limited && !reader->callbacks)
+                return NULL;
+
+        c_ini_reader_parse_line(reader, line, data, n_data, scan);
+        return line;
+}
+
+static int c_ini_reader_commit_span(CIniReader *reader,
+                                    const uint8_t *data,
+                                    size_t n_data,
+                                    const CIniScan *scan,
+                                    bool borrow) {
+        _c_cleanup_(c_ini_raw_unrefp) CIniRaw *raw = NULL;
+        const CIniLine *parsed;
+        CIniReuseLine *reused;
+        CIniLine line;
+        int r;
 
         /*
-         * If a line starts with '[' and ends with ']', we always treat it as a
-         * group, regardless whether it is correctly formatted. This avoids
-         * accidentally merging two groups just because the group-header is
-         * malformatted.
+         * The line is fully contained in the data provided by the caller.
+         * There is no need to assemble it in the line-buffer first. Instead,
+         * create the CIniRaw directly from the input. If the caller allowed us
+         * to borrow the data, we do not even copy it.
          */
-        if (data[0] == '[') {
-                const uint8_t *tmp = data + 1;
-                size_t n_tmp = n - 1;
 
-                end = memchr(tmp, ']', n_tmp);
-                if (end) {
-                        /* If requested, skip trailing whitespace */
-                        if (reader->mode & C_INI_MODE_EXTENDED_WHITESPACE) {
-                                while (n_tmp > 0 && c_ini_is_whitespace(tmp[n_tmp - 1]))
-                                        --n_tmp;
-                        }
+        c_assert(!reader->n_line);
 
-                        if (end - tmp + 1 == (ssize_t)n_tmp)
-                                return c_ini_reader_parse_group(reader,
-                                                                raw,
-                                                                tmp - raw->data,
-                                                                n_tmp - 1);
-                }
+        parsed = c_ini_reader_parse_early(reader, &line, data, n_data, scan);
+
+        r = c_ini_reader_check_line(reader, data, n_data, parsed);
+        if (r)
+                return r;
+
+        if (reader->callbacks)
+                return c_ini_reader_dispatch(reader, data, n_data, parsed);
+
+        if (reader->reuse) {
+                reused = c_ini_reuse_take(reader->reuse, data, n_data);
+                if (reused)
+                        return c_ini_reader_commit_reused(reader, reused, parsed);
         }
 
-        /*
-         * If the line contains any assignment, we parse it into a key-value
-         * pair.
-         */
-        end = memchr(data, '=', n);
-        if (end)
-                return c_ini_reader_parse_entry(reader,
-                                                raw,
-                                                data - raw->data,
-                                                end - raw->data,
-                                                n);
+        if (borrow)
+                r = c_ini_raw_new_borrowed(&raw, reader->domain->arena, data, n_data);
+        else
+                r = c_ini_raw_new(&raw, reader->domain->arena, data, n_data);
+        if (r)
+                return r;
+
+        return c_ini_reader_commit_raw(reader, raw, scan, parsed);
+}
+
+static void c_ini_reader_clear_line(CIniReader *reader) {
+        reader->n_line = 0;
 
         /*
-         * We couldn't detect this line, so ignore it. We keep it around, so a
-         * serializer will include it later on, but our parsers will ignore it.
+         * Do not retain huge line-buffers after a single overlong line. Drop
+         * it and start over small with the next line that needs it.
          */
-        reader->malformed = true;
-        return 0;
+        if (reader->z_line > C_INI_RETAINED_LINE_SIZE) {
+                reader->line = c_free(reader->line);
+                reader->z_line = 0;
+        }
 }
 
-static int c_ini_reader_commit(CIniReader *reader) {
+static int c_ini_reader_commit(CIniReader *reader, const CIniScan *scan) {
         _c_cleanup_(c_ini_raw_unrefp) CIniRaw *raw = NULL;
+        CIniReuseLine *reused = NULL;
+        const CIniLine *parsed;
+        CIniLine line;
         int r;
 
         /*
@@ -295,29 +566,59 @@ static int c_ini_reader_commit(CIniReader *reader) {
          * complete and ready to be parsed.
          */
 
-        r = c_ini_raw_new(&raw, reader->line, reader->n_line);
+        parsed = c_ini_reader_parse_early(reader, &line, reader->line, reader->n_line, scan);
+
+        r = c_ini_reader_check_line(reader, reader->line, reader->n_line, parsed);
         if (r)
                 return r;
 
-        reader->n_line = 0;
-        c_ini_raw_link(raw, reader->domain);
+        if (reader->callbacks) {
+                r = c_ini_reader_dispatch(reader, reader->line, reader->n_line, parsed);
+                c_ini_reader_clear_line(reader);
+                return r;
+        }
 
-        return c_ini_reader_parse_line(reader, raw);
+        if (reader->reuse)
+                reused = c_ini_reuse_take(reader->reuse, reader->line, reader->n_line);
+
+        if (!reused) {
+                r = c_ini_raw_new(&raw, reader->domain->arena, reader->line, reader->n_line);
+                if (r)
+                        return r;
+        }
+
+        c_ini_reader_clear_line(reader);
+
+        if (reused)
+                return c_ini_reader_commit_reused(reader, reused, parsed);
+
+        return c_ini_reader_commit_raw(reader, raw, scan, parsed);
 }
 
 static int c_ini_reader_append(CIniReader *reader, const uint8_t *data, size_t n_data) {
         size_t n;
         void *p;
+        int r;
 
         if (!n_data)
                 return 0;
 
+        r = c_ini_reader_check_append(reader, n_data);
+        if (r)
+                return r;
+
         if (reader->z_line - reader->n_line < n_data) {
+                /*
+                 * Grow the line-buffer geometrically, so overlong lines fed
+                 * in small chunks are copied in amortized linear time.
+                 */
                 n = reader->n_line + n_data;
-                if (n < C_INI_INITIAL_LINE_SIZE)
-                        n = C_INI_INITIAL_LINE_SIZE;
                 if (n < reader->n_line)
                         return -E2BIG;
+                if (n < C_INI_INITIAL_LINE_SIZE)
+                        n = C_INI_INITIAL_LINE_SIZE;
+                if (n < reader->z_line * 2 && reader->z_line * 2 > reader->z_line)
+                        n = reader->z_line * 2;
 
                 p = realloc(reader->line, n);
                 if (!p)
@@ -332,15 +633,10 @@ static int c_ini_reader_append(CIniReader *reader, const uint8_t *data, size_t n
         return 0;
 }
 
-_c_public_ int c_ini_reader_feed(CIniReader *reader, const uint8_t *data, size_t n_data) {
-        const uint8_t *end;
-        size_t n;
+int c_ini_reader_prepare(CIniReader *reader) {
         int r;
 
-        if (!n_data)
-                return 0;
-
-        if (!reader->domain) {
+        if (!reader->domain && !reader->callbacks) {
                 /*
                  * This is the first data-set being pushed into the reader.
                  * Allocate a new domain that we use to collect all the data.
@@ -348,26 +644,100 @@ _c_public_ int c_ini_reader_feed(CIniReader *reader, const uint8_t *data, size_t
                 r = c_ini_domain_new(&reader->domain);
                 if (r)
                         return r;
+
+                reader->domain->mode = reader->mode;
+                if (reader->mode & C_INI_MODE_HASH_INDEX)
+                        c_ini_domain_enable_index(reader->domain);
+
+                /*
+                 * If the caller provided the previous domain, collect its
+                 * objects for reuse in this parsing round.
+                 */
+                if (reader->previous) {
+                        r = c_ini_reuse_new(&reader->reuse, reader->previous, reader->mode);
+                        reader->previous = c_ini_domain_unref(reader->previous);
+                        if (r)
+                                return r;
+                }
         }
 
+        return 0;
+}
+
+int c_ini_reader_flush(CIniReader *reader) {
+        int r;
+
+        /*
+         * Terminate the current input: commit any incomplete line and close
+         * the current group, so following input starts over in the NULL
+         * group. This is used at file boundaries.
+         */
+
+        r = c_ini_reader_prepare(reader);
+        if (r)
+                return r;
+
+        if (reader->n_line) {
+                r = c_ini_reader_commit(reader, NULL);
+                if (r)
+                        return r;
+        }
+
+        reader->current = c_ini_group_unref(reader->current);
+        reader->n_entries = 0;
+        return 0;
+}
+
+int c_ini_reader_feed_internal(CIniReader *reader,
+                               const uint8_t *data,
+                               size_t n_data,
+                               bool borrow) {
+        CIniScan scan;
+        size_t n;
+        int r;
+
+        if (!n_data)
+                return 0;
+
+        r = c_ini_reader_prepare(reader);
+        if (r)
+                return r;
+
         /*
          * All currently supported formats have in common that they are
-         * line-based. Hence, read the provided data into a line-buffer and
-         * commit it at every newline.
+         * line-based. Hence, commit the provided data at every newline, using
+         * the line-buffer to carry incomplete lines over to the next call.
          * If a specific format needs to merge multiple lines, it should not
          * discard the line-buffer. Further input will be appended to the
          * line-buffer until the next newline.
          */
-        while ((end = memchr(data, '\n', n_data))) {
-                n = end - data + 1;
+        for (;;) {
+                reader->scan(data, n_data, &scan);
+                if (scan.i_newline >= n_data)
+                        break;
 
-                r = c_ini_reader_append(reader, data, n);
-                if (r)
-                        return r;
+                n = scan.i_newline + 1;
 
-                r = c_ini_reader_commit(reader);
-                if (r)
-                        return r;
+                /*
+                 * If the line-buffer is empty, the line is fully contained in
+                 * @data and can be committed directly. Otherwise, it started
+                 * in an earlier chunk and must be assembled in the
+                 * line-buffer. In that case, the scan results only cover the
+                 * tail of the line, so it has to be scanned again as a whole.
+                 */
+                if (!reader->n_line) {
+                        r = c_ini_reader_commit_span(reader, data, n, &scan, borrow);
+                        if (r)
+                                return r;
+                } else {
+                        r = c_ini_reader_append(reader, data, n);
+                        if (r)
+                                return r;
+
+                        r = c_ini_reader_commit(reader, NULL);
+                        if (r)
+                                return r;
+                }
 
                 n_data -= n;
                 data += n;
@@ -380,25 +750,160 @@ _c_public_ int c_ini_reader_feed(CIniReader *reader, const uint8_t *data, size_t
         return c_ini_reader_append(reader, data, n_data);
 }
 
-_c_public_ int c_ini_reader_seal(CIniReader *reader, CIniDomain **domainp) {
+_c_public_ int c_ini_reader_feed(CIniReader *reader, const uint8_t *data, size_t n_data) {
+        return c_ini_reader_feed_internal(reader,
+                                          data,
+                                          n_data,
+                                          reader->mode & C_INI_MODE_BORROW_DATA);
+}
+
+static int c_ini_reader_feed_stream(CIniReader *reader, int fd) {
+        _c_cleanup_(c_ini_freep) uint8_t *buffer = NULL;
+        ssize_t l;
         int r;
 
-        if (!reader->domain) {
-                /*
-                 * Nothing was pushed into the reader. This means the file or
-                 * data-set was empty. Lets create an empty domain, so we can
-                 * return it to the caller later.
-                 */
-                r = c_ini_domain_new(&reader->domain);
+        /*
+         * Files that cannot be mapped (e.g., pipes or sockets) are read in
+         * chunks. The buffer is reused for each chunk, so the data must
+         * never be borrowed.
+         */
+
+        buffer = malloc(C_INI_INITIAL_LINE_SIZE);
+        if (!buffer)
+                return -ENOMEM;
+
+        for (;;) {
+                l = read(fd, buffer, C_INI_INITIAL_LINE_SIZE);
+                if (l < 0) {
+                        if (errno == EINTR)
+                                continue;
+                        return -errno;
+                } else if (!l) {
+                        return 0;
+                }
+
+                r = c_ini_reader_feed_internal(reader, buffer, l, false);
                 if (r)
                         return r;
         }
+}
+
+_c_public_ int c_ini_reader_feed_fd(CIniReader *reader, int fd) {
+        struct stat st;
+        size_t n, skip;
+        uint8_t *p;
+        off_t offset;
+        long n_page;
+        int r;
+
+        if (fstat(fd, &st) < 0)
+                return -errno;
+
+        /*
+         * Only regular files can be mapped. Note that some pseudo
+         * file-systems report a size of 0 for files with content, so those
+         * are read like streams as well.
+         */
+        if (!S_ISREG(st.st_mode) || st.st_size <= 0)
+                return c_ini_reader_feed_stream(reader, fd);
+        if ((uintmax_t)st.st_size > SIZE_MAX)
+                return -EFBIG;
+
+        /*
+         * Like streams, files are consumed from their current position to
+         * the end, and the position is moved to the end. The mapping must
+         * start at a page boundary, so the bytes before the position are
+         * mapped as well, but skipped.
+         */
+
+        offset = lseek(fd, 0, SEEK_CUR);
+        if (offset < 0)
+                return -errno;
+        if (offset >= st.st_size)
+                return 0;
+
+        n_page = sysconf(_SC_PAGESIZE);
+        skip = n_page > 0 ? offset % n_page : offset;
+        n = st.st_size - offset + skip;
+
+        p = mmap(NULL, n, PROT_READ, MAP_PRIVATE, fd, offset - skip);
+        if (p == MAP_FAILED)
+                return -errno;
+
+        if (lseek(fd, st.st_size, SEEK_SET) < 0) {
+                r = -errno;
+                munmap(p, n);
+                return r;
+        }
+
+        /* this is a hint only, so ignore failures */
+        (void)madvise(p, n, MADV_SEQUENTIAL);
+
+        if (!(reader->mode & C_INI_MODE_BORROW_DATA) || reader->callbacks) {
+                r = c_ini_reader_feed_internal(reader, p + skip, n - skip, false);
+                munmap(p, n);
+                return r;
+        }
+
+        /*
+         * If borrowing is allowed, the domain takes ownership of the mapping,
+         * and all lines are parsed in-place. This means the file must not be
+         * truncated as long as the domain is used, since accessing the
+         * truncated pages would raise SIGBUS.
+         */
+
+        r = c_ini_reader_prepare(reader);
+        if (!r)
+                r = c_ini_arena_add_mapping(reader->domain->arena, p, n);
+        if (r) {
+                munmap(p, n);
+                return r;
+        }
+
+        return c_ini_reader_feed_internal(reader, p + skip, n - skip, true);
+}
+
+_c_public_ int c_ini_reader_feed_path(CIniReader *reader, const char *path) {
+        _c_cleanup_(c_closep) int fd = -1;
+
+        fd = open(path, O_RDONLY | O_CLOEXEC | O_NOCTTY);
+        if (fd < 0)
+                return -errno;
+
+        return c_ini_reader_feed_fd(reader, fd);
+}
+
+_c_public_ void c_ini_reader_reuse(CIniReader *reader, CIniDomain *previous) {
+        /*
+         * Remember @previous, so its objects can be reused by the next
+         * parsing round. The domain is only taken apart when that round
+         * starts, and only if the reader holds the last reference by then.
+         * Hence, callers must drop their own reference right away, and must
+         * not use @previous afterwards. If it is still referenced elsewhere,
+         * nothing is reused, and @previous stays intact.
+         */
+        c_ini_domain_ref(previous);
+        c_ini_domain_unref(reader->previous);
+        reader->previous = previous;
+}
+
+_c_public_ int c_ini_reader_seal(CIniReader *reader, CIniDomain **domainp) {
+        int r;
+
+        /*
+         * If nothing was pushed into the reader, the file or data-set was
+         * empty. Lets create an empty domain, so we can return it to the
+         * caller later.
+         */
+        r = c_ini_reader_prepare(reader);
+        if (r)
+                return r;
 
         /*
          * There might be data in the line-buffer. No trailing newline
          * is required, so simply commit the last line.
          */
-        r = c_ini_reader_commit(reader);
+        r = c_ini_reader_commit(reader, NULL);
         if (r)
                 return r;
 
@@ -407,12 +912,15 @@ _c_public_ int c_ini_reader_seal(CIniReader *reader, CIniDomain **domainp) {
          * The entire state must be reset, unless requested otherwise.
          */
         reader->current = c_ini_group_unref(reader->current);
+        reader->reuse = c_ini_reuse_free(reader->reuse);
         reader->malformed = false;
+        c_ini_reader_reset_limits(reader);
 
         /*
          * Hand the entire domain to the caller (including the ref-count). It
          * is now completely owned by the caller. The next parsing round will
-         * allocate a new domain.
+         * allocate a new domain. If callbacks are set, no domain was built,
+         * and the caller gets NULL.
          */
         *domainp = reader->domain;
         reader->domain = NULL;
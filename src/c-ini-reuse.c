@@ -0,0 +1,225 @@
+/*
+ * Ini-File Object Reuse
+ *
+ * When a configuration is reloaded, usually only a handful of lines changed.
+ * Rather than parsing everything from scratch, a reader can be handed the
+ * previous domain via c_ini_reader_reuse(). Before the next parsing round,
+ * the reader takes apart the previous domain and collects its raw lines,
+ * together with the groups and entries they produced, in a pool indexed by
+ * line content. Whenever the reader commits a line that is found in the pool,
+ * it links the existing objects rather than allocating and parsing new ones.
+ *
+ * Objects are moved into the new domain, rather than shared, since they are
+ * linked into the lists and trees of exactly one domain. They can only be
+ * moved if nobody else can observe them. Hence, reuse requires the caller to
+ * give up the previous domain: it is only taken apart if the reader holds
+ * the last reference to it, and each group and entry is only reused if it is
+ * referenced by its parent alone. Otherwise, the new domain is parsed from
+ * scratch, and the previous domain is left untouched. Furthermore, the
+ * previous domain must have been parsed in the same mode, and lines borrowed
+ * from caller data are never reused, since the caller is free to release
+ * that data.
+ *
+ * Reused objects retain their allocation in the arena of the previous
+ * domain. This pins the arena, and so the memory of the objects that were not
+ * reused, until the last reused object is released. To keep this from
+ * accumulating over many reloads, only objects allocated from the arena of
+ * the previous domain itself are reused. Objects that the previous domain
+ * reused in turn are parsed again, which copies them into the new arena.
+ * Hence, a domain pins at most the arena of its direct predecessor.
+ *
+ * The pool is not safe for concurrent use. Readers that reuse objects thus
+ * parse parallel feeds and drop-ins serially.
+ */
+
+#include <c-stdaux.h>
+#include <errno.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include "c-ini.h"
+#include "c-ini-private.h"
+
+static uint64_t c_ini_reuse_hash_pointer(const void *p) {
+        /* Fibonacci hashing spreads the aligned pointer bits */
+        return (uint64_t)(uintptr_t)p * UINT64_C(0x9e3779b97f4a7c15);
+}
+
+static bool c_ini_reuse_match_raw(const void *key, void *p) {
+        const CIniReuseLine *line = p;
+
+        return line->raw == key;
+}
+
+static bool c_ini_reuse_match_bytes(const void *key, void *p) {
+        const CIniBytes *bytes = key;
+        const CIniReuseLine *line = p;
+
+        /* the final empty line of a round comes without buffer */
+        return line->raw->n_data == bytes->n_data &&
+               (!bytes->n_data || !memcmp(line->raw->data, bytes->data, bytes->n_data));
+}
+
+static CIniReuseLine *c_ini_reuse_find_raw(CIniIndex *index, CIniRaw *raw) {
+        if (!raw)
+                return NULL;
+        return c_ini_index_find(index, c_ini_reuse_hash_pointer(raw), c_ini_reuse_match_raw, raw);
+}
+
+static void c_ini_reuse_steal_entries(CIniIndex *index, CIniGroup *group) {
+        CIniEntry *entry, *t_entry;
+        CIniReuseLine *line;
+
+        c_list_for_each_entry_safe(entry, t_entry, &group->list_entries, link_group) {
+                if (c_ini_ref_get(&entry->n_refs) != 1)
+                        continue;
+
+                line = c_ini_reuse_find_raw(index, entry->raw);
+                if (!line || line->entry)
+                        continue;
+
+                line->entry = c_ini_entry_ref(entry);
+                c_ini_entry_unlink(entry);
+        }
+}
+
+static void c_ini_reuse_steal_group(CIniIndex *index, CIniGroup *group) {
+        CIniEntry *entry, *t_entry;
+        CIniReuseLine *line;
+
+        if (c_ini_ref_get(&group->n_refs) != 1)
+                return;
+
+        line = c_ini_reuse_find_raw(index, group->raw);
+        if (!line || line->group)
+                return;
+
+        /* drop all remaining entries, the group is refilled when linked */
+        c_list_for_each_entry_safe(entry, t_entry, &group->list_entries, link_group)
+                c_ini_entry_unlink(entry);
+
+        c_ini_index_deinit(&group->index_entries);
+        group->indexed = false;
+
+        line->group = c_ini_group_ref(group);
+        c_ini_group_unlink(group);
+}
+
+int c_ini_reuse_new(CIniReuse **reusep, CIniDomain *domain, unsigned int mode) {
+        _c_cleanup_(c_ini_reuse_freep) CIniReuse *reuse = NULL;
+        CIniIndex by_raw = C_INI_INDEX_NULL(by_raw);
+        CIniGroup *group, *t_group;
+        CIniRaw *raw, *t_raw;
+        CIniReuseLine *line;
+        size_t n_lines = 0;
+        int r;
+
+        /*
+         * Take apart @domain and collect its objects for reuse. If @domain
+         * cannot be taken apart, the pool is empty. In either case, the
+         * caller must drop its reference to @domain afterwards.
+         */
+
+        reuse = calloc(1, sizeof(*reuse));
+        if (!reuse)
+                return -ENOMEM;
+
+        *reuse = (CIniReuse)C_INI_REUSE_NULL(*reuse);
+
+        if (c_ini_ref_get(&domain->n_refs) != 1 || domain->frozen || domain->mode != mode) {
+                *reusep = reuse;
+                reuse = NULL;
+                return 0;
+        }
+
+        c_list_for_each_entry(raw, &domain->list_raws, link_domain)
+                if (raw->data == raw->storage && raw->arena == domain->arena)
+                        ++n_lines;
+
+        reuse->lines = calloc(n_lines ?: 1, sizeof(*reuse->lines));
+        if (!reuse->lines)
+                return -ENOMEM;
+
+        r = c_ini_index_reset(&reuse->index, n_lines);
+        if (!r)
+                r = c_ini_index_reset(&by_raw, n_lines);
+        if (r) {
+                c_ini_index_deinit(&by_raw);
+                return r;
+        }
+
+        /*
+         * Collect all raw lines in order, indexed by their content. Each
+         * line can only be taken once, and the index returns the earliest
+         * line with a given content. Hence, repeated lines are reused in
+         * order. Lines from older arenas are skipped, and so are the groups
+         * and entries they produced, since those are allocated alongside.
+         */
+        c_list_for_each_entry(raw, &domain->list_raws, link_domain) {
+                if (raw->data != raw->storage || raw->arena != domain->arena)
+                        continue;
+
+                line = &reuse->lines[reuse->n_lines++];
+                line->raw = c_ini_raw_ref(raw);
+                c_ini_index_add(&reuse->index, c_ini_hash(raw->data, raw->n_data), line);
+                c_ini_index_add(&by_raw, c_ini_reuse_hash_pointer(raw), line);
+        }
+
+        c_ini_reuse_steal_entries(&by_raw, domain->null_group);
+        c_list_for_each_entry(group, &domain->list_groups, link_domain)
+                c_ini_reuse_steal_entries(&by_raw, group);
+        c_list_for_each_entry_safe(group, t_group, &domain->list_groups, link_domain)
+                c_ini_reuse_steal_group(&by_raw, group);
+
+        c_list_for_each_entry_safe(raw, t_raw, &domain->list_raws, link_domain)
+                c_ini_raw_unlink(raw);
+
+        c_ini_index_deinit(&by_raw);
+
+        *reusep = reuse;
+        reuse = NULL;
+        return 0;
+}
+
+CIniReuse *c_ini_reuse_free(CIniReuse *reuse) {
+        size_t i;
+
+        if (!reuse)
+                return NULL;
+
+        for (i = 0; i < reuse->n_lines; ++i)
+                c_ini_reuse_line_clear(&reuse->lines[i]);
+
+        c_ini_index_deinit(&reuse->index);
+        free(reuse->lines);
+        free(reuse);
+
+        return NULL;
+}
+
+CIniReuseLine *c_ini_reuse_take(CIniReuse *reuse, const uint8_t *data, size_t n_data) {
+        CIniBytes bytes = C_INI_BYTES_INIT((uint8_t *)data, n_data);
+        CIniReuseLine *line;
+        uint64_t hash;
+
+        /*
+         * Find the earliest unused line with the given content and remove it
+         * from the pool. The caller takes over all references of the line.
+         */
+
+        if (!reuse->index.n_live)
+                return NULL;
+
+        hash = c_ini_hash(data, n_data);
+        line = c_ini_index_find(&reuse->index, hash, c_ini_reuse_match_bytes, &bytes);
+        if (line)
+                c_ini_index_remove(&reuse->index, hash, line);
+
+        return line;
+}
+
+void c_ini_reuse_line_clear(CIniReuseLine *line) {
+        line->entry = c_ini_entry_unref(line->entry);
+        line->group = c_ini_group_unref(line->group);
+        line->raw = c_ini_raw_unref(line->raw);
+}
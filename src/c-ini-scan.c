@@ -0,0 +1,195 @@
+/*
+ * Ini-File Line Scanner
+ *
+ * All supported formats are line-based, and the classification of a line
+ * only depends on its first non-whitespace character, as well as on the
+ * position of the first assignment operator and the first closing bracket.
+ * The scanner finds the end of the next line as well as those two positions
+ * in a single sweep over the data, so the line parser never has to look at
+ * the line again.
+ *
+ * On x86, vectorized implementations using SSE2 or AVX2 are selected at
+ * runtime. Otherwise, the scanner falls back to memchr(3), which is usually
+ * vectorized by the C library already.
+ */
+
+#include <c-stdaux.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "c-ini.h"
+#include "c-ini-private.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#  define C_INI_SCAN_X86 1
+#  include <immintrin.h>
+#else
+#  define C_INI_SCAN_X86 0
+#endif
+
+static void c_ini_scan_generic(const uint8_t *data, size_t n_data, CIniScan *scan) {
+        const uint8_t *p;
+        size_t n;
+
+        *scan = (CIniScan)C_INI_SCAN_NULL;
+
+        /* empty lines might come without buffer, which memchr(3) rejects */
+        if (!n_data) {
+                scan->i_newline = 0;
+                return;
+        }
+
+        p = memchr(data, '\n', n_data);
+        n = p ? (size_t)(p - data) : n_data;
+
+        scan->i_newline = n;
+
+        p = memchr(data, '=', n);
+        if (p)
+                scan->i_assignment = p - data;
+
+        p = memchr(data, ']', n);
+        if (p)
+                scan->i_bracket = p - data;
+}
+
+#if C_INI_SCAN_X86
+
+static void c_ini_scan_tail(const uint8_t *data, size_t n_data, size_t i, CIniScan *scan) {
+        /*
+         * Scalar continuation of the vectorized scanners. @scan contains the
+         * results of everything before @i. Only the trailing bytes, which do
+         * not fill an entire vector, are left.
+         */
+        for ( ; i < n_data; ++i) {
+                switch (data[i]) {
+                case '\n':
+                        scan->i_newline = i;
+                        return;
+                case '=':
+                        if (scan->i_assignment == SIZE_MAX)
+                                scan->i_assignment = i;
+                        break;
+                case ']':
+                        if (scan->i_bracket == SIZE_MAX)
+                                scan->i_bracket = i;
+                        break;
+                }
+        }
+
+        scan->i_newline = n_data;
+}
+
+static bool c_ini_scan_mask(size_t i,
+                            uint32_t m_newline,
+                            uint32_t m_assignment,
+                            uint32_t m_bracket,
+                            CIniScan *scan) {
+        /*
+         * Merge the match-masks of a single vector at offset @i into @scan.
+         * Matches behind the first newline belong to the next line and are
+         * masked out. Returns true if the vector contained the end of line.
+         */
+
+        if (m_newline) {
+                m_assignment &= (m_newline & -m_newline) - 1;
+                m_bracket &= (m_newline & -m_newline) - 1;
+        }
+
+        if (m_assignment && scan->i_assignment == SIZE_MAX)
+                scan->i_assignment = i + __builtin_ctz(m_assignment);
+        if (m_bracket && scan->i_bracket == SIZE_MAX)
+                scan->i_bracket = i + __builtin_ctz(m_bracket);
+
+        if (m_newline) {
+                scan->i_newline = i + __builtin_ctz(m_newline);
+                return true;
+        }
+
+        return false;
+}
+
+__attribute__((__target__("sse2")))
+static void c_ini_scan_sse2(const uint8_t *data, size_t n_data, CIniScan *scan) {
+        const __m128i newline = _mm_set1_epi8('\n');
+        const __m128i assignment = _mm_set1_epi8('=');
+        const __m128i bracket = _mm_set1_epi8(']');
+        __m128i v;
+        size_t i;
+
+        *scan = (CIniScan)C_INI_SCAN_NULL;
+
+        for (i = 0; n_data - i >= 16; i += 16) {
+                v = _mm_loadu_si128((const __m128i *)(data + i));
+
+                if (c_ini_scan_mask(i,
+                                    _mm_movemask_epi8(_mm_cmpeq_epi8(v, newline)),
+                                    _mm_movemask_epi8(_mm_cmpeq_epi8(v, assignment)),
+                                    _mm_movemask_epi8(_mm_cmpeq_epi8(v, bracket)),
+                                    scan))
+                        return;
+        }
+
+        c_ini_scan_tail(data, n_data, i, scan);
+}
+
+__attribute__((__target__("avx2")))
+static void c_ini_scan_avx2(const uint8_t *data, size_t n_data, CIniScan *scan) {
+        const __m256i newline = _mm256_set1_epi8('\n');
+        const __m256i assignment = _mm256_set1_epi8('=');
+        const __m256i bracket = _mm256_set1_epi8(']');
+        __m256i v;
+        size_t i;
+
+        *scan = (CIniScan)C_INI_SCAN_NULL;
+
+        for (i = 0; n_data - i >= 32; i += 32) {
+                v = _mm256_loadu_si256((const __m256i *)(data + i));
+
+                if (c_ini_scan_mask(i,
+                                    (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, newline)),
+                                    (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, assignment)),
+                                    (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, bracket)),
+                                    scan))
+                        return;
+        }
+
+        c_ini_scan_tail(data, n_data, i, scan);
+}
+
+#endif
+
+unsigned int c_ini_scan_detect(void) {
+        /*
+         * Detect the fastest scanner supported by the running machine. All
+         * scanners produce identical results.
+         */
+
+#if C_INI_SCAN_X86
+        __builtin_cpu_init();
+
+        if (__builtin_cpu_supports("avx2"))
+                return C_INI_SCANNER_AVX2;
+        if (__builtin_cpu_supports("sse2"))
+                return C_INI_SCANNER_SSE2;
+#endif
+
+        return C_INI_SCANNER_GENERIC;
+}
+
+CIniScanFn c_ini_scan_select(unsigned int scanner) {
+        /*
+         * Resolve @scanner, as returned by c_ini_scan_detect(), or any
+         * scanner before it. Unknown scanners resolve to the generic one.
+         */
+        switch (scanner) {
+#if C_INI_SCAN_X86
+        case C_INI_SCANNER_AVX2:
+                return c_ini_scan_avx2;
+        case C_INI_SCANNER_SSE2:
+                return c_ini_scan_sse2;
+#endif
+        default:
+                return c_ini_scan_generic;
+        }
+}
@@ -0,0 +1,69 @@
+/*
+ * Ini-File Tokenizers
+ *
+ * A tokenizer walks a buffer line by line, and returns each line as a token
+ * to the caller. Lines are scanned and classified by the exact same logic as
+ * for domains, so tokens match what a reader would parse. Nothing is copied
+ * and nothing is allocated. All state lives in the tokenizer, which is
+ * allocated by the caller.
+ *
+ * Unlike readers, tokenizers operate on a single complete buffer. The last
+ * line does not need to be terminated by a newline.
+ */
+
+#include <c-stdaux.h>
+#include <stdlib.h>
+#include "c-ini.h"
+#include "c-ini-private.h"
+
+_c_public_ void c_ini_tokenizer_init(CIniTokenizer *tokenizer, const char *data, size_t n_data, unsigned int mode) {
+        *tokenizer = (CIniTokenizer)C_INI_TOKENIZER_NULL(*tokenizer);
+        tokenizer->data = data;
+        tokenizer->n_data = n_data;
+        tokenizer->mode = mode;
+        tokenizer->scanner = c_ini_scan_detect();
+}
+
+_c_public_ int c_ini_tokenizer_next(CIniTokenizer *tokenizer, CIniToken *token) {
+        const uint8_t *data = (const uint8_t *)tokenizer->data + tokenizer->i_data;
+        size_t n_data = tokenizer->n_data - tokenizer->i_data;
+        CIniScan scan;
+        CIniLine line;
+
+        /*
+         * Return the next token and 1, or 0 if the input is exhausted. The
+         * token is classified according to the mode of the tokenizer.
+         */
+
+        if (!n_data)
+                return 0;
+
+        c_ini_scan_select(tokenizer->scanner)(data, n_data, &scan);
+        if (scan.i_newline < n_data)
+                n_data = scan.i_newline + 1;
+
+        c_ini_line_parse(&line, tokenizer->mode, data, n_data, &scan);
+
+        *token = (CIniToken)C_INI_TOKEN_NULL(*token);
+        token->type = line.type;
+        token->i_line = tokenizer->i_data;
+        token->n_line = n_data;
+
+        switch (line.type) {
+        case C_INI_LINE_GROUP:
+                token->key = (const char *)data + line.i_key;
+                token->n_key = line.n_key;
+                break;
+        case C_INI_LINE_ENTRY:
+                token->key = (const char *)data + line.i_key;
+                token->n_key = line.n_key;
+                /* fallthrough */
+        case C_INI_LINE_COMMENT:
+                token->value = (const char *)data + line.i_value;
+                token->n_value = line.n_value;
+                break;
+        }
+
+        tokenizer->i_data += n_data;
+        return 1;
+}
@@ -0,0 +1,404 @@
+/*
+ * Ini-File Typed Values
+ *
+ * Values are stored as strings, but most of them are really booleans,
+ * numbers, or sizes. The typed getters parse a value according to the
+ * conventions of the XDG desktop-entry specification and glib-keyfiles, and
+ * cache the result in the entry, so hot configuration knobs are only ever
+ * parsed once.
+ *
+ * All parsers are strict: the entire value must be consumed, except for
+ * trailing whitespace (which glib ignores as well). Malformed values yield
+ * -EINVAL, values that do not fit the requested type yield -ERANGE.
+ * Numbers are always parsed in the C locale.
+ *
+ * Entries of frozen domains are immutable, hence their values are parsed on
+ * every access.
+ *
+ * Similarly, string values can contain the escape sequences "\s", "\n",
+ * "\t", "\r", and "\\". Values without any backslash are returned as is,
+ * without copying. Otherwise, the value is decoded once and the result is
+ * cached in the entry. Frozen domains store decoded values in their block.
+ * Unknown escapes are retained verbatim.
+ */
+
+#include <c-stdaux.h>
+#include <errno.h>
+#include <locale.h>
+#include <math.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include "c-ini.h"
+#include "c-ini-private.h"
+
+static _Atomic(locale_t) c_ini_value_locale;
+
+const CIniDecoded c_ini_decoded_verbatim = {};
+
+static size_t c_ini_value_strip(const char *data, size_t n_data) {
+        while (n_data && c_ini_is_whitespace(data[n_data - 1]))
+                --n_data;
+        return n_data;
+}
+
+static int c_ini_value_parse_digits(const char **datap, const char *end, uint64_t *valuep) {
+        const char *data = *datap;
+        uint64_t value = 0;
+        unsigned int digit;
+
+        if (data >= end || *data < '0' || *data > '9')
+                return -EINVAL;
+
+        do {
+                digit = *data - '0';
+                if (value > (UINT64_MAX - digit) / 10)
+                        return -ERANGE;
+
+                value = value * 10 + digit;
+        } while (++data < end && *data >= '0' && *data <= '9');
+
+        *datap = data;
+        *valuep = value;
+        return 0;
+}
+
+static int c_ini_value_parse_bool(const char *data, size_t n_data, CIniValue *value) {
+        n_data = c_ini_value_strip(data, n_data);
+
+        if ((n_data == 4 && !memcmp(data, "true", 4)) || (n_data == 1 && *data == '1'))
+                value->b = true;
+        else if ((n_data == 5 && !memcmp(data, "false", 5)) || (n_data == 1 && *data == '0'))
+                value->b = false;
+        else
+                return -EINVAL;
+
+        return 0;
+}
+
+static int c_ini_value_parse_int64(const char *data, size_t n_data, CIniValue *value) {
+        const char *end = data + c_ini_value_strip(data, n_data);
+        bool negative = false;
+        uint64_t u;
+        int r;
+
+        if (data < end && (*data == '-' || *data == '+'))
+                negative = (*data++ == '-');
+
+        r = c_ini_value_parse_digits(&data, end, &u);
+        if (r)
+                return r;
+        if (data != end)
+                return -EINVAL;
+
+        if (negative) {
+                if (u > (uint64_t)INT64_MAX + 1)
+                        return -ERANGE;
+                value->i64 = u ? -(int64_t)(u - 1) - 1 : 0;
+        } else {
+                if (u > INT64_MAX)
+                        return -ERANGE;
+                value->i64 = u;
+        }
+
+        return 0;
+}
+
+static int c_ini_value_parse_uint64(const char *data, size_t n_data, CIniValue *value) {
+        const char *end = data + c_ini_value_strip(data, n_data);
+        int r;
+
+        if (data < end && *data == '+')
+                ++data;
+
+        r = c_ini_value_parse_digits(&data, end, &value->u64);
+        if (r)
+                return r;
+        if (data != end)
+                return -EINVAL;
+
+        return 0;
+}
+
+static int c_ini_value_parse_size(const char *data, size_t n_data, CIniValue *value) {
+        static const char units[] = "KMGTPE";
+        const char *end = data + c_ini_value_strip(data, n_data), *unit;
+        unsigned int shift = 0;
+        uint64_t u;
+        int r;
+
+        /*
+         * Sizes are unsigned integers with an optional unit suffix. The units
+         * K, M, G, T, P, and E denote powers of 1024, and can be followed by
+         * "iB". A plain "B" is accepted as well.
+         */
+
+        r = c_ini_value_parse_digits(&data, end, &u);
+        if (r)
+                return r;
+
+        if (data < end && *data != 'B') {
+                unit = memchr(units, *data, sizeof(units) - 1);
+                if (!unit)
+                        return -EINVAL;
+
+                shift = 10 * (unit - units + 1);
+                ++data;
+
+                if (end - data >= 2 && data[0] == 'i' && data[1] == 'B')
+                        data += 2;
+        } else if (data < end) {
+                ++data;
+        }
+
+        if (data != end)
+                return -EINVAL;
+        if (shift && u > (UINT64_MAX >> shift))
+                return -ERANGE;
+
+        value->u64 = u << shift;
+        return 0;
+}
+
+static locale_t c_ini_value_get_locale(void) {
+        locale_t locale, expected = (locale_t)0;
+
+        locale = atomic_load_explicit(&c_ini_value_locale, memory_order_acquire);
+        if (locale)
+                return locale;
+
+        /*
+         * The C locale is created on first use and retained for the lifetime
+         * of the process. If multiple threads race, the loser discards its
+         * copy.
+         */
+        locale = newlocale(LC_NUMERIC_MASK, "C", (locale_t)0);
+        if (!locale)
+                return (locale_t)0;
+
+        if (!atomic_compare_exchange_strong_explicit(&c_ini_value_locale,
+                                                     &expected,
+                                                     locale,
+                                                     memory_order_acq_rel,
+                                                     memory_order_acquire)) {
+                freelocale(locale);
+                locale = expected;
+        }
+
+        return locale;
+}
+
+static int c_ini_value_parse_double(const char *data, size_t n_data, CIniValue *value) {
+        _c_cleanup_(c_freep) char *heap = NULL;
+        char buffer[64], *copy, *end;
+        locale_t locale;
+        double d;
+
+        n_data = c_ini_value_strip(data, n_data);
+
+        /* strtod() skips leading whitespace, but the other parsers do not */
+        if (!n_data || c_ini_is_whitespace(*data))
+                return -EINVAL;
+
+        locale = c_ini_value_get_locale();
+        if (!locale)
+                return -ENOMEM;
+
+        /* values are not necessarily zero-terminated, so copy them */
+        if (n_data < sizeof(buffer)) {
+                copy = buffer;
+        } else {
+                copy = heap = malloc(n_data + 1);
+                if (!heap)
+                        return -ENOMEM;
+        }
+
+        c_memcpy(copy, data, n_data);
+        copy[n_data] = 0;
+
+        errno = 0;
+        d = strtod_l(copy, &end, locale);
+        if (end != copy + n_data)
+                return -EINVAL;
+        if (errno == ERANGE && isinf(d))
+                return -ERANGE;
+
+        value->d = d;
+        return 0;
+}
+
+static int c_ini_value_get(CIniEntry *entry, unsigned int type, CIniValueParseFn parse, CIniValue *valuep) {
+        unsigned int cached = C_INI_VALUE_NONE;
+        CIniValue value = {};
+        const char *data;
+        size_t n_data;
+
+        if (!c_ini_is_frozen(entry)) {
+                cached = atomic_load_explicit(&entry->cache_type, memory_order_acquire);
+                if (cached == type) {
+                        *valuep = entry->cache;
+                        return valuep->r;
+                }
+        }
+
+        data = c_ini_entry_get_value(entry, &n_data);
+        value.r = parse(data, n_data, &value);
+
+        /*
+         * The cache can only be claimed once. Whoever claims it fills it in
+         * and publishes it. Anyone else just keeps their own result.
+         * Allocation failures are transient, so they are never cached.
+         */
+        if (cached == C_INI_VALUE_NONE && value.r != -ENOMEM && !c_ini_is_frozen(entry) &&
+            atomic_compare_exchange_strong_explicit(&entry->cache_type,
+                                                    &cached,
+                                                    C_INI_VALUE_BUSY,
+                                                    memory_order_relaxed,
+                                                    memory_order_relaxed)) {
+                entry->cache = value;
+                atomic_store_explicit(&entry->cache_type, type, memory_order_release);
+        }
+
+        *valuep = value;
+        return value.r;
+}
+
+_c_public_ int c_ini_entry_get_bool(CIniEntry *entry, bool *valuep) {
+        CIniValue value;
+        int r;
+
+        r = c_ini_value_get(entry, C_INI_VALUE_BOOL, c_ini_value_parse_bool, &value);
+        if (r)
+                return r;
+
+        *valuep = value.b;
+        return 0;
+}
+
+_c_public_ int c_ini_entry_get_int64(CIniEntry *entry, int64_t *valuep) {
+        CIniValue value;
+        int r;
+
+        r = c_ini_value_get(entry, C_INI_VALUE_INT64, c_ini_value_parse_int64, &value);
+        if (r)
+                return r;
+
+        *valuep = value.i64;
+        return 0;
+}
+
+_c_public_ int c_ini_entry_get_uint64(CIniEntry *entry, uint64_t *valuep) {
+        CIniValue value;
+        int r;
+
+        r = c_ini_value_get(entry, C_INI_VALUE_UINT64, c_ini_value_parse_uint64, &value);
+        if (r)
+                return r;
+
+        *valuep = value.u64;
+        return 0;
+}
+
+_c_public_ int c_ini_entry_get_double(CIniEntry *entry, double *valuep) {
+        CIniValue value;
+        int r;
+
+        r = c_ini_value_get(entry, C_INI_VALUE_DOUBLE, c_ini_value_parse_double, &value);
+        if (r)
+                return r;
+
+        *valuep = value.d;
+        return 0;
+}
+
+_c_public_ int c_ini_entry_get_size(CIniEntry *entry, uint64_t *valuep) {
+        CIniValue value;
+        int r;
+
+        r = c_ini_value_get(entry, C_INI_VALUE_SIZE, c_ini_value_parse_size, &value);
+        if (r)
+                return r;
+
+        *valuep = value.u64;
+        return 0;
+}
+
+size_t c_ini_value_decode(char *dst, const char *src, size_t n_src) {
+        const char *end = src + n_src;
+        size_t n = 0;
+        char c;
+
+        /*
+         * Decode all escape sequences of @src into @dst and return the
+         * length of the result, excluding the zero-terminator. If @dst is
+         * NULL, only the length is computed. The result is never longer
+         * than @src.
+         */
+
+        while (src < end) {
+                if (*src != '\\' || src + 1 >= end || !(c = c_ini_unescape(src[1]))) {
+                        if (dst)
+                                dst[n] = *src;
+                        ++n;
+                        ++src;
+                        continue;
+                }
+
+                if (dst)
+                        dst[n] = c;
+                ++n;
+                src += 2;
+        }
+
+        if (dst)
+                dst[n] = 0;
+
+        return n;
+}
+
+_c_public_ int c_ini_entry_get_string(CIniEntry *entry, const char **stringp, size_t *n_stringp) {
+        CIniDecoded *decoded, *expected = NULL;
+        size_t n;
+
+        if (c_ini_is_frozen(entry)) {
+                *stringp = c_ini_frozen_entry_get_string(entry, n_stringp);
+                return 0;
+        }
+
+        decoded = atomic_load_explicit(&entry->decoded, memory_order_acquire);
+        if (!decoded) {
+                if (!memchr(entry->value, '\\', entry->n_value)) {
+                        decoded = C_INI_DECODED_VERBATIM;
+                } else {
+                        n = c_ini_value_decode(NULL, (const char *)entry->value, entry->n_value);
+                        decoded = malloc(sizeof(*decoded) + n + 1);
+                        if (!decoded)
+                                return -ENOMEM;
+
+                        decoded->n_data = c_ini_value_decode(decoded->data, (const char *)entry->value, entry->n_value);
+                }
+
+                /* if another thread was faster, use its result instead */
+                if (!atomic_compare_exchange_strong_explicit(&entry->decoded,
+                                                             &expected,
+                                                             decoded,
+                                                             memory_order_acq_rel,
+                                                             memory_order_acquire)) {
+                        if (decoded != C_INI_DECODED_VERBATIM)
+                                free(decoded);
+                        decoded = expected;
+                }
+        }
+
+        if (decoded == C_INI_DECODED_VERBATIM) {
+                *stringp = (const char *)entry->value;
+                if (n_stringp)
+                        *n_stringp = entry->n_value;
+        } else {
+                *stringp = decoded->data;
+                if (n_stringp)
+                        *n_stringp = decoded->n_data;
+        }
+
+        return 0;
+}
@@ -0,0 +1,445 @@
+/*
+ * Ini-File Watches
+ *
+ * A watch owns the current domain parsed from a set of files, and reloads it
+ * whenever any of the files change. Changes are detected via inotify on the
+ * parent directories, so files that are replaced atomically via rename(2)
+ * are picked up as well. The caller polls the inotify file descriptor and
+ * calls c_ini_watch_dispatch() from whatever thread drives its reloads.
+ *
+ * Parent directories do not have to exist. Until they show up, the nearest
+ * existing ancestor is watched instead. Similarly, if a watched directory is
+ * removed or renamed, its files are armed again from scratch, so reloads
+ * continue once the directory is back.
+ *
+ * The current domain is published as a snapshot with a single atomic pointer
+ * swap. Any number of threads can acquire the current snapshot concurrently
+ * with a reload, without taking locks, and without ever waiting for the
+ * reload. A snapshot keeps its domain alive until the last holder released
+ * it, so readers always see a consistent domain.
+ *
+ * Acquiring a snapshot loads the pointer and then increments the hold count
+ * of the snapshot. To make sure a snapshot is not destroyed between those two
+ * steps, readers protect it with a hazard pointer: each watch has a fixed set
+ * of slots, and a reader claims a free one by storing the snapshot it is
+ * about to hold in it. It then checks that the snapshot is still current,
+ * takes its hold, and clears the slot again. After a swap, the reloading
+ * thread drops its hold on the previous snapshot only if no slot protects
+ * it. Otherwise, the snapshot is retired, and checked again on the next
+ * reload. A snapshot can only be protected by a slot, so at most one
+ * retired snapshot per slot is kept. Hence, reloads never wait for readers,
+ * and retirement is bounded. Readers retry only if a reload happened while
+ * they acquired, and wait only if more threads than there are slots acquire
+ * at the very same time.
+ *
+ * Holding a snapshot allows for read-only access to its domain from any
+ * thread. Unless the library is built with atomic reference counters, the
+ * objects of the domain must not be referenced, though. Their reference
+ * counters are not safe against concurrent modification.
+ */
+
+#include <c-stdaux.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#include "c-ini.h"
+#include "c-ini-private.h"
+
+#define C_INI_WATCH_EVENTS (IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | \
+                            IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR)
+#define C_INI_WATCH_GONE (IN_IGNORED | IN_DELETE_SELF | IN_MOVE_SELF)
+#define C_INI_WATCH_SLOTS (32U)
+#define C_INI_WATCH_SLOT_SIZE (64U)
+
+typedef struct CIniWatchFile CIniWatchFile;
+typedef struct CIniWatchSlot CIniWatchSlot;
+
+struct CIniSnapshot {
+        atomic_ulong n_holds;
+        CIniDomain *domain;
+};
+
+struct CIniWatchFile {
+        int wd;
+        bool parent;
+        char *path;
+        const char *name;
+};
+
+/* slots are padded, so readers do not share cache-lines */
+struct CIniWatchSlot {
+        _Atomic(CIniSnapshot *) hazard;
+        uint8_t padding[C_INI_WATCH_SLOT_SIZE - sizeof(CIniSnapshot *)];
+};
+
+struct CIniWatch {
+        unsigned int mode;
+        int fd;
+
+        CIniWatchFile *files;
+        size_t n_files;
+
+        _Atomic(CIniSnapshot *) current;
+        CIniWatchSlot slots[C_INI_WATCH_SLOTS];
+
+        CIniSnapshot *retired[C_INI_WATCH_SLOTS + 1];
+        size_t n_retired;
+};
+
+static _Thread_local size_t c_ini_watch_hint;
+
+#define C_INI_WATCH_NULL(_x) {                                                  \
+                .fd = -1,                                                       \
+        }
+
+static int c_ini_snapshot_new(CIniSnapshot **snapshotp, CIniDomain *domain) {
+        CIniSnapshot *snapshot;
+
+        snapshot = calloc(1, sizeof(*snapshot));
+        if (!snapshot)
+                return -ENOMEM;
+
+        atomic_init(&snapshot->n_holds, 1);
+        snapshot->domain = c_ini_domain_ref(domain);
+
+        *snapshotp = snapshot;
+        return 0;
+}
+
+_c_public_ CIniSnapshot *c_ini_snapshot_release(CIniSnapshot *snapshot) {
+        /*
+         * The last holder destroys the snapshot. The release ordering makes
+         * sure all accesses of other holders happen before that.
+         */
+        if (snapshot && atomic_fetch_sub_explicit(&snapshot->n_holds, 1, memory_order_acq_rel) == 1) {
+                c_ini_domain_unref(snapshot->domain);
+                free(snapshot);
+        }
+
+        return NULL;
+}
+
+_c_public_ CIniDomain *c_ini_snapshot_get_domain(CIniSnapshot *snapshot) {
+        return snapshot->domain;
+}
+
+static _Atomic(CIniSnapshot *) *c_ini_watch_claim(CIniWatch *watch, CIniSnapshot *snapshot) {
+        CIniSnapshot *expected;
+        size_t i, n;
+
+        /* claim a free slot for @snapshot, starting with the one used last */
+        for (n = 0; ; ++n) {
+                i = (c_ini_watch_hint + n) % C_INI_WATCH_SLOTS;
+                expected = NULL;
+                if (atomic_compare_exchange_strong(&watch->slots[i].hazard, &expected, snapshot)) {
+                        c_ini_watch_hint = i;
+                        return &watch->slots[i].hazard;
+                }
+
+                if (n % C_INI_WATCH_SLOTS == C_INI_WATCH_SLOTS - 1)
+                        sched_yield();
+        }
+}
+
+_c_public_ CIniSnapshot *c_ini_watch_acquire(CIniWatch *watch) {
+        _Atomic(CIniSnapshot *) *hazard;
+        CIniSnapshot *snapshot, *current;
+
+        /*
+         * Once the slot protects the snapshot, and the snapshot is still
+         * current, the reloading thread will not drop its hold before the
+         * slot is cleared. The release ordering makes sure the new hold is
+         * visible to it by then.
+         */
+        snapshot = atomic_load(&watch->current);
+        hazard = c_ini_watch_claim(watch, snapshot);
+        while ((current = atomic_load(&watch->current)) != snapshot) {
+                snapshot = current;
+                atomic_store(hazard, snapshot);
+        }
+
+        atomic_fetch_add_explicit(&snapshot->n_holds, 1, memory_order_relaxed);
+        atomic_store_explicit(hazard, NULL, memory_order_release);
+
+        return snapshot;
+}
+
+static bool c_ini_watch_protects(CIniWatch *watch, CIniSnapshot *snapshot) {
+        size_t i;
+
+        for (i = 0; i < C_INI_WATCH_SLOTS; ++i)
+                if (atomic_load(&watch->slots[i].hazard) == snapshot)
+                        return true;
+
+        return false;
+}
+
+static void c_ini_watch_publish(CIniWatch *watch, CIniSnapshot *snapshot) {
+        size_t i, n = 0;
+
+        /*
+         * Readers that loaded the previous snapshot might not have taken
+         * their hold, yet. Rather than waiting for them, the hold of the
+         * watch is dropped only for retired snapshots that are no longer
+         * protected by any slot. The others are kept for the next reload.
+         */
+
+        watch->retired[watch->n_retired++] = atomic_exchange(&watch->current, snapshot);
+
+        for (i = 0; i < watch->n_retired; ++i) {
+                if (c_ini_watch_protects(watch, watch->retired[i]))
+                        watch->retired[n++] = watch->retired[i];
+                else
+                        c_ini_snapshot_release(watch->retired[i]);
+        }
+
+        watch->n_retired = n;
+}
+
+static int c_ini_watch_parse(CIniWatch *watch, CIniSnapshot **snapshotp) {
+        _c_cleanup_(c_ini_reader_deinit) CIniReader reader = C_INI_READER_NULL(reader);
+        _c_cleanup_(c_ini_domain_unrefp) CIniDomain *domain = NULL;
+        size_t i;
+        int r;
+
+        r = c_ini_reader_init(&reader);
+        if (r)
+                return r;
+
+        reader.mode = watch->mode;
+
+        /* missing files are treated as empty, they might show up later */
+        for (i = 0; i < watch->n_files; ++i) {
+                r = c_ini_reader_feed_path(&reader, watch->files[i].path);
+                if (r && r != -ENOENT)
+                        return r;
+
+                r = c_ini_reader_flush(&reader);
+                if (r)
+                        return r;
+        }
+
+        r = c_ini_reader_seal(&reader, &domain);
+        if (r)
+                return r;
+
+        return c_ini_snapshot_new(snapshotp, domain);
+}
+
+static int c_ini_watch_arm(CIniWatch *watch, CIniWatchFile *file) {
+        _c_cleanup_(c_freep) char *dir = NULL;
+        char *slash;
+        int r;
+
+        /*
+         * Watch the parent directory, so files that are created or replaced
+         * later on are noticed as well. If it does not exist, watch the
+         * nearest existing ancestor, and arm again whenever it changes.
+         */
+
+        dir = strdup(file->path);
+        if (!dir)
+                return -ENOMEM;
+
+        file->parent = true;
+
+        for (;;) {
+                slash = strrchr(dir, '/');
+                if (slash)
+                        *slash = 0;
+
+                file->wd = inotify_add_watch(watch->fd,
+                                             slash ? (slash == dir ? "/" : dir) : ".",
+                                             C_INI_WATCH_EVENTS);
+                if (file->wd >= 0)
+                        return 0;
+
+                r = -errno;
+                if ((r != -ENOENT && r != -ENOTDIR) || !slash || slash == dir)
+                        return r;
+
+                file->parent = false;
+        }
+}
+
+_c_public_ int c_ini_watch_new(CIniWatch **watchp, unsigned int mode, const char * const *paths) {
+        _c_cleanup_(c_ini_watch_freep) CIniWatch *watch = NULL;
+        CIniSnapshot *snapshot;
+        CIniWatchFile *file;
+        char *slash;
+        size_t i, n;
+        int r;
+
+        watch = calloc(1, sizeof(*watch));
+        if (!watch)
+                return -ENOMEM;
+
+        *watch = (CIniWatch)C_INI_WATCH_NULL(*watch);
+        watch->mode = mode;
+        atomic_init(&watch->current, NULL);
+        for (i = 0; i < C_INI_WATCH_SLOTS; ++i)
+                atomic_init(&watch->slots[i].hazard, NULL);
+
+        for (n = 0; paths[n]; ++n)
+                /* empty */ ;
+
+        watch->files = calloc(n ?: 1, sizeof(*watch->files));
+        if (!watch->files)
+                return -ENOMEM;
+
+        watch->fd = inotify_init1(IN_CLOEXEC | IN_NONBLOCK);
+        if (watch->fd < 0)
+                return -errno;
+
+        for (i = 0; i < n; ++i) {
+                file = &watch->files[i];
+
+                file->path = strdup(paths[i]);
+                if (!file->path)
+                        return -ENOMEM;
+
+                ++watch->n_files;
+
+                slash = strrchr(file->path, '/');
+                file->name = slash ? slash + 1 : file->path;
+
+                r = c_ini_watch_arm(watch, file);
+                if (r)
+                        return r;
+        }
+
+        r = c_ini_watch_parse(watch, &snapshot);
+        if (r)
+                return r;
+
+        atomic_store(&watch->current, snapshot);
+
+        *watchp = watch;
+        watch = NULL;
+        return 0;
+}
+
+_c_public_ CIniWatch *c_ini_watch_free(CIniWatch *watch) {
+        size_t i;
+
+        if (!watch)
+                return NULL;
+
+        /* all readers must be done with the watch, snapshots may live on */
+        c_ini_snapshot_release(atomic_load(&watch->current));
+        for (i = 0; i < watch->n_retired; ++i)
+                c_ini_snapshot_release(watch->retired[i]);
+
+        for (i = 0; i < watch->n_files; ++i)
+                free(watch->files[i].path);
+        free(watch->files);
+        c_close(watch->fd);
+        free(watch);
+
+        return NULL;
+}
+
+_c_public_ int c_ini_watch_get_fd(CIniWatch *watch) {
+        return watch->fd;
+}
+
+_c_public_ int c_ini_watch_reload(CIniWatch *watch) {
+        CIniSnapshot *snapshot;
+        int r;
+
+        /*
+         * Parse all files again and publish the result. On failure, the
+         * current snapshot is kept. Reloads must not run concurrently, but
+         * any number of readers can acquire snapshots meanwhile.
+         */
+
+        r = c_ini_watch_parse(watch, &snapshot);
+        if (r)
+                return r;
+
+        c_ini_watch_publish(watch, snapshot);
+        return 0;
+}
+
+static int c_ini_watch_handle(CIniWatch *watch, const struct inotify_event *event, bool *changedp) {
+        CIniWatchFile *file;
+        size_t i;
+        int r;
+
+        /*
+         * Check whether @event concerns a watched file. If the directory
+         * watched for a file went away, or it is an ancestor that changed,
+         * the file is armed again. Events might have been lost on overflow,
+         * so everything is armed again then.
+         */
+
+        if (event->mask & IN_Q_OVERFLOW)
+                *changedp = true;
+
+        for (i = 0; i < watch->n_files; ++i) {
+                file = &watch->files[i];
+
+                if (event->mask & IN_Q_OVERFLOW ||
+                    (file->wd == event->wd && (event->mask & C_INI_WATCH_GONE || !file->parent))) {
+                        r = c_ini_watch_arm(watch, file);
+                        if (r)
+                                return r;
+
+                        /* the file might have vanished or shown up */
+                        if (file->parent || event->mask & C_INI_WATCH_GONE)
+                                *changedp = true;
+                } else if (file->wd == event->wd && event->len && !strcmp(file->name, event->name)) {
+                        *changedp = true;
+                }
+        }
+
+        return 0;
+}
+
+_c_public_ int c_ini_watch_dispatch(CIniWatch *watch) {
+        _Alignas(struct inotify_event) uint8_t buffer[4096];
+        const struct inotify_event *event;
+        bool changed = false;
+        ssize_t l;
+        size_t i;
+        int r;
+
+        /*
+         * Drain all pending events, and reload once if any of them concerns
+         * a watched file. Returns 1 if a new snapshot was published, 0 if
+         * nothing changed.
+         */
+
+        for (;;) {
+                l = read(watch->fd, buffer, sizeof(buffer));
+                if (l < 0) {
+                        if (errno == EINTR)
+                                continue;
+                        if (errno == EAGAIN)
+                                break;
+                        return -errno;
+                }
+
+                for (i = 0; i < (size_t)l; i += sizeof(*event) + event->len) {
+                        event = (const struct inotify_event *)(buffer + i);
+                        r = c_ini_watch_handle(watch, event, &changed);
+                        if (r)
+                                return r;
+                }
+        }
+
+        if (!changed)
+                return 0;
+
+        r = c_ini_watch_reload(watch);
+        if (r)
+                return r;
+
+        return 1;
+}
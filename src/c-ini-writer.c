@@ -0,0 +1,259 @@
+/*
+ * Ini-File Writers
+ *
+ * A domain keeps every line of its sources as raw line, including comments,
+ * blank lines, and malformed lines. Writing a domain simply emits those raw
+ * lines in order, without re-formatting them. Hence, the output reproduces
+ * the sources byte by byte, and parsing it again yields an equal domain.
+ *
+ * The output is assembled as an I/O vector that points directly into the raw
+ * lines, which is then handed in batches to a sink. The fd sink passes the
+ * vectors to writev(2), so no data is copied at all.
+ *
+ * Frozen domains do not retain their raw lines. Their output is synthesized
+ * from their groups and entries in canonical form.
+ */
+
+#include <c-stdaux.h>
+#include <errno.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/uio.h>
+#include "c-ini.h"
+#include "c-ini-private.h"
+
+/* number of I/O vectors passed to a sink at once, at most IOV_MAX */
+#define C_INI_WRITER_BATCH (1024U)
+
+typedef struct CIniWriter CIniWriter;
+typedef int (*CIniWriterSinkFn) (CIniWriter *writer, struct iovec *iov, size_t n_iov);
+
+struct CIniWriter {
+        CIniWriterSinkFn sink;
+        void *userdata;
+        struct iovec iov[C_INI_WRITER_BATCH];
+        size_t n_iov;
+};
+
+static int c_ini_writer_flush(CIniWriter *writer) {
+        int r;
+
+        if (!writer->n_iov)
+                return 0;
+
+        r = writer->sink(writer, writer->iov, writer->n_iov);
+        writer->n_iov = 0;
+        return r;
+}
+
+static int c_ini_writer_push(CIniWriter *writer, const void *data, size_t n_data) {
+        int r;
+
+        if (!n_data)
+                return 0;
+
+        if (writer->n_iov >= C_INI_WRITER_BATCH) {
+                r = c_ini_writer_flush(writer);
+                if (r)
+                        return r;
+        }
+
+        writer->iov[writer->n_iov++] = (struct iovec){
+                .iov_base = (void *)data,
+                .iov_len = n_data,
+        };
+        return 0;
+}
+
+static int c_ini_writer_push_group(CIniWriter *writer, CIniGroup *group, bool label) {
+        const char *data;
+        CIniEntry *entry;
+        size_t n_data;
+        int r;
+
+        if (label) {
+                data = c_ini_group_get_label(group, &n_data);
+                r = c_ini_writer_push(writer, "[", 1);
+                if (!r)
+                        r = c_ini_writer_push(writer, data, n_data);
+                if (!r)
+                        r = c_ini_writer_push(writer, "]\n", 2);
+                if (r)
+                        return r;
+        }
+
+        for (entry = c_ini_group_iterate(group); entry; entry = c_ini_entry_next(entry)) {
+                data = c_ini_entry_get_key(entry, &n_data);
+                r = c_ini_writer_push(writer, data, n_data);
+                if (!r)
+                        r = c_ini_writer_push(writer, "=", 1);
+                if (!r) {
+                        data = c_ini_entry_get_value(entry, &n_data);
+                        r = c_ini_writer_push(writer, data, n_data);
+                }
+                if (!r)
+                        r = c_ini_writer_push(writer, "\n", 1);
+                if (r)
+                        return r;
+        }
+
+        return 0;
+}
+
+static int c_ini_writer_run(CIniWriter *writer, CIniDomain *domain) {
+        CIniGroup *group;
+        CIniRaw *raw;
+        int r;
+
+        if (domain->frozen) {
+                r = c_ini_writer_push_group(writer, domain->null_group, false);
+                if (r)
+                        return r;
+
+                for (group = c_ini_domain_iterate(domain); group; group = c_ini_group_next(group)) {
+                        r = c_ini_writer_push_group(writer, group, true);
+                        if (r)
+                                return r;
+                }
+
+                return c_ini_writer_flush(writer);
+        }
+
+        c_list_for_each_entry(raw, &domain->list_raws, link_domain) {
+                r = c_ini_writer_push(writer, raw->data, raw->n_data);
+                if (r)
+                        return r;
+
+                /*
+                 * Only the very last line of a source can lack its newline.
+                 * If multiple sources were fed into the domain, terminate
+                 * such lines, so they are not merged with the next one.
+                 */
+                if (raw->n_data && raw->data[raw->n_data - 1] != '\n' &&
+                    raw->link_domain.next != &domain->list_raws) {
+                        r = c_ini_writer_push(writer, "\n", 1);
+                        if (r)
+                                return r;
+                }
+        }
+
+        return c_ini_writer_flush(writer);
+}
+
+static int c_ini_writer_sink_size(CIniWriter *writer, struct iovec *iov, size_t n_iov) {
+        size_t i, *n = writer->userdata;
+
+        for (i = 0; i < n_iov; ++i)
+                *n += iov[i].iov_len;
+
+        return 0;
+}
+
+static int c_ini_writer_sink_buffer(CIniWriter *writer, struct iovec *iov, size_t n_iov) {
+        uint8_t **p = writer->userdata;
+        size_t i;
+
+        for (i = 0; i < n_iov; ++i)
+                *p = (uint8_t *)c_memcpy(*p, iov[i].iov_base, iov[i].iov_len) + iov[i].iov_len;
+
+        return 0;
+}
+
+_c_public_ int c_ini_domain_write(CIniDomain *domain, char **datap, size_t *n_datap) {
+        _c_cleanup_(c_freep) char *data = NULL;
+        CIniWriter writer = {};
+        size_t n_data = 0;
+        uint8_t *p;
+        int r;
+
+        /*
+         * Write the domain into a newly allocated buffer. The buffer is
+         * zero-terminated for convenience, but the terminator is not
+         * accounted for in the returned size.
+         */
+
+        writer.sink = c_ini_writer_sink_size;
+        writer.userdata = &n_data;
+        r = c_ini_writer_run(&writer, domain);
+        if (r)
+                return r;
+
+        data = malloc(n_data + 1);
+        if (!data)
+                return -ENOMEM;
+
+        p = (uint8_t *)data;
+        writer.sink = c_ini_writer_sink_buffer;
+        writer.userdata = &p;
+        r = c_ini_writer_run(&writer, domain);
+        if (r)
+                return r;
+
+        c_assert(p == (uint8_t *)data + n_data);
+        *p = 0;
+
+        *datap = data;
+        *n_datap = n_data;
+        data = NULL;
+        return 0;
+}
+
+static int c_ini_writer_sink_file(CIniWriter *writer, struct iovec *iov, size_t n_iov) {
+        FILE *f = writer->userdata;
+        size_t i;
+
+        for (i = 0; i < n_iov; ++i)
+                if (fwrite(iov[i].iov_base, 1, iov[i].iov_len, f) != iov[i].iov_len)
+                        return -EIO;
+
+        return 0;
+}
+
+_c_public_ int c_ini_domain_write_file(CIniDomain *domain, FILE *f) {
+        CIniWriter writer = {
+                .sink = c_ini_writer_sink_file,
+                .userdata = f,
+        };
+
+        return c_ini_writer_run(&writer, domain);
+}
+
+static int c_ini_writer_sink_fd(CIniWriter *writer, struct iovec *iov, size_t n_iov) {
+        int fd = *(int *)writer->userdata;
+        size_t n;
+        ssize_t l;
+
+        while (n_iov) {
+                l = writev(fd, iov, n_iov);
+                if (l < 0) {
+                        if (errno == EINTR)
+                                continue;
+                        return -errno;
+                }
+
+                /* skip everything that was written, and retry the rest */
+                n = l;
+                while (n_iov && n >= iov->iov_len) {
+                        n -= iov->iov_len;
+                        ++iov;
+                        --n_iov;
+                }
+                if (n) {
+                        iov->iov_base = (uint8_t *)iov->iov_base + n;
+                        iov->iov_len -= n;
+                }
+        }
+
+        return 0;
+}
+
+_c_public_ int c_ini_domain_write_fd(CIniDomain *domain, int fd) {
+        CIniWriter writer = {
+                .sink = c_ini_writer_sink_fd,
+                .userdata = &fd,
+        };
+
+        return c_ini_writer_run(&writer, domain);
+}
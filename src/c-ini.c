@@ -25,43 +25,76 @@ static int c_ini_entry_compare(CRBTree *t, void *k, CRBNode *rb) {
 }
 
 int c_ini_entry_new(CIniEntry **entryp,
+                    CIniArena *arena,
                     const uint8_t *key,
                     size_t n_key,
                     const uint8_t *value,
                     size_t n_value) {
-        _c_cleanup_(c_ini_entry_unrefp) CIniEntry *entry = NULL;
-        _c_cleanup_(c_ini_freep) uint8_t *dup_key = NULL, *dup_value = NULL;
+        CIniEntry *entry;
 
-        dup_key = calloc(1, n_key + 1);
-        if (!dup_key)
+        /*
+         * Allocate the entry together with zero-terminated copies of its key
+         * and value. This is a single allocation, either from the arena, or
+         * from the heap if no arena is given.
+         */
+
+        entry = c_ini_arena_alloc(arena, sizeof(*entry) + n_key + 1 + n_value + 1);
+        if (!entry)
                 return -ENOMEM;
 
-        c_memcpy(dup_key, key, n_key);
+        *entry = (CIniEntry)C_INI_ENTRY_NULL(*entry);
+        entry->arena = c_ini_arena_ref(arena);
+        entry->key = entry->storage;
+        entry->n_key = n_key;
+        entry->value = entry->storage + n_key + 1;
+        entry->n_value = n_value;
 
-        dup_value = calloc(1, n_value + 1);
-        if (!dup_value)
-                return -ENOMEM;
+        c_memcpy(entry->key, key, n_key);
+        entry->key[n_key] = 0;
+        c_memcpy(entry->value, value, n_value);
+        entry->value[n_value] = 0;
+
+        *entryp = entry;
+        return 0;
+}
+
+int c_ini_entry_new_borrowed(CIniEntry **entryp,
+                             CIniArena *arena,
+                             CIniRaw *raw,
+                             const uint8_t *key,
+                             size_t n_key,
+                             const uint8_t *value,
+                             size_t n_value) {
+        CIniEntry *entry;
 
-        c_memcpy(dup_value, value, n_value);
+        /*
+         * Rather than copying the key and value, reference them directly in
+         * the raw line they were parsed from. The entry pins the raw line, so
+         * the data stays accessible for as long as the entry is.
+         */
 
-        entry = calloc(1, sizeof(*entry));
+        c_assert(key >= raw->data && key + n_key <= raw->data + raw->n_data);
+        c_assert(value >= raw->data && value + n_value <= raw->data + raw->n_data);
+
+        entry = c_ini_arena_alloc(arena, sizeof(*entry));
         if (!entry)
                 return -ENOMEM;
 
         *entry = (CIniEntry)C_INI_ENTRY_NULL(*entry);
-        entry->key = dup_key;
-        dup_key = NULL;
+        entry->arena = c_ini_arena_ref(arena);
+        entry->raw = c_ini_raw_ref(raw);
+        entry->key = (uint8_t *)key;
         entry->n_key = n_key;
-        entry->value = dup_value;
-        dup_value = NULL;
+        entry->value = (uint8_t *)value;
         entry->n_value = n_value;
 
         *entryp = entry;
-        entry = NULL;
         return 0;
 }
 
 static CIniEntry *c_ini_entry_free_internal(CIniEntry *entry) {
+        CIniArena *arena;
+
         if (!entry)
                 return NULL;
 
@@ -69,25 +102,89 @@ static CIniEntry *c_ini_entry_free_internal(CIniEntry *entry) {
         c_assert(!c_list_is_linked(&entry->link_group));
         c_assert(!c_rbnode_is_linked(&entry->rb_group));
 
-        free(entry->value);
-        free(entry->key);
-        free(entry);
+        if (entry->decoded != C_INI_DECODED_VERBATIM)
+                free(entry->decoded);
+
+        arena = entry->arena;
+        c_ini_raw_unref(entry->raw);
+        c_ini_arena_free(arena, entry);
+        c_ini_arena_unref(arena);
 
         return NULL;
 }
 
 _c_public_ CIniEntry *c_ini_entry_ref(CIniEntry *entry) {
-        if (entry)
-                ++entry->n_refs;
+        if (entry && c_ini_is_frozen(entry))
+                c_ini_domain_ref(c_ini_frozen_entry_get_domain(entry));
+        else if (entry)
+                c_ini_ref_inc(&entry->n_refs);
         return entry;
 }
 
 _c_public_ CIniEntry *c_ini_entry_unref(CIniEntry *entry) {
-        if (entry && !--entry->n_refs)
+        if (entry && c_ini_is_frozen(entry))
+                c_ini_domain_unref(c_ini_frozen_entry_get_domain(entry));
+        else if (entry && c_ini_ref_dec(&entry->n_refs))
                 c_ini_entry_free_internal(entry);
         return NULL;
 }
 
+static bool c_ini_entry_match(const void *k, void *p) {
+        const CIniBytes *bytes = k;
+        CIniEntry *entry = p;
+
+        return bytes->n_data == entry->n_key &&
+               !memcmp(bytes->data, entry->key, bytes->n_data);
+}
+
+static void c_ini_group_index_add(CIniGroup *group, CIniEntry *entry) {
+        CIniEntry *iter;
+        int r;
+
+        /*
+         * If the index is full, rebuild it from the entry list, which already
+         * contains @entry. The list is in order of addition, as required by
+         * the index. If the index cannot be grown, drop it and fall back to
+         * the lookup tree.
+         */
+
+        if (!c_ini_index_is_full(&group->index_entries)) {
+                c_ini_index_add(&group->index_entries, entry->hash, entry);
+                return;
+        }
+
+        r = c_ini_index_reset(&group->index_entries, group->index_entries.n_live + 1);
+        if (r) {
+                c_ini_index_deinit(&group->index_entries);
+                group->indexed = false;
+                return;
+        }
+
+        c_list_for_each_entry(iter, &group->list_entries, link_group)
+                c_ini_index_add(&group->index_entries, iter->hash, iter);
+}
+
+static void c_ini_group_enable_index(CIniGroup *group) {
+        CIniEntry *entry;
+        size_t n = 0;
+        int r;
+
+        if (group->indexed)
+                return;
+
+        c_list_for_each_entry(entry, &group->list_entries, link_group)
+                ++n;
+
+        r = c_ini_index_reset(&group->index_entries, n);
+        if (r)
+                return;
+
+        c_list_for_each_entry(entry, &group->list_entries, link_group)
+                c_ini_index_add(&group->index_entries, entry->hash, entry);
+
+        group->indexed = true;
+}
+
 void c_ini_entry_link(CIniEntry *entry, CIniGroup *group) {
         CIniBytes bytes = C_INI_BYTES_INIT((uint8_t *)entry->key, entry->n_key);
         CRBNode **slot, *parent;
@@ -95,6 +192,8 @@ void c_ini_entry_link(CIniEntry *entry, CIniGroup *group) {
 
         c_assert(!entry->group);
 
+        entry->hash = c_ini_hash(entry->key, entry->n_key);
+
         slot = &group->map_entries.root;
         parent = NULL;
         while (*slot) {
@@ -108,14 +207,26 @@ void c_ini_entry_link(CIniEntry *entry, CIniGroup *group) {
 
         c_ini_entry_ref(entry);
         entry->group = group;
+        ++group->n_entries;
         c_list_link_tail(&group->list_entries, &entry->link_group);
         c_rbtree_add(&group->map_entries, parent, slot, &entry->rb_group);
+
+        if (group->indexed)
+                c_ini_group_index_add(group, entry);
+
+        c_ini_locale_link(entry, group);
 }
 
 void c_ini_entry_unlink(CIniEntry *entry) {
         if (entry->group) {
+                if (entry->group->indexed)
+                        c_ini_index_remove(&entry->group->index_entries, entry->hash, entry);
+
+                c_ini_locale_unlink(entry);
+
                 c_rbnode_unlink(&entry->rb_group);
                 c_list_unlink(&entry->link_group);
+                --entry->group->n_entries;
                 entry->group = NULL;
                 entry = c_ini_entry_unref(entry);
                 /* @entry might be gone here */
@@ -123,24 +234,32 @@ void c_ini_entry_unlink(CIniEntry *entry) {
 }
 
 _c_public_ CIniEntry *c_ini_entry_next(CIniEntry *entry) {
+        if (c_ini_is_frozen(entry))
+                return c_ini_frozen_entry_next(entry);
         if (!entry->group || entry->link_group.next == &entry->group->list_entries)
                 return NULL;
         return c_list_entry(entry->link_group.next, CIniEntry, link_group);
 }
 
 _c_public_ CIniEntry *c_ini_entry_previous(CIniEntry *entry) {
+        if (c_ini_is_frozen(entry))
+                return c_ini_frozen_entry_previous(entry);
         if (!entry->group || entry->link_group.prev == &entry->group->list_entries)
                 return NULL;
         return c_list_entry(entry->link_group.prev, CIniEntry, link_group);
 }
 
 _c_public_ const char *c_ini_entry_get_key(CIniEntry *entry, size_t *n_keyp) {
+        if (c_ini_is_frozen(entry))
+                return c_ini_frozen_entry_get_key(entry, n_keyp);
         if (n_keyp)
                 *n_keyp = entry->n_key;
         return (const char *)entry->key;
 }
 
 _c_public_ const char *c_ini_entry_get_value(CIniEntry *entry, size_t *n_valuep) {
+        if (c_ini_is_frozen(entry))
+                return c_ini_frozen_entry_get_value(entry, n_valuep);
         if (n_valuep)
                 *n_valuep = entry->n_value;
         return (const char *)entry->value;
@@ -158,36 +277,72 @@ static int c_ini_group_compare(CRBTree *t, void *k, CRBNode *rb) {
                 return memcmp(bytes->data, group->label, group->n_label);
 }
 
-int c_ini_group_new(CIniGroup **groupp, const uint8_t *label, size_t n_label) {
-        _c_cleanup_(c_ini_group_unrefp) CIniGroup *group = NULL;
-        _c_cleanup_(c_ini_freep) uint8_t *dup = NULL;
+int c_ini_group_new(CIniGroup **groupp, CIniArena *arena, const uint8_t *label, size_t n_label) {
+        CIniGroup *group;
+
+        /* see c_ini_entry_new() for details */
 
-        dup = calloc(1, n_label + 1);
-        if (!dup)
+        group = c_ini_arena_alloc(arena, sizeof(*group) + n_label + 1);
+        if (!group)
                 return -ENOMEM;
 
-        c_memcpy(dup, label, n_label);
+        *group = (CIniGroup)C_INI_GROUP_NULL(*group);
+        group->arena = c_ini_arena_ref(arena);
+        group->label = group->storage;
+        group->n_label = n_label;
+
+        c_memcpy(group->label, label, n_label);
+        group->label[n_label] = 0;
+
+        *groupp = group;
+        return 0;
+}
+
+int c_ini_group_new_borrowed(CIniGroup **groupp,
+                             CIniArena *arena,
+                             CIniRaw *raw,
+                             const uint8_t *label,
+                             size_t n_label) {
+        CIniGroup *group;
+
+        /* see c_ini_entry_new_borrowed() for details */
+
+        c_assert(label >= raw->data && label + n_label <= raw->data + raw->n_data);
 
-        group = calloc(1, sizeof(*group));
+        group = c_ini_arena_alloc(arena, sizeof(*group));
         if (!group)
                 return -ENOMEM;
 
         *group = (CIniGroup)C_INI_GROUP_NULL(*group);
-        group->label = dup;
-        dup = NULL;
+        group->arena = c_ini_arena_ref(arena);
+        group->raw = c_ini_raw_ref(raw);
+        group->label = (uint8_t *)label;
         group->n_label = n_label;
 
         *groupp = group;
-        group = NULL;
         return 0;
 }
 
 static CIniGroup *c_ini_group_free_internal(CIniGroup *group) {
         CIniEntry *entry, *t_entry;
+        CIniArena *arena;
 
         if (!group)
                 return NULL;
 
+        /*
+         * The entire tree is released, so there is no need to rebalance it
+         * for every entry. Reset all nodes upfront, so unlinking the entries
+         * only needs to drop them from the list.
+         */
+        c_list_for_each_entry(entry, &group->list_entries, link_group)
+                c_rbnode_init(&entry->rb_group);
+        c_rbtree_init(&group->map_entries);
+        c_ini_index_deinit(&group->index_entries);
+        c_ini_index_deinit(&group->index_locales);
+        group->indexed = false;
+        group->unindexed_locales = true;
+
         c_list_for_each_entry_safe(entry, t_entry, &group->list_entries, link_group)
                 c_ini_entry_unlink(entry);
 
@@ -195,24 +350,60 @@ static CIniGroup *c_ini_group_free_internal(CIniGroup *group) {
         c_assert(!c_rbnode_is_linked(&group->rb_domain));
         c_assert(!group->domain);
 
-        free(group->label);
-        free(group);
+        arena = group->arena;
+        c_ini_raw_unref(group->raw);
+        c_ini_arena_free(arena, group);
+        c_ini_arena_unref(arena);
 
         return NULL;
 }
 
 _c_public_ CIniGroup *c_ini_group_ref(CIniGroup *group) {
-        if (group)
-                ++group->n_refs;
+        if (group && c_ini_is_frozen(group))
+                c_ini_domain_ref(c_ini_frozen_group_get_domain(group));
+        else if (group)
+                c_ini_ref_inc(&group->n_refs);
         return group;
 }
 
 _c_public_ CIniGroup *c_ini_group_unref(CIniGroup *group) {
-        if (group && !--group->n_refs)
+        if (group && c_ini_is_frozen(group))
+                c_ini_domain_unref(c_ini_frozen_group_get_domain(group));
+        else if (group && c_ini_ref_dec(&group->n_refs))
                 c_ini_group_free_internal(group);
         return NULL;
 }
 
+static bool c_ini_group_match(const void *k, void *p) {
+        const CIniBytes *bytes = k;
+        CIniGroup *group = p;
+
+        return bytes->n_data == group->n_label &&
+               !memcmp(bytes->data, group->label, bytes->n_data);
+}
+
+static void c_ini_domain_index_add(CIniDomain *domain, CIniGroup *group) {
+        CIniGroup *iter;
+        int r;
+
+        /* see c_ini_group_index_add() */
+
+        if (!c_ini_index_is_full(&domain->index_groups)) {
+                c_ini_index_add(&domain->index_groups, group->hash, group);
+                return;
+        }
+
+        r = c_ini_index_reset(&domain->index_groups, domain->index_groups.n_live + 1);
+        if (r) {
+                c_ini_index_deinit(&domain->index_groups);
+                domain->indexed = false;
+                return;
+        }
+
+        c_list_for_each_entry(iter, &domain->list_groups, link_domain)
+                c_ini_index_add(&domain->index_groups, iter->hash, iter);
+}
+
 void c_ini_group_link(CIniGroup *group, CIniDomain *domain) {
         CIniBytes bytes = C_INI_BYTES_INIT((uint8_t *)group->label, group->n_label);
         CRBNode **slot, *parent;
@@ -220,6 +411,8 @@ void c_ini_group_link(CIniGroup *group, CIniDomain *domain) {
 
         c_assert(!group->domain);
 
+        group->hash = c_ini_hash(group->label, group->n_label);
+
         slot = &domain->map_groups.root;
         parent = NULL;
         while (*slot) {
@@ -235,10 +428,18 @@ void c_ini_group_link(CIniGroup *group, CIniDomain *domain) {
         group->domain = domain;
         c_list_link_tail(&domain->list_groups, &group->link_domain);
         c_rbtree_add(&domain->map_groups, parent, slot, &group->rb_domain);
+
+        if (domain->indexed) {
+                c_ini_domain_index_add(domain, group);
+                c_ini_group_enable_index(group);
+        }
 }
 
 void c_ini_group_unlink(CIniGroup *group) {
         if (group->domain) {
+                if (group->domain->indexed)
+                        c_ini_index_remove(&group->domain->index_groups, group->hash, group);
+
                 c_rbnode_unlink(&group->rb_domain);
                 c_list_unlink(&group->link_domain);
                 group->domain = NULL;
@@ -248,40 +449,42 @@ void c_ini_group_unlink(CIniGroup *group) {
 }
 
 _c_public_ CIniGroup *c_ini_group_next(CIniGroup *group) {
+        if (c_ini_is_frozen(group))
+                return c_ini_frozen_group_next(group);
         if (!group->domain || group->link_domain.next == &group->domain->list_groups)
                 return NULL;
         return c_list_entry(group->link_domain.next, CIniGroup, link_domain);
 }
 
 _c_public_ CIniGroup *c_ini_group_previous(CIniGroup *group) {
+        if (c_ini_is_frozen(group))
+                return c_ini_frozen_group_previous(group);
         if (!group->domain || group->link_domain.prev == &group->domain->list_groups)
                 return NULL;
         return c_list_entry(group->link_domain.prev, CIniGroup, link_domain);
 }
 
 _c_public_ const char *c_ini_group_get_label(CIniGroup *group, size_t *n_labelp) {
+        if (c_ini_is_frozen(group))
+                return c_ini_frozen_group_get_label(group, n_labelp);
         if (n_labelp)
                 *n_labelp = group->n_label;
         return (const char *)group->label;
 }
 
 _c_public_ CIniEntry *c_ini_group_iterate(CIniGroup *group) {
+        if (c_ini_is_frozen(group))
+                return c_ini_frozen_group_iterate(group);
         return c_list_first_entry(&group->list_entries, CIniEntry, link_group);
 }
 
-_c_public_ CIniEntry *c_ini_group_find(CIniGroup *group, const char *label, ssize_t n_label) {
-        CIniBytes bytes;
+static CIniEntry *c_ini_group_find_tree(CIniGroup *group, CIniBytes *bytes) {
         CRBNode *iter;
         int r;
 
-        if (n_label < 0)
-                n_label = strlen(label);
-
-        bytes = (CIniBytes)C_INI_BYTES_INIT((uint8_t *)label, n_label);
-
         iter = group->map_entries.root;
         while (iter) {
-                r = c_ini_entry_compare(&group->map_entries, &bytes, iter);
+                r = c_ini_entry_compare(&group->map_entries, bytes, iter);
                 if (r < 0)
                         iter = iter->left;
                 else if (r > 0)
@@ -298,48 +501,109 @@ _c_public_ CIniEntry *c_ini_group_find(CIniGroup *group, const char *label, ssiz
                  * duplicates.
                  */
                 while (iter->left &&
-                       !c_ini_entry_compare(&group->map_entries, &bytes, iter->left))
+                       !c_ini_entry_compare(&group->map_entries, bytes, iter->left))
                         iter = iter->left;
         }
 
         return c_rbnode_entry(iter, CIniEntry, rb_group);
 }
 
-int c_ini_raw_new(CIniRaw **rawp, const uint8_t *data, size_t n_data) {
-        _c_cleanup_(c_ini_raw_unrefp) CIniRaw *raw = NULL;
+_c_public_ CIniEntry *c_ini_group_find(CIniGroup *group, const char *label, ssize_t n_label) {
+        CIniBytes bytes;
+
+        if (n_label < 0)
+                n_label = strlen(label);
+
+        if (c_ini_is_frozen(group))
+                return c_ini_frozen_group_find(group, label, n_label);
+
+        bytes = (CIniBytes)C_INI_BYTES_INIT((uint8_t *)label, n_label);
+
+        if (group->indexed)
+                return c_ini_index_find(&group->index_entries,
+                                        c_ini_hash(bytes.data, bytes.n_data),
+                                        c_ini_entry_match,
+                                        &bytes);
+
+        return c_ini_group_find_tree(group, &bytes);
+}
+
+_c_public_ CIniEntry *c_ini_group_find_key(CIniGroup *group, const CIniKey *key) {
+        CIniBytes bytes;
+
+        if (c_ini_is_frozen(group))
+                return c_ini_frozen_group_find(group, key->data, key->n_data);
+
+        bytes = (CIniBytes)C_INI_BYTES_INIT((uint8_t *)key->data, key->n_data);
 
-        raw = calloc(1, sizeof(*raw) + n_data + 1);
+        if (group->indexed)
+                return c_ini_index_find(&group->index_entries, key->hash, c_ini_entry_match, &bytes);
+
+        return c_ini_group_find_tree(group, &bytes);
+}
+
+int c_ini_raw_new(CIniRaw **rawp, CIniArena *arena, const uint8_t *data, size_t n_data) {
+        CIniRaw *raw;
+
+        raw = c_ini_arena_alloc(arena, sizeof(*raw) + n_data + 1);
         if (!raw)
                 return -ENOMEM;
 
         *raw = (CIniRaw)C_INI_RAW_NULL(*raw);
+        raw->arena = c_ini_arena_ref(arena);
+        raw->data = raw->storage;
+        raw->n_data = n_data;
+        c_memcpy(raw->storage, data, n_data);
+        raw->storage[n_data] = 0;
+
+        *rawp = raw;
+        return 0;
+}
+
+int c_ini_raw_new_borrowed(CIniRaw **rawp, CIniArena *arena, const uint8_t *data, size_t n_data) {
+        CIniRaw *raw;
+
+        /*
+         * Borrowed raw lines reference the data of the caller. The caller
+         * guarantees that it stays valid for the lifetime of the raw line.
+         */
+
+        raw = c_ini_arena_alloc(arena, sizeof(*raw));
+        if (!raw)
+                return -ENOMEM;
+
+        *raw = (CIniRaw)C_INI_RAW_NULL(*raw);
+        raw->arena = c_ini_arena_ref(arena);
+        raw->data = data;
         raw->n_data = n_data;
-        c_memcpy(raw->data, data, n_data);
 
         *rawp = raw;
-        raw = NULL;
         return 0;
 }
 
 static CIniRaw *c_ini_raw_free_internal(CIniRaw *raw) {
+        CIniArena *arena;
+
         if (!raw)
                 return NULL;
 
         c_assert(!c_list_is_linked(&raw->link_domain));
 
-        free(raw);
+        arena = raw->arena;
+        c_ini_arena_free(arena, raw);
+        c_ini_arena_unref(arena);
 
         return NULL;
 }
 
 CIniRaw *c_ini_raw_ref(CIniRaw *raw) {
         if (raw)
-                ++raw->n_refs;
+                c_ini_ref_inc(&raw->n_refs);
         return raw;
 }
 
 CIniRaw *c_ini_raw_unref(CIniRaw *raw) {
-        if (raw && !--raw->n_refs)
+        if (raw && c_ini_ref_dec(&raw->n_refs))
                 c_ini_raw_free_internal(raw);
         return NULL;
 }
@@ -370,7 +634,11 @@ int c_ini_domain_new(CIniDomain **domainp) {
 
         *domain = (CIniDomain)C_INI_DOMAIN_NULL(*domain);
 
-        r = c_ini_group_new(&domain->null_group, NULL, 0);
+        r = c_ini_arena_new(&domain->arena);
+        if (r)
+                return r;
+
+        r = c_ini_group_new(&domain->null_group, domain->arena, NULL, 0);
         if (r)
                 return r;
 
@@ -379,6 +647,59 @@ int c_ini_domain_new(CIniDomain **domainp) {
         return 0;
 }
 
+int c_ini_domain_new_frozen(CIniDomain **domainp, CIniArena *arena, CIniFrozen *frozen) {
+        CIniDomain *domain;
+
+        /*
+         * Create a domain for the frozen block @frozen, which is owned by
+         * @arena. The domain takes a reference to @arena and sets the
+         * back-pointer of the block.
+         */
+
+        domain = calloc(1, sizeof(*domain));
+        if (!domain)
+                return -ENOMEM;
+
+        *domain = (CIniDomain)C_INI_DOMAIN_NULL(*domain);
+        domain->arena = c_ini_arena_ref(arena);
+        domain->frozen = frozen;
+        domain->null_group = c_ini_frozen_get_null_group(frozen);
+        frozen->domain = domain;
+
+        *domainp = domain;
+        return 0;
+}
+
+void c_ini_domain_enable_index(CIniDomain *domain) {
+        CIniGroup *group;
+        size_t n = 0;
+        int r;
+
+        /*
+         * Enable the hash index of the domain and of all its groups. Groups
+         * linked later on get their index enabled when linked. If an index
+         * cannot be allocated, lookups simply keep using the trees.
+         */
+
+        if (domain->indexed || domain->frozen)
+                return;
+
+        c_ini_group_enable_index(domain->null_group);
+        c_list_for_each_entry(group, &domain->list_groups, link_domain) {
+                c_ini_group_enable_index(group);
+                ++n;
+        }
+
+        r = c_ini_index_reset(&domain->index_groups, n);
+        if (r)
+                return;
+
+        c_list_for_each_entry(group, &domain->list_groups, link_domain)
+                c_ini_index_add(&domain->index_groups, group->hash, group);
+
+        domain->indexed = true;
+}
+
 static CIniDomain *c_ini_domain_free_internal(CIniDomain *domain) {
         CIniGroup *group, *t_group;
         CIniRaw *raw, *t_raw;
@@ -389,6 +710,13 @@ static CIniDomain *c_ini_domain_free_internal(CIniDomain *domain) {
         c_list_for_each_entry_safe(raw, t_raw, &domain->list_raws, link_domain)
                 c_ini_raw_unlink(raw);
 
+        /* see c_ini_group_free_internal() */
+        c_list_for_each_entry(group, &domain->list_groups, link_domain)
+                c_rbnode_init(&group->rb_domain);
+        c_rbtree_init(&domain->map_groups);
+        c_ini_index_deinit(&domain->index_groups);
+        domain->indexed = false;
+
         c_list_for_each_entry_safe(group, t_group, &domain->list_groups, link_domain)
                 c_ini_group_unlink(group);
 
@@ -396,7 +724,10 @@ static CIniDomain *c_ini_domain_free_internal(CIniDomain *domain) {
         c_assert(c_list_is_empty(&domain->list_groups));
         c_assert(c_rbtree_is_empty(&domain->map_groups));
 
-        c_ini_group_unref(domain->null_group);
+        /* the null group of a frozen domain is part of its block */
+        if (!domain->frozen)
+                c_ini_group_unref(domain->null_group);
+        c_ini_arena_unref(domain->arena);
         free(domain);
 
         return NULL;
@@ -404,12 +735,12 @@ static CIniDomain *c_ini_domain_free_internal(CIniDomain *domain) {
 
 _c_public_ CIniDomain *c_ini_domain_ref(CIniDomain *domain) {
         if (domain)
-                ++domain->n_refs;
+                c_ini_ref_inc(&domain->n_refs);
         return domain;
 }
 
 _c_public_ CIniDomain *c_ini_domain_unref(CIniDomain *domain) {
-        if (domain && !--domain->n_refs)
+        if (domain && c_ini_ref_dec(&domain->n_refs))
                 c_ini_domain_free_internal(domain);
         return NULL;
 }
@@ -419,22 +750,18 @@ _c_public_ CIniGroup *c_ini_domain_get_null_group(CIniDomain *domain) {
 }
 
 _c_public_ CIniGroup *c_ini_domain_iterate(CIniDomain *domain) {
+        if (domain->frozen)
+                return c_ini_frozen_iterate(domain->frozen);
         return c_list_first_entry(&domain->list_groups, CIniGroup, link_domain);
 }
 
-_c_public_ CIniGroup *c_ini_domain_find(CIniDomain *domain, const char *label, ssize_t n_label) {
-        CIniBytes bytes;
+static CIniGroup *c_ini_domain_find_tree(CIniDomain *domain, CIniBytes *bytes) {
         CRBNode *iter;
         int r;
 
-        if (n_label < 0)
-                n_label = strlen(label);
-
-        bytes = (CIniBytes)C_INI_BYTES_INIT((uint8_t *)label, n_label);
-
         iter = domain->map_groups.root;
         while (iter) {
-                r = c_ini_group_compare(&domain->map_groups, &bytes, iter);
+                r = c_ini_group_compare(&domain->map_groups, bytes, iter);
                 if (r < 0)
                         iter = iter->left;
                 else if (r > 0)
@@ -451,9 +778,57 @@ _c_public_ CIniGroup *c_ini_domain_find(CIniDomain *domain, const char *label, s
                  * duplicates.
                  */
                 while (iter->left &&
-                       !c_ini_group_compare(&domain->map_groups, &bytes, iter->left))
+                       !c_ini_group_compare(&domain->map_groups, bytes, iter->left))
                         iter = iter->left;
         }
 
         return c_rbnode_entry(iter, CIniGroup, rb_domain);
 }
+
+_c_public_ CIniGroup *c_ini_domain_find(CIniDomain *domain, const char *label, ssize_t n_label) {
+        CIniBytes bytes;
+
+        if (n_label < 0)
+                n_label = strlen(label);
+
+        if (domain->frozen)
+                return c_ini_frozen_find(domain->frozen, label, n_label);
+
+        bytes = (CIniBytes)C_INI_BYTES_INIT((uint8_t *)label, n_label);
+
+        if (domain->indexed)
+                return c_ini_index_find(&domain->index_groups,
+                                        c_ini_hash(bytes.data, bytes.n_data),
+                                        c_ini_group_match,
+                                        &bytes);
+
+        return c_ini_domain_find_tree(domain, &bytes);
+}
+
+_c_public_ CIniGroup *c_ini_domain_find_key(CIniDomain *domain, const CIniKey *key) {
+        CIniBytes bytes;
+
+        if (domain->frozen)
+                return c_ini_frozen_find(domain->frozen, key->data, key->n_data);
+
+        bytes = (CIniBytes)C_INI_BYTES_INIT((uint8_t *)key->data, key->n_data);
+
+        if (domain->indexed)
+                return c_ini_index_find(&domain->index_groups, key->hash, c_ini_group_match, &bytes);
+
+        return c_ini_domain_find_tree(domain, &bytes);
+}
+
+_c_public_ void c_ini_key_init(CIniKey *key, const char *data, ssize_t n_data) {
+        /*
+         * Prepare @data for repeated lookups. The key references @data, so
+         * the caller must keep it valid for as long as the key is used.
+         */
+        if (n_data < 0)
+                n_data = strlen(data);
+
+        *key = (CIniKey)C_INI_KEY_NULL(*key);
+        key->data = data;
+        key->n_data = n_data;
+        key->hash = c_ini_hash((const uint8_t *)data, n_data);
+}
@@ -47,17 +47,30 @@
  *          which must only contain alphanumeric codepoints, as well as '@',
  *          '.', '_', '-'.
  *
- *  * The current parsers assume the data source is trusted. Meaning, while it
- *    does correctly verify validity of all content, it does not enforce limits
- *    on data lengths in any way. If the data source is not trusted, you would
- *    want to extend the parsers to refuse files with overlong entities, or
- *    overlong extents.
+ *  * By default, the parsers assume the data source is trusted. Meaning, while
+ *    they do correctly verify validity of all content, they do not enforce
+ *    limits on data lengths in any way. If the data source is not trusted,
+ *    limits can be set on a reader via c_ini_reader_set_limits(). They are
+ *    checked as input is fed, before anything is allocated for it, and
+ *    violations fail with C_INI_E_LIMIT.
  *
- *  * For now the API does not include serializers / writers, but was written
- *    to allow for seamless addition of such calls. Ini-Files are
- *    human-readable files, and as such there rarely is the need to write them
- *    programmatically. If the need ever arises, we will have to extent the API
- *    to provide serializers and modifiers.
+ *  * Sealed domains are never modified. Hence, lookups and iterations on a
+ *    sealed domain, its groups, and its entries are safe from any number of
+ *    threads at the same time, as long as the domain is kept alive. This
+ *    covers all functions of this API that neither acquire nor release
+ *    references. Reference counters are not atomic by default, though, so
+ *    references must only be acquired and released from one thread at a
+ *    time. If built with the `atomic-refs` option, references can be
+ *    acquired and released from any thread, and any thread can drop the last
+ *    reference. Note that only the domain keeps its objects linked, so a
+ *    thread that navigates between groups and entries must hold a reference
+ *    to the domain, not just to the object it starts from.
+ *
+ *  * Domains can be written back via c_ini_domain_write() and friends. Since
+ *    domains retain all their source lines verbatim, including comments and
+ *    malformed lines, the output reproduces the input exactly. For now the API
+ *    does not include modifiers, but was written to allow for seamless
+ *    addition of such calls.
  */
 
 #ifdef __cplusplus
@@ -65,13 +78,38 @@ extern "C" {
 #endif
 
 #include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <sys/types.h>
 
+typedef struct CIniCallbacks CIniCallbacks;
 typedef struct CIniDomain CIniDomain;
 typedef struct CIniEntry CIniEntry;
 typedef struct CIniGroup CIniGroup;
+typedef struct CIniKey CIniKey;
+typedef struct CIniLimits CIniLimits;
+typedef struct CIniList CIniList;
 typedef struct CIniReader CIniReader;
+typedef struct CIniSnapshot CIniSnapshot;
+typedef struct CIniSpan CIniSpan;
+typedef struct CIniToken CIniToken;
+typedef struct CIniTokenizer CIniTokenizer;
+typedef struct CIniWatch CIniWatch;
+
+typedef int (*CIniDiffFn) (unsigned int event,
+                           CIniGroup *old_group,
+                           CIniEntry *old_entry,
+                           CIniGroup *new_group,
+                           CIniEntry *new_entry,
+                           void *userdata);
+
+enum {
+        _C_INI_E_SUCCESS,
+
+        C_INI_E_LIMIT,
+        C_INI_E_CALLBACK,
+};
 
 enum {
         C_INI_MODE_EXTENDED_WHITESPACE                          = (1 <<  0),
@@ -79,8 +117,163 @@ enum {
         C_INI_MODE_MERGE_GROUPS                                 = (1 <<  2),
         C_INI_MODE_KEEP_DUPLICATE_ENTRIES                       = (1 <<  3),
         C_INI_MODE_OVERRIDE_ENTRIES                             = (1 <<  4),
+        /*
+         * Reference the data passed to c_ini_reader_feed() rather than
+         * copying it. The caller must keep the data valid and unmodified for
+         * as long as the resulting domain, or any object retrieved from it, is
+         * alive. Lines spanning multiple calls to c_ini_reader_feed() are
+         * still copied. Note that keys, values, and labels are not
+         * zero-terminated in this mode. Regular files fed via
+         * c_ini_reader_feed_fd(), c_ini_reader_feed_path(), or as drop-ins
+         * stay mapped for as long as the domain is alive, and accessing it
+         * raises SIGBUS if a file is truncated meanwhile. Do not borrow from
+         * files that might be rewritten in place.
+         */
+        C_INI_MODE_BORROW_DATA                                  = (1 <<  5),
+        /*
+         * Maintain a hash index for groups and entries in addition to the
+         * lookup trees. This speeds up lookups on large domains at the cost
+         * of additional memory.
+         */
+        C_INI_MODE_HASH_INDEX                                   = (1 <<  6),
 };
 
+/*
+ * List iterators are allocated by the caller, but their members are private.
+ * Initialize them via c_ini_list_init().
+ */
+struct CIniList {
+        const char *data;
+        size_t n_data;
+        char *buffer;
+        size_t z_buffer;
+};
+
+#define C_INI_LIST_NULL(_x) {                                                   \
+        }
+
+/*
+ * Prepared keys are allocated by the caller, but their members are private.
+ * Initialize them via c_ini_key_init(), and pass them to the `*_find_key()`
+ * lookups to avoid measuring and hashing the same key over and over again.
+ */
+struct CIniKey {
+        const char *data;
+        size_t n_data;
+        uint64_t hash;
+};
+
+#define C_INI_KEY_NULL(_x) {                                                    \
+        }
+
+/*
+ * Limits bound the resources a reader spends on its input. Lengths are in
+ * bytes, and @max_line includes the line break. Groups are counted per group
+ * header. Entries are counted per group they are linked into, so merged
+ * groups are bounded as a whole: an entry fails if its group holds
+ * @max_entries entries already, unless it replaces or duplicates an entry of
+ * the group and thus does not grow it. With callbacks, no groups are built,
+ * and every entry is counted per group header instead. @max_bytes bounds the
+ * total size of all lines of a parsing round. A limit of 0 means unlimited.
+ */
+struct CIniLimits {
+        size_t max_line;
+        size_t max_label;
+        size_t max_key;
+        size_t max_value;
+        size_t max_groups;
+        size_t max_entries;
+        size_t max_bytes;
+};
+
+#define C_INI_LIMITS_NULL(_x) {                                                 \
+        }
+
+/*
+ * Callbacks make a reader report each line as it is parsed, rather than
+ * building a domain. All spans point into the input, are not zero-terminated,
+ * and are only valid during the callback. Any callback can be NULL. A
+ * callback returns 0 to continue, or a negative error code to abort parsing,
+ * which is then returned as is. Positive values are reserved for the
+ * C_INI_E_* codes of the library, so a callback that returns one aborts
+ * parsing with C_INI_E_CALLBACK instead.
+ */
+struct CIniCallbacks {
+        int (*group) (const char *label, size_t n_label, void *userdata);
+        int (*entry) (const char *key, size_t n_key, const char *value, size_t n_value, void *userdata);
+        int (*comment) (const char *comment, size_t n_comment, void *userdata);
+        int (*malformed) (const char *line, size_t n_line, void *userdata);
+};
+
+enum {
+        C_INI_TOKEN_BLANK,
+        C_INI_TOKEN_COMMENT,
+        C_INI_TOKEN_GROUP,
+        C_INI_TOKEN_ENTRY,
+        C_INI_TOKEN_MALFORMED,
+};
+
+/*
+ * Tokens describe a single line of the input of a tokenizer. @i_line and
+ * @n_line locate the entire line, including its line break. Group labels are
+ * reported as @key, comments as @value. All spans point into the input and are
+ * not zero-terminated.
+ */
+struct CIniToken {
+        unsigned int type;
+        size_t i_line;
+        size_t n_line;
+        const char *key;
+        size_t n_key;
+        const char *value;
+        size_t n_value;
+};
+
+#define C_INI_TOKEN_NULL(_x) {                                                  \
+                .type = C_INI_TOKEN_BLANK,                                      \
+        }
+
+/*
+ * Tokenizers are allocated by the caller, but their members are private.
+ * Initialize them via c_ini_tokenizer_init().
+ */
+struct CIniTokenizer {
+        const char *data;
+        size_t n_data;
+        size_t i_data;
+        unsigned int mode;
+        unsigned int scanner;
+};
+
+#define C_INI_TOKENIZER_NULL(_x) {                                              \
+        }
+
+/*
+ * Spans reference keys for batch lookups via c_ini_group_find_many(). The
+ * data does not need to be zero-terminated.
+ */
+struct CIniSpan {
+        const char *data;
+        size_t n_data;
+};
+
+#define C_INI_SPAN_INIT(_data, _n_data) {                                       \
+                .data = (_data),                                                \
+                .n_data = (_n_data),                                            \
+        }
+
+enum {
+        C_INI_DIFF_GROUP_ADDED,
+        C_INI_DIFF_GROUP_REMOVED,
+        C_INI_DIFF_ENTRY_ADDED,
+        C_INI_DIFF_ENTRY_REMOVED,
+        C_INI_DIFF_ENTRY_CHANGED,
+};
+
+/* keys */
+
+void c_ini_key_init(CIniKey *key, const char *data, ssize_t n_data);
+
 /* entries */
 
 CIniEntry *c_ini_entry_ref(CIniEntry *entry);
@@ -90,6 +283,24 @@ CIniEntry *c_ini_entry_next(CIniEntry *entry);
 CIniEntry *c_ini_entry_previous(CIniEntry *entry);
 const char *c_ini_entry_get_key(CIniEntry *entry, size_t *n_keyp);
 const char *c_ini_entry_get_value(CIniEntry *entry, size_t *n_valuep);
+int c_ini_entry_get_string(CIniEntry *entry, const char **stringp, size_t *n_stringp);
+
+int c_ini_entry_get_bool(CIniEntry *entry, bool *valuep);
+int c_ini_entry_get_int64(CIniEntry *entry, int64_t *valuep);
+int c_ini_entry_get_uint64(CIniEntry *entry, uint64_t *valuep);
+int c_ini_entry_get_double(CIniEntry *entry, double *valuep);
+int c_ini_entry_get_size(CIniEntry *entry, uint64_t *valuep);
+
+/* lists */
+
+void c_ini_list_init(CIniList *list, CIniEntry *entry);
+void c_ini_list_deinit(CIniList *list);
+int c_ini_list_next(CIniList *list, const char **elementp, size_t *n_elementp);
+
+/* tokenizers */
+
+void c_ini_tokenizer_init(CIniTokenizer *tokenizer, const char *data, size_t n_data, unsigned int mode);
+int c_ini_tokenizer_next(CIniTokenizer *tokenizer, CIniToken *token);
 
 /* groups */
 
@@ -102,6 +313,9 @@ const char *c_ini_group_get_label(CIniGroup *group, size_t *n_groupp);
 
 CIniEntry *c_ini_group_iterate(CIniGroup *group);
 CIniEntry *c_ini_group_find(CIniGroup *group, const char *label, ssize_t n_label);
+CIniEntry *c_ini_group_find_locale(CIniGroup *group, const char *label, ssize_t n_label, const char *locale);
+CIniEntry *c_ini_group_find_key(CIniGroup *group, const CIniKey *key);
+int c_ini_group_find_many(CIniGroup *group, const CIniSpan *keys, size_t n_keys, CIniEntry **entries);
 
 /* domains */
 
@@ -112,6 +326,17 @@ CIniGroup *c_ini_domain_get_null_group(CIniDomain *domain);
 
 CIniGroup *c_ini_domain_iterate(CIniDomain *domain);
 CIniGroup *c_ini_domain_find(CIniDomain *domain, const char *label, ssize_t n_label);
+CIniGroup *c_ini_domain_find_key(CIniDomain *domain, const CIniKey *key);
+
+int c_ini_domain_freeze(CIniDomain *domain, CIniDomain **frozenp);
+int c_ini_domain_write_cache(CIniDomain *domain, const char *path, const char * const *sources);
+int c_ini_domain_load_cache(CIniDomain **domainp, const char *path, const char * const *sources);
+
+int c_ini_domain_diff(CIniDomain *old_domain, CIniDomain *new_domain, CIniDiffFn fn, void *userdata);
+
+int c_ini_domain_write(CIniDomain *domain, char **datap, size_t *n_datap);
+int c_ini_domain_write_file(CIniDomain *domain, FILE *f);
+int c_ini_domain_write_fd(CIniDomain *domain, int fd);
 
 /* readers */
 
@@ -120,10 +345,30 @@ CIniReader *c_ini_reader_free(CIniReader *reader);
 
 void c_ini_reader_set_mode(CIniReader *reader, unsigned int mode);
 unsigned int c_ini_reader_get_mode(CIniReader *reader);
+void c_ini_reader_set_callbacks(CIniReader *reader, const CIniCallbacks *callbacks, void *userdata);
+void c_ini_reader_set_limits(CIniReader *reader, const CIniLimits *limits);
 
 int c_ini_reader_feed(CIniReader *reader, const uint8_t *data, size_t n_data);
+int c_ini_reader_feed_fd(CIniReader *reader, int fd);
+int c_ini_reader_feed_path(CIniReader *reader, const char *path);
+int c_ini_reader_feed_parallel(CIniReader *reader, const uint8_t *data, size_t n_data, unsigned int n_threads);
+int c_ini_reader_feed_dropins(CIniReader *reader, const char * const *dirs, const char *name, unsigned int n_threads);
+void c_ini_reader_reuse(CIniReader *reader, CIniDomain *previous);
 int c_ini_reader_seal(CIniReader *reader, CIniDomain **domainp);
 
+/* watches */
+
+int c_ini_watch_new(CIniWatch **watchp, unsigned int mode, const char * const *paths);
+CIniWatch *c_ini_watch_free(CIniWatch *watch);
+
+int c_ini_watch_get_fd(CIniWatch *watch);
+int c_ini_watch_dispatch(CIniWatch *watch);
+int c_ini_watch_reload(CIniWatch *watch);
+
+CIniSnapshot *c_ini_watch_acquire(CIniWatch *watch);
+CIniSnapshot *c_ini_snapshot_release(CIniSnapshot *snapshot);
+CIniDomain *c_ini_snapshot_get_domain(CIniSnapshot *snapshot);
+
 /* inline helpers */
 
 static inline void c_ini_entry_unrefp(CIniEntry **entry) {
@@ -146,6 +391,16 @@ static inline void c_ini_reader_freep(CIniReader **reader) {
                 c_ini_reader_free(*reader);
 }
 
+static inline void c_ini_watch_freep(CIniWatch **watch) {
+        if (*watch)
+                c_ini_watch_free(*watch);
+}
+
+static inline void c_ini_snapshot_releasep(CIniSnapshot **snapshot) {
+        if (*snapshot)
+                c_ini_snapshot_release(*snapshot);
+}
+
 #ifdef __cplusplus
 }
 #endif
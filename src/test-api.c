@@ -6,6 +6,7 @@
 
 #undef NDEBUG
 #include <assert.h>
+#include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -13,9 +14,19 @@
 
 #define _cleanup_(_x) __attribute__((__cleanup__(_x)))
 
+static int test_api_diff(unsigned int event,
+                         CIniGroup *old_group,
+                         CIniEntry *old_entry,
+                         CIniGroup *new_group,
+                         CIniEntry *new_entry,
+                         void *userdata) {
+        return 0;
+}
+
 static void test_api(void) {
         _cleanup_(c_ini_reader_freep) CIniReader *reader = NULL;
         _cleanup_(c_ini_domain_unrefp) CIniDomain *domain = NULL;
+        _cleanup_(c_ini_domain_unrefp) CIniDomain *frozen = NULL;
         _cleanup_(c_ini_group_unrefp) CIniGroup *group = NULL;
         _cleanup_(c_ini_entry_unrefp) CIniEntry *entry = NULL;
         int r;
@@ -29,18 +40,50 @@ static void test_api(void) {
                C_INI_MODE_KEEP_DUPLICATE_GROUPS |
                C_INI_MODE_MERGE_GROUPS |
                C_INI_MODE_KEEP_DUPLICATE_ENTRIES |
-               C_INI_MODE_OVERRIDE_ENTRIES);
+               C_INI_MODE_OVERRIDE_ENTRIES |
+               C_INI_MODE_BORROW_DATA |
+               C_INI_MODE_HASH_INDEX);
         c_ini_reader_set_mode(reader, 0);
         c_ini_reader_get_mode(reader);
+        c_ini_reader_set_callbacks(reader, &(CIniCallbacks){}, NULL);
+        c_ini_reader_set_callbacks(reader, NULL, NULL);
+        c_ini_reader_set_limits(reader, &(CIniLimits){ .max_line = 4096 });
+        c_ini_reader_set_limits(reader, NULL);
 
         r = c_ini_reader_feed(reader, (const uint8_t *)"x=y", 3);
         assert(!r);
 
+        r = c_ini_reader_feed_parallel(reader, (const uint8_t *)"\n", 1, 0);
+        assert(!r);
+
+        r = c_ini_reader_feed_dropins(reader, (const char *[]){ NULL }, "foo.conf", 0);
+        assert(!r);
+
+        r = c_ini_reader_feed_path(reader, "/dev/null");
+        assert(!r);
+
+        r = c_ini_reader_feed_fd(reader, -1);
+        assert(r < 0);
+
+        c_ini_reader_reuse(reader, NULL);
+
         r = c_ini_reader_seal(reader, &domain);
         assert(!r);
 
         reader = c_ini_reader_free(reader);
 
+        /* tokenizers */
+
+        {
+                CIniTokenizer tokenizer = C_INI_TOKENIZER_NULL(tokenizer);
+                CIniToken token = C_INI_TOKEN_NULL(token);
+
+                c_ini_tokenizer_init(&tokenizer, "x=y", 3, 0);
+                assert(c_ini_tokenizer_next(&tokenizer, &token) == 1);
+                assert(token.type == C_INI_TOKEN_ENTRY);
+                assert(!c_ini_tokenizer_next(&tokenizer, &token));
+        }
+
         /* domains */
 
         c_ini_domain_unref(c_ini_domain_ref(domain));
@@ -48,6 +91,65 @@ static void test_api(void) {
         assert(!c_ini_domain_iterate(domain));
         assert(!c_ini_domain_find(domain, "foobar", -1));
 
+        {
+                CIniKey key = C_INI_KEY_NULL(key);
+
+                c_ini_key_init(&key, "foobar", -1);
+                assert(!c_ini_domain_find_key(domain, &key));
+        }
+
+        r = c_ini_domain_freeze(domain, &frozen);
+        assert(!r);
+        r = c_ini_domain_diff(domain, frozen, test_api_diff, NULL);
+        assert(!r);
+        frozen = c_ini_domain_unref(frozen);
+
+        r = c_ini_domain_write_cache(domain, "/dev/null/cache", NULL);
+        assert(r < 0);
+        r = c_ini_domain_load_cache(&frozen, "/dev/null", NULL);
+        assert(r < 0);
+
+        {
+                char *data;
+                size_t n;
+                FILE *f;
+
+                r = c_ini_domain_write(domain, &data, &n);
+                assert(!r);
+                free(data);
+
+                f = fopen("/dev/null", "we");
+                assert(f);
+                r = c_ini_domain_write_file(domain, f);
+                assert(!r);
+                fclose(f);
+
+                r = c_ini_domain_write_fd(domain, -1);
+                assert(r < 0);
+        }
+
+        /* watches */
+
+        {
+                _cleanup_(c_ini_watch_freep) CIniWatch *watch = NULL;
+                _cleanup_(c_ini_snapshot_releasep) CIniSnapshot *snapshot = NULL;
+
+                r = c_ini_watch_new(&watch, 0, (const char *[]){ "/dev/null", NULL });
+                assert(!r);
+                assert(c_ini_watch_get_fd(watch) >= 0);
+
+                r = c_ini_watch_dispatch(watch);
+                assert(r >= 0);
+                r = c_ini_watch_reload(watch);
+                assert(!r);
+
+                snapshot = c_ini_watch_acquire(watch);
+                assert(c_ini_snapshot_get_domain(snapshot));
+                snapshot = c_ini_snapshot_release(snapshot);
+
+                watch = c_ini_watch_free(watch);
+        }
+
         group = c_ini_group_ref(c_ini_domain_get_null_group(domain));
 
         domain = c_ini_domain_unref(domain);
@@ -62,6 +164,22 @@ static void test_api(void) {
         assert(c_ini_group_iterate(group));
 
         entry = c_ini_entry_ref(c_ini_group_find(group, "x", -1));
+        assert(c_ini_group_find_locale(group, "x", -1, "de_DE") == entry);
+
+        {
+                CIniKey key = C_INI_KEY_NULL(key);
+
+                c_ini_key_init(&key, "x", -1);
+                assert(c_ini_group_find_key(group, &key) == entry);
+        }
+
+        {
+                CIniSpan keys[] = { C_INI_SPAN_INIT("y", 1), C_INI_SPAN_INIT("x", 1) };
+                CIniEntry *entries[2];
+
+                assert(!c_ini_group_find_many(group, keys, 2, entries));
+                assert(!entries[0] && entries[1] == entry);
+        }
 
         group = c_ini_group_unref(group);
 
@@ -74,6 +192,31 @@ static void test_api(void) {
         assert(c_ini_entry_get_key(entry, NULL));
         assert(c_ini_entry_get_value(entry, NULL));
 
+        {
+                const char *s;
+                uint64_t u;
+                int64_t i;
+                double d;
+                bool b;
+
+                assert(!c_ini_entry_get_string(entry, &s, NULL));
+                assert(c_ini_entry_get_bool(entry, &b) == -EINVAL);
+                assert(c_ini_entry_get_int64(entry, &i) == -EINVAL);
+                assert(c_ini_entry_get_uint64(entry, &u) == -EINVAL);
+                assert(c_ini_entry_get_double(entry, &d) == -EINVAL);
+                assert(c_ini_entry_get_size(entry, &u) == -EINVAL);
+        }
+
+        {
+                _cleanup_(c_ini_list_deinit) CIniList list = C_INI_LIST_NULL(list);
+                const char *element;
+                size_t n;
+
+                c_ini_list_init(&list, entry);
+                assert(c_ini_list_next(&list, &element, &n) == 1);
+                assert(!c_ini_list_next(&list, &element, &n));
+        }
+
         entry = c_ini_entry_unref(entry);
 }
 
@@ -7,6 +7,7 @@
 #undef NDEBUG
 #include <assert.h>
 #include <c-stdaux.h>
+#include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -143,7 +144,504 @@ static void test_basic_reader(void) {
         c_assert(i == 2);
 }
 
+static void test_basic_arena(void) {
+        _c_cleanup_(c_ini_arena_unrefp) CIniArena *arena = NULL;
+        uint8_t *p, *big;
+        size_t i, j;
+        int r;
+
+        r = c_ini_arena_new(&arena);
+        c_assert(!r);
+
+        /* allocations must be zeroed, aligned, and must not overlap */
+
+        for (i = 1; i < 1024; ++i) {
+                p = c_ini_arena_alloc(arena, i);
+                c_assert(p);
+                c_assert(!((uintptr_t)p % _Alignof(max_align_t)));
+
+                for (j = 0; j < i; ++j)
+                        c_assert(!p[j]);
+
+                c_memset(p, 0xff, i);
+        }
+
+        /* oversized allocations must not waste the current block */
+
+        p = c_ini_arena_alloc(arena, 1);
+        c_assert(p);
+        big = c_ini_arena_alloc(arena, C_INI_ARENA_BLOCK_MAX * 2);
+        c_assert(big);
+        c_memset(big, 0xff, C_INI_ARENA_BLOCK_MAX * 2);
+        c_assert(c_ini_arena_alloc(arena, 1) == p + _Alignof(max_align_t));
+
+        /* objects pin the arena */
+
+        {
+                _c_cleanup_(c_ini_entry_unrefp) CIniEntry *entry = NULL;
+
+                r = c_ini_entry_new(&entry,
+                                    arena,
+                                    (const uint8_t *)"key",
+                                    3,
+                                    (const uint8_t *)"value",
+                                    5);
+                c_assert(!r);
+
+                arena = c_ini_arena_unref(arena);
+
+                c_assert(!strcmp(c_ini_entry_get_key(entry, NULL), "key"));
+                c_assert(!strcmp(c_ini_entry_get_value(entry, NULL), "value"));
+        }
+}
+
+static void test_basic_scan(void) {
+        static const uint8_t alphabet[] = { 'x', ' ', '\n', '=', ']', '[' };
+        unsigned int scanner, n_scanners = c_ini_scan_detect() + 1;
+        uint8_t data[256];
+        const uint8_t *p;
+        CIniScanFn scan;
+        CIniScan result;
+        size_t i, j, n, n_line;
+
+        /*
+         * Verify all scanners supported by the machine against memchr(3) on
+         * random data of all lengths, so all vector boundaries and tail paths
+         * are covered.
+         */
+
+        for (scanner = 0; scanner < n_scanners; ++scanner) {
+                scan = c_ini_scan_select(scanner);
+
+                /* empty lines might come without buffer */
+                scan(NULL, 0, &result);
+                c_assert(result.i_newline == 0);
+                c_assert(result.i_assignment == SIZE_MAX);
+                c_assert(result.i_bracket == SIZE_MAX);
+
+                srand(0xc1c1);
+
+                for (i = 0; i < 4096; ++i) {
+                        n = rand() % sizeof(data);
+                        for (j = 0; j < n; ++j)
+                                data[j] = rand() % 16 ? alphabet[rand() % 2] : alphabet[rand() % sizeof(alphabet)];
+
+                        scan(data, n, &result);
+
+                        p = memchr(data, '\n', n);
+                        n_line = p ? (size_t)(p - data) : n;
+                        c_assert(result.i_newline == n_line);
+
+                        p = memchr(data, '=', n_line);
+                        c_assert(result.i_assignment == (p ? (size_t)(p - data) : SIZE_MAX));
+
+                        p = memchr(data, ']', n_line);
+                        c_assert(result.i_bracket == (p ? (size_t)(p - data) : SIZE_MAX));
+                }
+        }
+}
+
+static bool test_basic_double_equal(double a, double b) {
+        /* the tested values are exact, but avoid -Wfloat-equal */
+        return !(a < b) && !(a > b);
+}
+
+static void test_basic_values(void) {
+        static const char input[] = "b_true=true\n"
+                                    "b_false=false\n"
+                                    "b_one=1  \n"
+                                    "b_zero=0\n"
+                                    "b_invalid=True\n"
+                                    "i_min=-9223372036854775808\n"
+                                    "i_max=+9223372036854775807\n"
+                                    "i_under=-9223372036854775809\n"
+                                    "u_max=18446744073709551615\n"
+                                    "u_over=18446744073709551616\n"
+                                    "u_negative=-1\n"
+                                    "n_junk=12x\n"
+                                    "n_empty=\n"
+                                    "d_pi=3.25\n"
+                                    "d_exp=-1e3\n"
+                                    "d_huge=1e999\n"
+                                    "s_plain=512\n"
+                                    "s_bytes=512B\n"
+                                    "s_kib=4K\n"
+                                    "s_mib=16MiB\n"
+                                    "s_over=16E\n"
+                                    "s_unit=4X\n";
+        _c_cleanup_(c_ini_domain_unrefp) CIniDomain *domain = NULL;
+        _c_cleanup_(c_ini_domain_unrefp) CIniDomain *frozen = NULL;
+        CIniDomain *domains[2];
+        CIniGroup *group;
+        uint64_t u;
+        int64_t i;
+        size_t k, round;
+        double d;
+        bool b;
+        int r;
+
+        r = c_ini_reader_parse(&domain, 0, (const uint8_t *)input, strlen(input));
+        c_assert(!r);
+        r = c_ini_domain_freeze(domain, &frozen);
+        c_assert(!r);
+
+        domains[0] = domain;
+        domains[1] = frozen;
+
+        /* frozen entries parse on each access, so they must agree */
+        for (k = 0; k < 2; ++k) {
+                group = c_ini_domain_get_null_group(domains[k]);
+
+                /* query everything twice, the second access hits the cache */
+                for (round = 0; round < 2; ++round) {
+                        c_assert(!c_ini_entry_get_bool(c_ini_group_find(group, "b_true", -1), &b) && b);
+                        c_assert(!c_ini_entry_get_bool(c_ini_group_find(group, "b_false", -1), &b) && !b);
+                        c_assert(!c_ini_entry_get_bool(c_ini_group_find(group, "b_one", -1), &b) && b);
+                        c_assert(!c_ini_entry_get_bool(c_ini_group_find(group, "b_zero", -1), &b) && !b);
+                        c_assert(c_ini_entry_get_bool(c_ini_group_find(group, "b_invalid", -1), &b) == -EINVAL);
+
+                        c_assert(!c_ini_entry_get_int64(c_ini_group_find(group, "i_min", -1), &i) && i == INT64_MIN);
+                        c_assert(!c_ini_entry_get_int64(c_ini_group_find(group, "i_max", -1), &i) && i == INT64_MAX);
+                        c_assert(c_ini_entry_get_int64(c_ini_group_find(group, "i_under", -1), &i) == -ERANGE);
+
+                        c_assert(!c_ini_entry_get_uint64(c_ini_group_find(group, "u_max", -1), &u) && u == UINT64_MAX);
+                        c_assert(c_ini_entry_get_uint64(c_ini_group_find(group, "u_over", -1), &u) == -ERANGE);
+                        c_assert(c_ini_entry_get_uint64(c_ini_group_find(group, "u_negative", -1), &u) == -EINVAL);
+                        c_assert(c_ini_entry_get_uint64(c_ini_group_find(group, "n_junk", -1), &u) == -EINVAL);
+                        c_assert(c_ini_entry_get_int64(c_ini_group_find(group, "n_empty", -1), &i) == -EINVAL);
+
+                        c_assert(!c_ini_entry_get_double(c_ini_group_find(group, "d_pi", -1), &d) && test_basic_double_equal(d, 3.25));
+                        c_assert(!c_ini_entry_get_double(c_ini_group_find(group, "d_exp", -1), &d) && test_basic_double_equal(d, -1000));
+                        c_assert(c_ini_entry_get_double(c_ini_group_find(group, "d_huge", -1), &d) == -ERANGE);
+                        c_assert(c_ini_entry_get_double(c_ini_group_find(group, "n_junk", -1), &d) == -EINVAL);
+
+                        c_assert(!c_ini_entry_get_size(c_ini_group_find(group, "s_plain", -1), &u) && u == 512);
+                        c_assert(!c_ini_entry_get_size(c_ini_group_find(group, "s_bytes", -1), &u) && u == 512);
+                        c_assert(!c_ini_entry_get_size(c_ini_group_find(group, "s_kib", -1), &u) && u == 4096);
+                        c_assert(!c_ini_entry_get_size(c_ini_group_find(group, "s_mib", -1), &u) && u == 16ULL << 20);
+                        c_assert(c_ini_entry_get_size(c_ini_group_find(group, "s_over", -1), &u) == -ERANGE);
+                        c_assert(c_ini_entry_get_size(c_ini_group_find(group, "s_unit", -1), &u) == -EINVAL);
+
+                        /* other types than the cached one are still parsed */
+                        c_assert(!c_ini_entry_get_int64(c_ini_group_find(group, "b_one", -1), &i) && i == 1);
+                        c_assert(!c_ini_entry_get_double(c_ini_group_find(group, "s_plain", -1), &d) && test_basic_double_equal(d, 512));
+                        c_assert(!c_ini_entry_get_int64(c_ini_group_find(group, "u_negative", -1), &i) && i == -1);
+                }
+        }
+
+        /* the first requested type is cached, including errors */
+        group = c_ini_domain_get_null_group(domain);
+        c_assert(c_ini_group_find(group, "b_true", -1)->cache_type == C_INI_VALUE_BOOL);
+        c_assert(c_ini_group_find(group, "s_plain", -1)->cache_type == C_INI_VALUE_SIZE);
+        c_assert(c_ini_group_find(group, "u_negative", -1)->cache_type == C_INI_VALUE_UINT64);
+        c_assert(c_ini_group_find(group, "u_negative", -1)->cache.r == -EINVAL);
+}
+
+static void test_basic_list_assert(CIniGroup *group, const char *key, const char * const *expected) {
+        _c_cleanup_(c_ini_list_deinit) CIniList list = C_INI_LIST_NULL(list);
+        const char *element;
+        size_t i, n;
+        int r;
+
+        c_ini_list_init(&list, c_ini_group_find(group, key, -1));
+
+        for (i = 0; expected[i]; ++i) {
+                r = c_ini_list_next(&list, &element, &n);
+                c_assert(r == 1);
+                c_assert(n == strlen(expected[i]) && !memcmp(element, expected[i], n));
+        }
+
+        c_assert(!c_ini_list_next(&list, &element, &n));
+        c_assert(!c_ini_list_next(&list, &element, &n));
+}
+
+static void test_basic_list(void) {
+        static const char input[] = "empty=\n"
+                                    "single=a\n"
+                                    "plain=text/plain;text/html;\n"
+                                    "unterminated=a;b\n"
+                                    "blanks=;a;;b;\n"
+                                    "escaped=a\\;b;c\\\\;d\\s\\t\\x;\\\n";
+        _c_cleanup_(c_ini_domain_unrefp) CIniDomain *domain = NULL;
+        _c_cleanup_(c_ini_list_deinit) CIniList list = C_INI_LIST_NULL(list);
+        const char *value, *element;
+        CIniGroup *group;
+        size_t n;
+        int r;
+
+        r = c_ini_reader_parse(&domain, C_INI_MODE_BORROW_DATA, (const uint8_t *)input, strlen(input));
+        c_assert(!r);
+
+        group = c_ini_domain_get_null_group(domain);
+        test_basic_list_assert(group, "empty", (const char *[]){ NULL });
+        test_basic_list_assert(group, "single", (const char *[]){ "a", NULL });
+        test_basic_list_assert(group, "plain", (const char *[]){ "text/plain", "text/html", NULL });
+        test_basic_list_assert(group, "unterminated", (const char *[]){ "a", "b", NULL });
+        test_basic_list_assert(group, "blanks", (const char *[]){ "", "a", "", "b", NULL });
+        test_basic_list_assert(group, "escaped", (const char *[]){ "a;b", "c\\", "d \t\\x", "\\", NULL });
+
+        /* elements without escapes point into the value */
+        value = c_ini_entry_get_value(c_ini_group_find(group, "plain", -1), NULL);
+        c_ini_list_init(&list, c_ini_group_find(group, "plain", -1));
+        c_assert(c_ini_list_next(&list, &element, &n) == 1);
+        c_assert(element == value);
+        c_assert(c_ini_list_next(&list, &element, &n) == 1);
+        c_assert(element == value + strlen("text/plain;"));
+        c_assert(!list.buffer);
+}
+
+static void test_basic_string(void) {
+        static const char input[] = "plain=foo bar\n"
+                                    "escaped=\\sfoo\\tbar\\\\\\n\\x\\\n";
+        CIniDomain *domains[3];
+        const char *value, *string, *again;
+        CIniGroup *group;
+        size_t i, n;
+        int r;
+
+        r = c_ini_reader_parse(&domains[0], 0, (const uint8_t *)input, strlen(input));
+        c_assert(!r);
+        r = c_ini_reader_parse(&domains[1], C_INI_MODE_BORROW_DATA, (const uint8_t *)input, strlen(input));
+        c_assert(!r);
+        r = c_ini_domain_freeze(domains[0], &domains[2]);
+        c_assert(!r);
+
+        for (i = 0; i < 3; ++i) {
+                group = c_ini_domain_get_null_group(domains[i]);
+
+                /* values without escapes are returned as is */
+                value = c_ini_entry_get_value(c_ini_group_find(group, "plain", -1), NULL);
+                r = c_ini_entry_get_string(c_ini_group_find(group, "plain", -1), &string, &n);
+                c_assert(!r);
+                c_assert(string == value);
+                c_assert(n == strlen("foo bar"));
+
+                /* escaped values are decoded once */
+                value = c_ini_entry_get_value(c_ini_group_find(group, "escaped", -1), NULL);
+                r = c_ini_entry_get_string(c_ini_group_find(group, "escaped", -1), &string, &n);
+                c_assert(!r);
+                c_assert(string != value);
+                c_assert(n == strlen(" foo\tbar\\\n\\x\\"));
+                c_assert(!memcmp(string, " foo\tbar\\\n\\x\\", n + 1));
+
+                r = c_ini_entry_get_string(c_ini_group_find(group, "escaped", -1), &again, NULL);
+                c_assert(!r);
+                c_assert(again == string);
+        }
+
+        for (i = 0; i < 3; ++i)
+                c_ini_domain_unref(domains[i]);
+}
+
+static void test_basic_locale_assert(CIniGroup *group, const char *key, const char *locale, const char *expected) {
+        CIniEntry *entry;
+        const char *value;
+        size_t n;
+
+        entry = c_ini_group_find_locale(group, key, -1, locale);
+        if (!expected) {
+                c_assert(!entry);
+                return;
+        }
+
+        c_assert(entry);
+        value = c_ini_entry_get_value(entry, &n);
+        c_assert(n == strlen(expected));
+        c_assert(!memcmp(value, expected, n));
+}
+
+static void test_basic_locale(void) {
+        static const char input[] = "Name=Plain\n"
+                                    "Name[de]=de\n"
+                                    "Name[de_DE]=de_DE\n"
+                                    "Name[de@euro]=de@euro\n"
+                                    "Name[de_DE@euro]=de_DE@euro\n"
+                                    "Name[fr]=fr\n"
+                                    "Names[fr]=Names\n"
+                                    "Other[de]=Other\n"
+                                    "[many]\n";
+        _c_cleanup_(c_freep) char *data = NULL;
+        CIniDomain *domains[3];
+        char locale[16], value[16];
+        CIniGroup *group;
+        size_t i, j, n_data;
+        FILE *f;
+        int r;
+
+        f = open_memstream(&data, &n_data);
+        c_assert(f);
+        fputs(input, f);
+        for (j = 0; j < 256; ++j)
+                fprintf(f, "Key[l%zu]=%zu\n", j, j);
+        c_assert(!fclose(f));
+
+        r = c_ini_reader_parse(&domains[0], 0, (const uint8_t *)data, n_data);
+        c_assert(!r);
+        r = c_ini_reader_parse(&domains[1], C_INI_MODE_HASH_INDEX, (const uint8_t *)data, n_data);
+        c_assert(!r);
+        r = c_ini_domain_freeze(domains[0], &domains[2]);
+        c_assert(!r);
+
+        for (i = 0; i < 3; ++i) {
+                group = c_ini_domain_get_null_group(domains[i]);
+
+                /* the most specific variant wins, the encoding is ignored */
+                test_basic_locale_assert(group, "Name", "de_DE.UTF-8@euro", "de_DE@euro");
+                test_basic_locale_assert(group, "Name", "de_DE", "de_DE");
+                test_basic_locale_assert(group, "Name", "de_DE.UTF-8", "de_DE");
+                test_basic_locale_assert(group, "Name", "de_AT@euro", "de@euro");
+                test_basic_locale_assert(group, "Name", "de_AT", "de");
+                test_basic_locale_assert(group, "Name", "de", "de");
+                test_basic_locale_assert(group, "Name", "fr_FR", "fr");
+
+                /* otherwise, the untranslated key is used */
+                test_basic_locale_assert(group, "Name", "it_IT", "Plain");
+                test_basic_locale_assert(group, "Name", "C", "Plain");
+                test_basic_locale_assert(group, "Name", NULL, "Plain");
+                test_basic_locale_assert(group, "Name[fr]", NULL, "fr");
+                test_basic_locale_assert(group, "Other", "de_DE", "Other");
+                test_basic_locale_assert(group, "Other", "fr", NULL);
+                test_basic_locale_assert(group, "Nam", "de", NULL);
+
+                /* lookups stay correct when the index has to grow */
+                group = c_ini_domain_find(domains[i], "many", -1);
+                c_assert(group);
+                for (j = 0; j < 256; ++j) {
+                        snprintf(locale, sizeof(locale), "l%zu_XX", j);
+                        snprintf(value, sizeof(value), "%zu", j);
+                        test_basic_locale_assert(group, "Key", locale, value);
+                }
+                test_basic_locale_assert(group, "Key", "l256", NULL);
+        }
+
+        for (i = 0; i < 3; ++i)
+                c_ini_domain_unref(domains[i]);
+
+        /* duplicates resolve to the earliest entry, overrides replace it */
+        r = c_ini_reader_parse(&domains[0], C_INI_MODE_KEEP_DUPLICATE_ENTRIES, (const uint8_t *)"K[de]=a\nK[de]=b\n", 16);
+        c_assert(!r);
+        r = c_ini_reader_parse(&domains[1], C_INI_MODE_OVERRIDE_ENTRIES, (const uint8_t *)"K[de]=a\nK[de]=b\n", 16);
+        c_assert(!r);
+        r = c_ini_domain_freeze(domains[0], &domains[2]);
+        c_assert(!r);
+
+        test_basic_locale_assert(c_ini_domain_get_null_group(domains[0]), "K", "de", "a");
+        test_basic_locale_assert(c_ini_domain_get_null_group(domains[1]), "K", "de", "b");
+        test_basic_locale_assert(c_ini_domain_get_null_group(domains[2]), "K", "de", "a");
+
+        for (i = 0; i < 3; ++i)
+                c_ini_domain_unref(domains[i]);
+}
+
+static void test_basic_batch(void) {
+        static const unsigned int modes[] = { 0, C_INI_MODE_HASH_INDEX, C_INI_MODE_KEEP_DUPLICATE_ENTRIES };
+        _c_cleanup_(c_freep) char *data = NULL;
+        char keys[512][16];
+        CIniSpan spans[512];
+        CIniEntry *entries[512];
+        CIniDomain *domains[4];
+        CIniGroup *group;
+        size_t i, j, n_data;
+        FILE *f;
+        int r;
+
+        f = open_memstream(&data, &n_data);
+        c_assert(f);
+        for (i = 0; i < 256; i += 2)
+                fprintf(f, "k%zu=%zu\nk%zu=dup\n", i, i, i);
+        c_assert(!fclose(f));
+
+        for (i = 0; i < 3; ++i) {
+                r = c_ini_reader_parse(&domains[i], modes[i], (const uint8_t *)data, n_data);
+                c_assert(!r);
+        }
+        r = c_ini_domain_freeze(domains[2], &domains[3]);
+        c_assert(!r);
+
+        /* every other key is missing, and the second half repeats the first */
+        for (i = 0; i < 256; ++i) {
+                snprintf(keys[i], sizeof(keys[i]), "k%zu", i);
+                spans[i] = (CIniSpan)C_INI_SPAN_INIT(keys[i], strlen(keys[i]));
+                spans[511 - i] = spans[i];
+        }
+
+        for (i = 0; i < 4; ++i) {
+                group = c_ini_domain_get_null_group(domains[i]);
+
+                /* sorted, unsorted, and sparse batches match single lookups */
+                r = c_ini_group_find_many(group, spans, 256, entries);
+                c_assert(!r);
+                for (j = 0; j < 256; ++j)
+                        c_assert(entries[j] == c_ini_group_find(group, keys[j], -1));
+
+                r = c_ini_group_find_many(group, spans, 512, entries);
+                c_assert(!r);
+                for (j = 0; j < 512; ++j) {
+                        c_assert(entries[j] == c_ini_group_find(group, spans[j].data, spans[j].n_data));
+                        c_assert(!!entries[j] == !((j < 256 ? j : 511 - j) % 2));
+                }
+
+                r = c_ini_group_find_many(group, spans + 1, 256, entries);
+                c_assert(!r);
+                for (j = 0; j < 256; j += 64)
+                        c_assert(entries[j] == c_ini_group_find(group, spans[j + 1].data, spans[j + 1].n_data));
+
+                r = c_ini_group_find_many(group, NULL, 0, NULL);
+                c_assert(!r);
+        }
+
+        for (i = 0; i < 4; ++i)
+                c_ini_domain_unref(domains[i]);
+}
+
+static void test_basic_key(void) {
+        static const char input[] = "[Desktop Entry]\n"
+                                    "Exec=foo\n"
+                                    "Name=Foo\n"
+                                    "[Desktop Action]\n"
+                                    "Exec=bar\n";
+        CIniKey label, key, missing;
+        CIniDomain *domains[3];
+        CIniGroup *group;
+        size_t i;
+        int r;
+
+        c_ini_key_init(&label, "Desktop Entry", -1);
+        c_ini_key_init(&key, "Exec=", 4);
+        c_ini_key_init(&missing, "Missing", -1);
+
+        r = c_ini_reader_parse(&domains[0], 0, (const uint8_t *)input, strlen(input));
+        c_assert(!r);
+        r = c_ini_reader_parse(&domains[1], C_INI_MODE_HASH_INDEX, (const uint8_t *)input, strlen(input));
+        c_assert(!r);
+        r = c_ini_domain_freeze(domains[0], &domains[2]);
+        c_assert(!r);
+
+        /* prepared keys can be used with any domain */
+        for (i = 0; i < 3; ++i) {
+                group = c_ini_domain_find_key(domains[i], &label);
+                c_assert(group);
+                c_assert(group == c_ini_domain_find(domains[i], "Desktop Entry", -1));
+                c_assert(!c_ini_domain_find_key(domains[i], &missing));
+
+                c_assert(c_ini_group_find_key(group, &key));
+                c_assert(c_ini_group_find_key(group, &key) == c_ini_group_find(group, "Exec", -1));
+                c_assert(!c_ini_group_find_key(group, &missing));
+        }
+
+        for (i = 0; i < 3; ++i)
+                c_ini_domain_unref(domains[i]);
+}
+
 int main(int argc, char *argv[]) {
         test_basic_reader();
+        test_basic_arena();
+        test_basic_scan();
+        test_basic_values();
+        test_basic_list();
+        test_basic_string();
+        test_basic_locale();
+        test_basic_batch();
+        test_basic_key();
         return 0;
 }
@@ -7,9 +7,14 @@
 #undef NDEBUG
 #include <assert.h>
 #include <c-stdaux.h>
+#include <errno.h>
+#include <fcntl.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
 #include "c-ini.h"
 #include "c-ini-private.h"
 
@@ -58,6 +63,42 @@ static void test_reader_assert_singleton(CIniDomain *domain,
         c_assert(!strcmp(value, c_ini_entry_get_value(entry, NULL)));
 }
 
+static void test_reader_assert_group_equal(CIniGroup *a, CIniGroup *b) {
+        CIniEntry *ea, *eb;
+        const char *sa, *sb;
+        size_t na, nb;
+
+        sa = c_ini_group_get_label(a, &na);
+        sb = c_ini_group_get_label(b, &nb);
+        c_assert(na == nb && !memcmp(sa, sb, na));
+
+        for (ea = c_ini_group_iterate(a), eb = c_ini_group_iterate(b);
+             ea && eb;
+             ea = c_ini_entry_next(ea), eb = c_ini_entry_next(eb)) {
+                sa = c_ini_entry_get_key(ea, &na);
+                sb = c_ini_entry_get_key(eb, &nb);
+                c_assert(na == nb && !memcmp(sa, sb, na));
+
+                sa = c_ini_entry_get_value(ea, &na);
+                sb = c_ini_entry_get_value(eb, &nb);
+                c_assert(na == nb && !memcmp(sa, sb, na));
+        }
+        c_assert(!ea && !eb);
+}
+
+static void test_reader_assert_equal(CIniDomain *a, CIniDomain *b) {
+        CIniGroup *ga, *gb;
+
+        test_reader_assert_group_equal(c_ini_domain_get_null_group(a),
+                                       c_ini_domain_get_null_group(b));
+
+        for (ga = c_ini_domain_iterate(a), gb = c_ini_domain_iterate(b);
+             ga && gb;
+             ga = c_ini_group_next(ga), gb = c_ini_group_next(gb))
+                test_reader_assert_group_equal(ga, gb);
+        c_assert(!ga && !gb);
+}
+
 static void test_reader_normal_whitespace(void) {
         const char *input[] = {
                 /* normalized input */
@@ -287,8 +328,1888 @@ static void test_reader_extended_whitespace(void) {
         }
 }
 
+static void test_reader_borrow(void) {
+        const char input[] = "k0=v0\n"
+                             "[group]\n"
+                             "k1 = v1\n"
+                             "k2=v2\n"
+                             "k3=v3";
+        _c_cleanup_(c_ini_reader_freep) CIniReader *reader = NULL;
+        _c_cleanup_(c_ini_domain_unrefp) CIniDomain *domain = NULL;
+        CIniGroup *group;
+        CIniEntry *entry;
+        const char *s;
+        size_t n, n_split;
+        int r;
+
+        /* split the input in the middle of the 'k2' line */
+        n_split = strstr(input, "k2") - input + 1;
+
+        r = c_ini_reader_new(&reader);
+        c_assert(!r);
+
+        c_ini_reader_set_mode(reader, C_INI_MODE_BORROW_DATA);
+
+        r = c_ini_reader_feed(reader, (const uint8_t *)input, n_split);
+        c_assert(!r);
+        r = c_ini_reader_feed(reader, (const uint8_t *)input + n_split, strlen(input) - n_split);
+        c_assert(!r);
+        r = c_ini_reader_seal(reader, &domain);
+        c_assert(!r);
+
+        /* lines fully contained in a single chunk must reference the input */
+
+        entry = c_ini_group_find(c_ini_domain_get_null_group(domain), "k0", -1);
+        c_assert(entry);
+        s = c_ini_entry_get_value(entry, &n);
+        c_assert(n == 2 && !memcmp(s, "v0", 2));
+        c_assert(s == input + 3);
+
+        group = c_ini_domain_find(domain, "group", -1);
+        c_assert(group);
+        s = c_ini_group_get_label(group, &n);
+        c_assert(n == 5 && !memcmp(s, "group", 5));
+        c_assert(s == input + 7);
+
+        entry = c_ini_group_find(group, "k1", -1);
+        c_assert(entry);
+        s = c_ini_entry_get_key(entry, &n);
+        c_assert(n == 2 && !memcmp(s, "k1", 2));
+        c_assert(s == input + 14);
+        s = c_ini_entry_get_value(entry, &n);
+        c_assert(n == 2 && !memcmp(s, "v1", 2));
+
+        /* lines spanning multiple chunks are still available, but copied */
+
+        entry = c_ini_group_find(group, "k2", -1);
+        c_assert(entry);
+        s = c_ini_entry_get_value(entry, &n);
+        c_assert(n == 2 && !memcmp(s, "v2", 2));
+        c_assert(s < input || s >= input + sizeof(input));
+
+        entry = c_ini_group_find(group, "k3", -1);
+        c_assert(entry);
+        s = c_ini_entry_get_value(entry, &n);
+        c_assert(n == 2 && !memcmp(s, "v3", 2));
+
+        /* entries keep their data accessible beyond the domain */
+
+        entry = c_ini_entry_ref(c_ini_group_find(group, "k2", -1));
+        domain = c_ini_domain_unref(domain);
+        s = c_ini_entry_get_key(entry, &n);
+        c_assert(n == 2 && !memcmp(s, "k2", 2));
+        c_ini_entry_unref(entry);
+}
+
+static void test_reader_chunks(void) {
+        const char input[] = "k0=v0\n"
+                             "[group0]\n"
+                             "# comment\n"
+                             "k1 = v1\n"
+                             "\n"
+                             "malformed\n"
+                             "[group1]\n"
+                             "k2=v2\n"
+                             "k3=v3";
+        const unsigned int modes[] = { 0, C_INI_MODE_BORROW_DATA };
+        size_t i, n_input = strlen(input), n_split;
+        int r;
+
+        /*
+         * Parse the input split at every possible offset, and verify the
+         * result is independent of how the data was chunked.
+         */
+
+        for (i = 0; i < sizeof(modes) / sizeof(*modes); ++i) {
+                _c_cleanup_(c_ini_domain_unrefp) CIniDomain *whole = NULL;
+
+                r = c_ini_reader_parse(&whole, modes[i], (const uint8_t *)input, n_input);
+                c_assert(!r);
+
+                for (n_split = 0; n_split <= n_input; ++n_split) {
+                        _c_cleanup_(c_ini_reader_freep) CIniReader *reader = NULL;
+                        _c_cleanup_(c_ini_domain_unrefp) CIniDomain *domain = NULL;
+
+                        r = c_ini_reader_new(&reader);
+                        c_assert(!r);
+
+                        c_ini_reader_set_mode(reader, modes[i]);
+
+                        r = c_ini_reader_feed(reader, (const uint8_t *)input, n_split);
+                        c_assert(!r);
+                        r = c_ini_reader_feed(reader, (const uint8_t *)input + n_split, n_input - n_split);
+                        c_assert(!r);
+                        r = c_ini_reader_seal(reader, &domain);
+                        c_assert(!r);
+
+                        test_reader_assert_equal(whole, domain);
+                }
+        }
+}
+
+static void test_reader_fd(void) {
+        const char input[] = "k0=v0\n"
+                             "[group]\n"
+                             "k1=v1\n"
+                             "k2=v2";
+        const unsigned int modes[] = { 0, C_INI_MODE_BORROW_DATA };
+        size_t i;
+        FILE *f;
+        int r, p[2];
+
+        for (i = 0; i < sizeof(modes) / sizeof(*modes); ++i) {
+                _c_cleanup_(c_ini_domain_unrefp) CIniDomain *expected = NULL;
+
+                r = c_ini_reader_parse(&expected,
+                                       modes[i],
+                                       (const uint8_t *)input,
+                                       strlen(input));
+                c_assert(!r);
+
+                /* regular files are mapped */
+                {
+                        _c_cleanup_(c_ini_reader_freep) CIniReader *reader = NULL;
+                        _c_cleanup_(c_ini_domain_unrefp) CIniDomain *domain = NULL;
+
+                        f = tmpfile();
+                        c_assert(f);
+                        c_assert(fwrite(input, 1, strlen(input), f) == strlen(input));
+                        c_assert(!fflush(f));
+                        c_assert(!lseek(fileno(f), 0, SEEK_SET));
+
+                        r = c_ini_reader_new(&reader);
+                        c_assert(!r);
+                        c_ini_reader_set_mode(reader, modes[i]);
+                        r = c_ini_reader_feed_fd(reader, fileno(f));
+                        c_assert(!r);
+                        r = c_ini_reader_seal(reader, &domain);
+                        c_assert(!r);
+
+                        /* the file is consumed to its end */
+                        c_assert(lseek(fileno(f), 0, SEEK_CUR) == (off_t)strlen(input));
+
+                        /* the domain must not depend on the file */
+                        fclose(f);
+
+                        test_reader_assert_equal(expected, domain);
+                }
+
+                /* files are consumed from their current position */
+                {
+                        _c_cleanup_(c_ini_reader_freep) CIniReader *reader = NULL;
+                        _c_cleanup_(c_ini_domain_unrefp) CIniDomain *domain = NULL;
+                        _c_cleanup_(c_ini_domain_unrefp) CIniDomain *tail = NULL;
+
+                        r = c_ini_reader_parse(&tail, modes[i], (const uint8_t *)input + 6, strlen(input) - 6);
+                        c_assert(!r);
+
+                        f = tmpfile();
+                        c_assert(f);
+                        c_assert(fwrite(input, 1, strlen(input), f) == strlen(input));
+                        c_assert(!fflush(f));
+                        c_assert(lseek(fileno(f), 6, SEEK_SET) == 6);
+
+                        r = c_ini_reader_new(&reader);
+                        c_assert(!r);
+                        c_ini_reader_set_mode(reader, modes[i]);
+                        r = c_ini_reader_feed_fd(reader, fileno(f));
+                        c_assert(!r);
+
+                        /* nothing is left at the end */
+                        r = c_ini_reader_feed_fd(reader, fileno(f));
+                        c_assert(!r);
+
+                        r = c_ini_reader_seal(reader, &domain);
+                        c_assert(!r);
+
+                        fclose(f);
+
+                        test_reader_assert_equal(tail, domain);
+                }
+
+                /* pipes are streamed */
+                {
+                        _c_cleanup_(c_ini_reader_freep) CIniReader *reader = NULL;
+                        _c_cleanup_(c_ini_domain_unrefp) CIniDomain *domain = NULL;
+
+                        r = pipe(p);
+                        c_assert(!r);
+                        c_assert(write(p[1], input, strlen(input)) == (ssize_t)strlen(input));
+                        close(p[1]);
+
+                        r = c_ini_reader_new(&reader);
+                        c_assert(!r);
+                        c_ini_reader_set_mode(reader, modes[i]);
+                        r = c_ini_reader_feed_fd(reader, p[0]);
+                        c_assert(!r);
+                        r = c_ini_reader_seal(reader, &domain);
+                        c_assert(!r);
+
+                        close(p[0]);
+
+                        test_reader_assert_equal(expected, domain);
+                }
+        }
+
+        /* failures are propagated */
+        {
+                _c_cleanup_(c_ini_reader_freep) CIniReader *reader = NULL;
+
+                r = c_ini_reader_new(&reader);
+                c_assert(!r);
+                r = c_ini_reader_feed_path(reader, "/nonexistent/c-ini/test.ini");
+                c_assert(r == -ENOENT);
+        }
+}
+
+static char *test_reader_generate(size_t n_min, size_t *n_datap) {
+        char *data = NULL;
+        size_t n_data = 0;
+        FILE *f;
+
+        /*
+         * Generate input with plenty of duplicate groups and entries, as
+         * well as comments, blank, and malformed lines.
+         */
+
+        f = open_memstream(&data, &n_data);
+        c_assert(f);
+
+        srand(0xc1c1);
+
+        while ((size_t)ftell(f) < n_min) {
+                switch (rand() % 8) {
+                case 0:
+                        fprintf(f, "[group%d]\n", rand() % 64);
+                        break;
+                case 1:
+                        fprintf(f, "# comment %d\n", rand());
+                        break;
+                case 2:
+                        fprintf(f, "\n");
+                        break;
+                case 3:
+                        fprintf(f, "malformed %d\n", rand());
+                        break;
+                default:
+                        fprintf(f, "key%d = value%d\n", rand() % 32, rand());
+                        break;
+                }
+        }
+
+        c_assert(!fclose(f));
+
+        *n_datap = n_data;
+        return data;
+}
+
+static void test_reader_assert_raws_equal(CIniDomain *a, CIniDomain *b) {
+        CList *ia, *ib;
+        CIniRaw *ra, *rb;
+
+        for (ia = a->list_raws.next, ib = b->list_raws.next;
+             ia != &a->list_raws && ib != &b->list_raws;
+             ia = ia->next, ib = ib->next) {
+                ra = c_list_entry(ia, CIniRaw, link_domain);
+                rb = c_list_entry(ib, CIniRaw, link_domain);
+                c_assert(ra->n_data == rb->n_data);
+                c_assert(!memcmp(ra->data, rb->data, ra->n_data));
+        }
+        c_assert(ia == &a->list_raws && ib == &b->list_raws);
+}
+
+static void test_reader_parallel(void) {
+        const unsigned int modes[] = {
+                0,
+                C_INI_MODE_BORROW_DATA,
+                C_INI_MODE_MERGE_GROUPS,
+                C_INI_MODE_KEEP_DUPLICATE_GROUPS,
+                C_INI_MODE_KEEP_DUPLICATE_ENTRIES,
+                C_INI_MODE_MERGE_GROUPS | C_INI_MODE_OVERRIDE_ENTRIES,
+                C_INI_MODE_KEEP_DUPLICATE_GROUPS | C_INI_MODE_KEEP_DUPLICATE_ENTRIES,
+        };
+        const unsigned int threads[] = { 0, 2, 7 };
+        _c_cleanup_(c_freep) char *input = NULL;
+        size_t i, j, n_input, n_split;
+        int r;
+
+        input = test_reader_generate(1024 * 1024, &n_input);
+        n_split = n_input / 3 + 5;
+
+        for (i = 0; i < sizeof(modes) / sizeof(*modes); ++i) {
+                _c_cleanup_(c_ini_domain_unrefp) CIniDomain *serial = NULL;
+
+                r = c_ini_reader_parse(&serial, modes[i], (const uint8_t *)input, n_input);
+                c_assert(!r);
+
+                for (j = 0; j < sizeof(threads) / sizeof(*threads); ++j) {
+                        _c_cleanup_(c_ini_reader_freep) CIniReader *reader = NULL;
+                        _c_cleanup_(c_ini_domain_unrefp) CIniDomain *domain = NULL;
+
+                        r = c_ini_reader_new(&reader);
+                        c_assert(!r);
+
+                        c_ini_reader_set_mode(reader, modes[i]);
+
+                        /* split in the middle of a line to test carry-over */
+                        r = c_ini_reader_feed_parallel(reader, (const uint8_t *)input, n_split, threads[j]);
+                        c_assert(!r);
+                        r = c_ini_reader_feed_parallel(reader, (const uint8_t *)input + n_split, n_input - n_split, threads[j]);
+                        c_assert(!r);
+                        r = c_ini_reader_seal(reader, &domain);
+                        c_assert(!r);
+
+                        test_reader_assert_equal(serial, domain);
+                        test_reader_assert_raws_equal(serial, domain);
+                }
+        }
+}
+
+static size_t test_reader_group_position(CIniDomain *domain, CIniGroup *group) {
+        CIniGroup *iter;
+        size_t i = 0;
+
+        if (!group)
+                return SIZE_MAX;
+
+        for (iter = c_ini_domain_iterate(domain); iter; iter = c_ini_group_next(iter), ++i)
+                if (iter == group)
+                        return i;
+
+        c_assert(0);
+        return SIZE_MAX;
+}
+
+static void test_reader_assert_lookups_equal(CIniDomain *a, CIniDomain *b) {
+        CIniGroup *ga, *gb;
+        CIniEntry *ea, *eb;
+        const char *sa, *sb;
+        char label[32];
+        size_t j, k, na, nb;
+
+        /*
+         * Verify that lookups on both domains return the same objects, as
+         * generated by test_reader_generate(), including for duplicates and
+         * for missing keys.
+         */
+
+        for (j = 0; j <= 64; ++j) {
+                if (j < 64) {
+                        snprintf(label, sizeof(label), "group%zu", j);
+                        ga = c_ini_domain_find(a, label, -1);
+                        gb = c_ini_domain_find(b, label, -1);
+                        c_assert(test_reader_group_position(a, ga) ==
+                                 test_reader_group_position(b, gb));
+                        if (!ga)
+                                continue;
+                } else {
+                        ga = c_ini_domain_get_null_group(a);
+                        gb = c_ini_domain_get_null_group(b);
+                }
+
+                for (k = 0; k < 40; ++k) {
+                        snprintf(label, sizeof(label), "key%zu", k);
+                        ea = c_ini_group_find(ga, label, -1);
+                        eb = c_ini_group_find(gb, label, -1);
+                        c_assert(!ea == !eb);
+                        if (ea) {
+                                sa = c_ini_entry_get_value(ea, &na);
+                                sb = c_ini_entry_get_value(eb, &nb);
+                                c_assert(na == nb && !memcmp(sa, sb, na));
+                        }
+                }
+        }
+
+        c_assert(!c_ini_domain_find(a, "group64", -1));
+        c_assert(!c_ini_domain_find(b, "group64", -1));
+        c_assert(!c_ini_domain_find(a, "", -1));
+        c_assert(!c_ini_domain_find(b, "", -1));
+}
+
+static void test_reader_index(void) {
+        const unsigned int modes[] = {
+                0,
+                C_INI_MODE_BORROW_DATA,
+                C_INI_MODE_MERGE_GROUPS,
+                C_INI_MODE_KEEP_DUPLICATE_GROUPS,
+                C_INI_MODE_KEEP_DUPLICATE_ENTRIES,
+                C_INI_MODE_MERGE_GROUPS | C_INI_MODE_OVERRIDE_ENTRIES,
+                C_INI_MODE_KEEP_DUPLICATE_GROUPS | C_INI_MODE_KEEP_DUPLICATE_ENTRIES,
+        };
+        _c_cleanup_(c_freep) char *input = NULL;
+        size_t i, n_input;
+        int r;
+
+        /* compare lookups with and without hash index */
+
+        input = test_reader_generate(256 * 1024, &n_input);
+
+        for (i = 0; i < sizeof(modes) / sizeof(*modes); ++i) {
+                _c_cleanup_(c_ini_domain_unrefp) CIniDomain *plain = NULL;
+                _c_cleanup_(c_ini_domain_unrefp) CIniDomain *indexed = NULL;
+
+                r = c_ini_reader_parse(&plain, modes[i], (const uint8_t *)input, n_input);
+                c_assert(!r);
+                r = c_ini_reader_parse(&indexed,
+                                       modes[i] | C_INI_MODE_HASH_INDEX,
+                                       (const uint8_t *)input,
+                                       n_input);
+                c_assert(!r);
+
+                test_reader_assert_equal(plain, indexed);
+                test_reader_assert_lookups_equal(plain, indexed);
+        }
+}
+
+static void test_reader_freeze(void) {
+        const unsigned int modes[] = {
+                0,
+                C_INI_MODE_BORROW_DATA,
+                C_INI_MODE_MERGE_GROUPS,
+                C_INI_MODE_KEEP_DUPLICATE_GROUPS | C_INI_MODE_KEEP_DUPLICATE_ENTRIES,
+        };
+        _c_cleanup_(c_freep) char *input = NULL;
+        size_t i, n_input;
+        int r;
+
+        input = test_reader_generate(256 * 1024, &n_input);
+
+        for (i = 0; i < sizeof(modes) / sizeof(*modes); ++i) {
+                _c_cleanup_(c_ini_domain_unrefp) CIniDomain *domain = NULL;
+                _c_cleanup_(c_ini_domain_unrefp) CIniDomain *frozen = NULL;
+                _c_cleanup_(c_ini_domain_unrefp) CIniDomain *refrozen = NULL;
+                CIniGroup *group, *last = NULL;
+                CIniEntry *entry;
+
+                r = c_ini_reader_parse(&domain, modes[i], (const uint8_t *)input, n_input);
+                c_assert(!r);
+
+                r = c_ini_domain_freeze(domain, &frozen);
+                c_assert(!r);
+                c_assert(frozen != domain);
+
+                test_reader_assert_equal(domain, frozen);
+                test_reader_assert_lookups_equal(domain, frozen);
+
+                /* freezing a frozen domain is a no-op */
+                r = c_ini_domain_freeze(frozen, &refrozen);
+                c_assert(!r);
+                c_assert(refrozen == frozen);
+
+                /* iterate backwards */
+                for (group = c_ini_domain_iterate(frozen); group; group = c_ini_group_next(group))
+                        last = group;
+                for (group = last; group; group = c_ini_group_previous(group)) {
+                        entry = c_ini_group_iterate(group);
+                        while (entry && c_ini_entry_next(entry))
+                                entry = c_ini_entry_next(entry);
+                        while (entry && c_ini_entry_previous(entry))
+                                entry = c_ini_entry_previous(entry);
+                        c_assert(entry == c_ini_group_iterate(group));
+                        last = group;
+                }
+                c_assert(last == c_ini_domain_iterate(frozen));
+                c_assert(!c_ini_group_next(c_ini_domain_get_null_group(frozen)));
+                c_assert(!strcmp(c_ini_group_get_label(c_ini_domain_get_null_group(frozen), NULL), ""));
+        }
+
+        /* objects of a frozen domain pin the domain */
+        {
+                _c_cleanup_(c_ini_domain_unrefp) CIniDomain *domain = NULL;
+                _c_cleanup_(c_ini_domain_unrefp) CIniDomain *frozen = NULL;
+                _c_cleanup_(c_ini_group_unrefp) CIniGroup *group = NULL;
+                _c_cleanup_(c_ini_entry_unrefp) CIniEntry *entry = NULL;
+                const char *pinned = "[group]\nkey = value\n";
+
+                r = c_ini_reader_parse(&domain,
+                                       C_INI_MODE_BORROW_DATA,
+                                       (const uint8_t *)pinned,
+                                       strlen(pinned));
+                c_assert(!r);
+
+                r = c_ini_domain_freeze(domain, &frozen);
+                c_assert(!r);
+                domain = c_ini_domain_unref(domain);
+
+                group = c_ini_group_ref(c_ini_domain_find(frozen, "group", -1));
+                c_assert(group);
+                entry = c_ini_entry_ref(c_ini_group_find(group, "key", -1));
+                c_assert(entry);
+                frozen = c_ini_domain_unref(frozen);
+
+                /* frozen strings are zero-terminated, even if borrowed */
+                c_assert(!strcmp(c_ini_group_get_label(group, NULL), "group"));
+                c_assert(!strcmp(c_ini_entry_get_key(entry, NULL), "key"));
+                c_assert(!strcmp(c_ini_entry_get_value(entry, NULL), "value"));
+                c_assert(!c_ini_group_find(group, "none", -1));
+                c_assert(!c_ini_entry_next(entry));
+        }
+
+        /* empty domains */
+        {
+                _c_cleanup_(c_ini_domain_unrefp) CIniDomain *domain = NULL;
+                _c_cleanup_(c_ini_domain_unrefp) CIniDomain *frozen = NULL;
+
+                r = c_ini_reader_parse(&domain, 0, (const uint8_t *)"", 0);
+                c_assert(!r);
+
+                r = c_ini_domain_freeze(domain, &frozen);
+                c_assert(!r);
+                c_assert(!c_ini_domain_iterate(frozen));
+                c_assert(!c_ini_domain_find(frozen, "group", -1));
+                c_assert(!c_ini_group_iterate(c_ini_domain_get_null_group(frozen)));
+                c_assert(!c_ini_group_find(c_ini_domain_get_null_group(frozen), "key", -1));
+        }
+}
+
+static void test_reader_write_file(const char *dir, const char *name, const char *content) {
+        char path[4096];
+        FILE *f;
+
+        c_assert(snprintf(path, sizeof(path), "%s/%s", dir, name) < (int)sizeof(path));
+
+        f = fopen(path, "we");
+        c_assert(f);
+        c_assert(fputs(content, f) >= 0);
+        c_assert(!fclose(f));
+}
+
+static void test_reader_dropins(void) {
+        static const char *files[][2] = {
+                { "usr/foo.conf", "[A]\nx=usr\ny=usr\n" },
+                { "usr/foo.conf.d/10-a.conf", "[A]\ny=usr-10\n[B]\nz=usr-10\n" },
+                { "usr/foo.conf.d/20-b.conf", "[B]\nz=usr-20\n" },
+                { "usr/foo.conf.d/30-c.conf", "[C]\nw=usr-30\n" },
+                { "usr/foo.conf.d/ignored.txt", "[D]\n" },
+                { "etc/foo.conf.d/20-b.conf", "[B]\nz=etc-20" },
+                { "etc/foo.conf.d/15-d.conf", "k=null\n[A]\ny=etc-15\n" },
+        };
+        static const char *links[][2] = {
+                { "usr/foo.conf.d/40-dir.conf", "." },
+                { "etc/foo.conf.d/50-gone.conf", "gone.conf" },
+        };
+        static const char *subdirs[] = { "usr", "usr/foo.conf.d", "etc", "etc/foo.conf.d" };
+        _c_cleanup_(c_ini_reader_freep) CIniReader *reader = NULL;
+        _c_cleanup_(c_ini_domain_unrefp) CIniDomain *domain = NULL;
+        char root[] = "/tmp/test-c-ini-XXXXXX", path[4096], etc[4096], usr[4096];
+        const char *dirs[] = { etc, usr, NULL };
+        CIniGroup *group;
+        size_t i;
+        int r;
+
+        c_assert(mkdtemp(root));
+
+        for (i = 0; i < sizeof(subdirs) / sizeof(*subdirs); ++i) {
+                snprintf(path, sizeof(path), "%s/%s", root, subdirs[i]);
+                c_assert(!mkdir(path, 0755));
+        }
+
+        for (i = 0; i < sizeof(files) / sizeof(*files); ++i)
+                test_reader_write_file(root, files[i][0], files[i][1]);
+
+        /* drop-ins that are directories, or vanished, are skipped */
+        for (i = 0; i < sizeof(links) / sizeof(*links); ++i) {
+                snprintf(path, sizeof(path), "%s/%s", root, links[i][0]);
+                c_assert(!symlink(links[i][1], path));
+        }
+
+        snprintf(etc, sizeof(etc), "%s/etc", root);
+        snprintf(usr, sizeof(usr), "%s/usr", root);
+
+        r = c_ini_reader_new(&reader);
+        c_assert(!r);
+
+        c_ini_reader_set_mode(reader, C_INI_MODE_MERGE_GROUPS | C_INI_MODE_OVERRIDE_ENTRIES);
+
+        /* a dangling line must not leak into the first file */
+        r = c_ini_reader_feed(reader, (const uint8_t *)"[E]\ne=e", 8);
+        c_assert(!r);
+
+        r = c_ini_reader_feed_dropins(reader, dirs, "foo.conf", 0);
+        c_assert(!r);
+
+        r = c_ini_reader_seal(reader, &domain);
+        c_assert(!r);
+
+        /* order: main file, then drop-ins sorted by name across all dirs */
+        group = c_ini_domain_iterate(domain);
+        c_assert(!strcmp(c_ini_group_get_label(group, NULL), "E"));
+        c_assert(!strcmp(c_ini_entry_get_value(c_ini_group_find(group, "e", -1), NULL), "e"));
+        group = c_ini_group_next(group);
+        c_assert(!strcmp(c_ini_group_get_label(group, NULL), "A"));
+        c_assert(!strcmp(c_ini_entry_get_value(c_ini_group_find(group, "x", -1), NULL), "usr"));
+        c_assert(!strcmp(c_ini_entry_get_value(c_ini_group_find(group, "y", -1), NULL), "etc-15"));
+        group = c_ini_group_next(group);
+        c_assert(!strcmp(c_ini_group_get_label(group, NULL), "B"));
+        c_assert(!strcmp(c_ini_entry_get_value(c_ini_group_find(group, "z", -1), NULL), "etc-20"));
+        group = c_ini_group_next(group);
+        c_assert(!strcmp(c_ini_group_get_label(group, NULL), "C"));
+        c_assert(!c_ini_group_next(group));
+
+        /* each file starts without open group */
+        group = c_ini_domain_get_null_group(domain);
+        c_assert(!strcmp(c_ini_entry_get_value(c_ini_group_find(group, "k", -1), NULL), "null"));
+
+        /* readers with limits load drop-ins serially, and skip the same */
+        domain = c_ini_domain_unref(domain);
+        c_ini_reader_set_limits(reader, &(CIniLimits){ .max_groups = 16 });
+
+        r = c_ini_reader_feed_dropins(reader, dirs, "foo.conf", 0);
+        c_assert(!r);
+
+        r = c_ini_reader_seal(reader, &domain);
+        c_assert(!r);
+
+        group = c_ini_domain_iterate(domain);
+        c_assert(!strcmp(c_ini_group_get_label(group, NULL), "A"));
+        c_assert(!strcmp(c_ini_entry_get_value(c_ini_group_find(group, "y", -1), NULL), "etc-15"));
+
+        for (i = 0; i < sizeof(links) / sizeof(*links); ++i) {
+                snprintf(path, sizeof(path), "%s/%s", root, links[i][0]);
+                c_assert(!unlink(path));
+        }
+        for (i = sizeof(files) / sizeof(*files); i-- > 0; ) {
+                snprintf(path, sizeof(path), "%s/%s", root, files[i][0]);
+                c_assert(!unlink(path));
+        }
+        for (i = sizeof(subdirs) / sizeof(*subdirs); i-- > 0; ) {
+                snprintf(path, sizeof(path), "%s/%s", root, subdirs[i]);
+                c_assert(!rmdir(path));
+        }
+        c_assert(!rmdir(root));
+}
+
+static void test_reader_assert_corrupt(const char *path, const void *data, size_t n_data) {
+        _c_cleanup_(c_ini_domain_unrefp) CIniDomain *domain = NULL;
+        FILE *f;
+        int r;
+
+        f = fopen(path, "we");
+        c_assert(f);
+        c_assert(fwrite(data, 1, n_data, f) == n_data);
+        c_assert(!fclose(f));
+
+        r = c_ini_domain_load_cache(&domain, path, NULL);
+        c_assert(r == -EBADMSG);
+        c_assert(!domain);
+}
+
+static void test_reader_cache(void) {
+        _c_cleanup_(c_ini_domain_unrefp) CIniDomain *domain = NULL;
+        _c_cleanup_(c_freep) char *input = NULL;
+        char root[] = "/tmp/test-c-ini-XXXXXX", a[4096], b[4096], cache[4096], recache[4096];
+        const char *sources[] = { a, b, NULL };
+        const char *reversed[] = { b, a, NULL };
+        const char *partial[] = { a, NULL };
+        struct timespec ts[2] = {
+                { .tv_sec = 1, .tv_nsec = 0 },
+                { .tv_sec = 1, .tv_nsec = 0 },
+        };
+        size_t n_input;
+        FILE *f;
+        int r;
+
+        c_assert(mkdtemp(root));
+        snprintf(a, sizeof(a), "%s/a.conf", root);
+        snprintf(b, sizeof(b), "%s/b.conf", root);
+        snprintf(cache, sizeof(cache), "%s/cache", root);
+        snprintf(recache, sizeof(recache), "%s/recache", root);
+
+        input = test_reader_generate(64 * 1024, &n_input);
+        f = fopen(a, "we");
+        c_assert(f);
+        c_assert(fwrite(input, 1, n_input, f) == n_input);
+        c_assert(!fclose(f));
+        test_reader_write_file(root, "b.conf", "[group1]\nkey1 = foo\n");
+
+        {
+                _c_cleanup_(c_ini_reader_freep) CIniReader *reader = NULL;
+
+                r = c_ini_reader_new(&reader);
+                c_assert(!r);
+                r = c_ini_reader_feed_path(reader, a);
+                c_assert(!r);
+                r = c_ini_reader_feed_path(reader, b);
+                c_assert(!r);
+                r = c_ini_reader_seal(reader, &domain);
+                c_assert(!r);
+        }
+
+        r = c_ini_domain_write_cache(domain, cache, sources);
+        c_assert(!r);
+
+        /* a fresh cache behaves like the parsed domain */
+        {
+                _c_cleanup_(c_ini_domain_unrefp) CIniDomain *cached = NULL;
+                _c_cleanup_(c_ini_domain_unrefp) CIniDomain *recached = NULL;
+                _c_cleanup_(c_ini_entry_unrefp) CIniEntry *entry = NULL;
+
+                r = c_ini_domain_load_cache(&cached, cache, sources);
+                c_assert(!r);
+                test_reader_assert_equal(domain, cached);
+                test_reader_assert_lookups_equal(domain, cached);
+
+                /* caches can be written from cached domains */
+                r = c_ini_domain_write_cache(cached, recache, NULL);
+                c_assert(!r);
+                r = c_ini_domain_load_cache(&recached, recache, NULL);
+                c_assert(!r);
+                test_reader_assert_equal(domain, recached);
+
+                /* the mapping stays valid after the file is replaced */
+                entry = c_ini_entry_ref(c_ini_group_iterate(c_ini_domain_find(cached, "group1", -1)));
+                c_assert(entry);
+                cached = c_ini_domain_unref(cached);
+                r = c_ini_domain_write_cache(domain, cache, sources);
+                c_assert(!r);
+                c_assert(c_ini_entry_get_key(entry, NULL));
+        }
+
+        /* corrupted frozen blocks are refused */
+        {
+                _c_cleanup_(c_ini_domain_unrefp) CIniDomain *cached = NULL;
+                _c_cleanup_(c_freep) uint8_t *pristine = NULL, *data = NULL;
+                CIniCacheHeader *header;
+                CIniFrozenGroup *group;
+                CIniFrozenEntry *entry;
+                CIniFrozen *frozen;
+                uint32_t *index;
+                struct stat st;
+                size_t n_data;
+
+                c_assert(!stat(recache, &st));
+                n_data = st.st_size;
+                pristine = malloc(n_data);
+                c_assert(pristine);
+                data = malloc(n_data);
+                c_assert(data);
+                f = fopen(recache, "re");
+                c_assert(f);
+                c_assert(fread(pristine, 1, n_data, f) == n_data);
+                c_assert(!fclose(f));
+
+                c_memcpy(data, pristine, n_data);
+                header = (CIniCacheHeader *)data;
+                frozen = (CIniFrozen *)(data + header->frozen);
+                group = (CIniFrozenGroup *)((uint8_t *)frozen + frozen->groups);
+                entry = (CIniFrozenEntry *)((uint8_t *)frozen + frozen->entries);
+                c_assert(frozen->n_groups > 2 && frozen->n_entries > 1);
+
+                /* strings beyond the block */
+                entry->key = frozen->n_size;
+                test_reader_assert_corrupt(recache, data, n_data);
+                c_memcpy(data, pristine, n_data);
+                entry->n_value = frozen->n_size;
+                test_reader_assert_corrupt(recache, data, n_data);
+                c_memcpy(data, pristine, n_data);
+
+                /* strings without terminator */
+                ++group[1].n_label;
+                test_reader_assert_corrupt(recache, data, n_data);
+                c_memcpy(data, pristine, n_data);
+
+                /* live reference counters */
+                entry->n_refs = 1;
+                test_reader_assert_corrupt(recache, data, n_data);
+                c_memcpy(data, pristine, n_data);
+                group[1].n_refs = 1;
+                test_reader_assert_corrupt(recache, data, n_data);
+                c_memcpy(data, pristine, n_data);
+
+                /* entry ranges beyond the entry array, or not covering it */
+                group[1].n_entries = UINT32_MAX;
+                test_reader_assert_corrupt(recache, data, n_data);
+                c_memcpy(data, pristine, n_data);
+                ++group[frozen->n_groups - 1].i_entry;
+                test_reader_assert_corrupt(recache, data, n_data);
+                c_memcpy(data, pristine, n_data);
+
+                /* entries claiming a foreign group */
+                entry->i_group = frozen->n_groups;
+                test_reader_assert_corrupt(recache, data, n_data);
+                c_memcpy(data, pristine, n_data);
+
+                /* index slots out of range, or out of order */
+                index = (uint32_t *)((uint8_t *)frozen + frozen->index_entries);
+                index[0] = frozen->n_entries;
+                test_reader_assert_corrupt(recache, data, n_data);
+                c_memcpy(data, pristine, n_data);
+                index = (uint32_t *)((uint8_t *)frozen + frozen->index_groups);
+                index[0] = 0;
+                test_reader_assert_corrupt(recache, data, n_data);
+                c_memcpy(data, pristine, n_data);
+                index[0] = index[1];
+                test_reader_assert_corrupt(recache, data, n_data);
+                c_memcpy(data, pristine, n_data);
+
+                /* truncated files */
+                test_reader_assert_corrupt(recache, data, n_data - 1);
+                test_reader_assert_corrupt(recache, data, header->frozen + sizeof(*frozen));
+
+                /* the pristine copy is still accepted */
+                f = fopen(recache, "we");
+                c_assert(f);
+                c_assert(fwrite(pristine, 1, n_data, f) == n_data);
+                c_assert(!fclose(f));
+                r = c_ini_domain_load_cache(&cached, recache, NULL);
+                c_assert(!r);
+                test_reader_assert_equal(domain, cached);
+        }
+
+        /* the source list must match */
+        r = c_ini_domain_load_cache(&domain, cache, reversed);
+        c_assert(r == -ESTALE);
+        r = c_ini_domain_load_cache(&domain, cache, partial);
+        c_assert(r == -ESTALE);
+        r = c_ini_domain_load_cache(&domain, cache, NULL);
+        c_assert(r == -ESTALE);
+
+        /* touching a file without changing it keeps the cache valid */
+        c_assert(!utimensat(AT_FDCWD, a, ts, 0));
+        {
+                _c_cleanup_(c_ini_domain_unrefp) CIniDomain *cached = NULL;
+
+                r = c_ini_domain_load_cache(&cached, cache, sources);
+                c_assert(!r);
+        }
+
+        /* changing the content invalidates the cache, even with equal size */
+        test_reader_write_file(root, "b.conf", "[group1]\nkey1 = bar\n");
+        c_assert(!utimensat(AT_FDCWD, b, ts, 0));
+        r = c_ini_domain_load_cache(&domain, cache, sources);
+        c_assert(r == -ESTALE);
+
+        /* and so does removing a source */
+        c_assert(!unlink(b));
+        r = c_ini_domain_load_cache(&domain, cache, sources);
+        c_assert(r == -ESTALE);
+
+        /* invalid caches are refused */
+        test_reader_write_file(root, "cache", "[group]\nkey = value\n");
+        r = c_ini_domain_load_cache(&domain, cache, NULL);
+        c_assert(r == -EBADMSG);
+
+        c_assert(!unlink(a));
+        c_assert(!unlink(cache));
+        c_assert(!unlink(recache));
+        c_assert(!rmdir(root));
+}
+
+static void test_reader_write(void) {
+        _c_cleanup_(c_ini_domain_unrefp) CIniDomain *domain = NULL;
+        _c_cleanup_(c_freep) char *input = NULL, *output = NULL;
+        size_t n_input, n_output;
+        int r;
+
+        input = test_reader_generate(256 * 1024, &n_input);
+
+        /* the output reproduces the input exactly */
+        {
+                _c_cleanup_(c_freep) char *stream = NULL;
+                size_t n_stream = 0;
+                char buffer[4096];
+                ssize_t l;
+                FILE *f;
+                int fd;
+
+                r = c_ini_reader_parse(&domain, 0, (const uint8_t *)input, n_input);
+                c_assert(!r);
+
+                r = c_ini_domain_write(domain, &output, &n_output);
+                c_assert(!r);
+                c_assert(n_output == n_input && !memcmp(output, input, n_input));
+                c_assert(!output[n_output]);
+
+                f = open_memstream(&stream, &n_stream);
+                c_assert(f);
+                r = c_ini_domain_write_file(domain, f);
+                c_assert(!r);
+                c_assert(!fclose(f));
+                c_assert(n_stream == n_input && !memcmp(stream, input, n_input));
+
+                f = tmpfile();
+                c_assert(f);
+                fd = fileno(f);
+                r = c_ini_domain_write_fd(domain, fd);
+                c_assert(!r);
+                c_assert(lseek(fd, 0, SEEK_SET) == 0);
+                for (n_stream = 0; (l = read(fd, buffer, sizeof(buffer))) > 0; n_stream += l)
+                        c_assert(!memcmp(buffer, input + n_stream, l));
+                c_assert(!l && n_stream == n_input);
+                c_assert(!fclose(f));
+
+                domain = c_ini_domain_unref(domain);
+                output = c_free(output);
+        }
+
+        /* unterminated last lines of a source are terminated */
+        {
+                _c_cleanup_(c_ini_reader_freep) CIniReader *reader = NULL;
+
+                r = c_ini_reader_new(&reader);
+                c_assert(!r);
+                r = c_ini_reader_feed(reader, (const uint8_t *)"# a\n[A]\nx = 1", 13);
+                c_assert(!r);
+                r = c_ini_reader_flush(reader);
+                c_assert(!r);
+                r = c_ini_reader_feed(reader, (const uint8_t *)"[B]\ny", 5);
+                c_assert(!r);
+                r = c_ini_reader_seal(reader, &domain);
+                c_assert(!r);
+
+                r = c_ini_domain_write(domain, &output, &n_output);
+                c_assert(!r);
+                c_assert(!strcmp(output, "# a\n[A]\nx = 1\n[B]\ny"));
+
+                domain = c_ini_domain_unref(domain);
+                output = c_free(output);
+        }
+
+        /* frozen domains are written in canonical form */
+        {
+                _c_cleanup_(c_ini_domain_unrefp) CIniDomain *frozen = NULL;
+                _c_cleanup_(c_ini_domain_unrefp) CIniDomain *reparsed = NULL;
+
+                r = c_ini_reader_parse(&domain, 0, (const uint8_t *)input, n_input);
+                c_assert(!r);
+                r = c_ini_domain_freeze(domain, &frozen);
+                c_assert(!r);
+
+                r = c_ini_domain_write(frozen, &output, &n_output);
+                c_assert(!r);
+                r = c_ini_reader_parse(&reparsed,
+                                       C_INI_MODE_KEEP_DUPLICATE_GROUPS |
+                                       C_INI_MODE_KEEP_DUPLICATE_ENTRIES,
+                                       (const uint8_t *)output,
+                                       n_output);
+                c_assert(!r);
+                test_reader_assert_equal(frozen, reparsed);
+        }
+}
+
+static void test_reader_assert_arenas(CIniDomain *domain, CIniArena *previous) {
+        CIniGroup *group;
+        CIniEntry *entry;
+
+        /* objects are either new, or reused from the direct predecessor */
+        for (entry = c_ini_group_iterate(domain->null_group); entry; entry = c_ini_entry_next(entry))
+                c_assert(entry->arena == domain->arena || entry->arena == previous);
+
+        for (group = c_ini_domain_iterate(domain); group; group = c_ini_group_next(group)) {
+                c_assert(group->arena == domain->arena || group->arena == previous);
+                for (entry = c_ini_group_iterate(group); entry; entry = c_ini_entry_next(entry))
+                        c_assert(entry->arena == domain->arena || entry->arena == previous);
+        }
+}
+
+static void test_reader_reuse(void) {
+        const unsigned int modes[] = {
+                0,
+                C_INI_MODE_EXTENDED_WHITESPACE,
+                C_INI_MODE_MERGE_GROUPS,
+                C_INI_MODE_KEEP_DUPLICATE_GROUPS | C_INI_MODE_KEEP_DUPLICATE_ENTRIES,
+                C_INI_MODE_MERGE_GROUPS | C_INI_MODE_OVERRIDE_ENTRIES | C_INI_MODE_HASH_INDEX,
+        };
+        _c_cleanup_(c_freep) char *input = NULL, *changed = NULL;
+        size_t i, j, n_input;
+        int r;
+
+        /*
+         * Parse the input, then parse a modified copy while reusing the
+         * previous domain. The result must match a fresh parse of the
+         * modified copy.
+         */
+
+        input = test_reader_generate(256 * 1024, &n_input);
+        changed = malloc(n_input);
+        c_assert(changed);
+        c_memcpy(changed, input, n_input);
+        for (i = 4096; i < n_input; i += 8191)
+                if (changed[i] != '\n' && changed[i] != '[' && changed[i] != ']')
+                        changed[i] = 'X';
+
+        for (i = 0; i < sizeof(modes) / sizeof(*modes); ++i) {
+                _c_cleanup_(c_ini_domain_unrefp) CIniDomain *fresh = NULL;
+                _c_cleanup_(c_ini_domain_unrefp) CIniDomain *domain = NULL;
+                _c_cleanup_(c_ini_reader_freep) CIniReader *reader = NULL;
+                CIniGroup *group;
+                CIniEntry *reused;
+                bool moved;
+
+                r = c_ini_reader_parse(&fresh, modes[i], (const uint8_t *)changed, n_input);
+                c_assert(!r);
+
+                r = c_ini_reader_new(&reader);
+                c_assert(!r);
+                c_ini_reader_set_mode(reader, modes[i]);
+
+                for (j = 0; j < 4; ++j) {
+                        _c_cleanup_(c_ini_arena_unrefp) CIniArena *arena = NULL;
+                        const char *data = j % 2 ? changed : input;
+
+                        /*
+                         * Unchanged lines keep their objects, unless those
+                         * were reused from an older domain already.
+                         */
+                        group = domain ? c_ini_domain_iterate(domain) : NULL;
+                        reused = group ? c_ini_group_iterate(group) : NULL;
+                        moved = reused && reused->arena == domain->arena;
+                        arena = domain ? c_ini_arena_ref(domain->arena) : NULL;
+
+                        c_ini_reader_reuse(reader, domain);
+                        domain = c_ini_domain_unref(domain);
+
+                        r = c_ini_reader_feed(reader, (const uint8_t *)data, n_input / 2);
+                        c_assert(!r);
+                        r = c_ini_reader_feed(reader, (const uint8_t *)data + n_input / 2, n_input - n_input / 2);
+                        c_assert(!r);
+                        r = c_ini_reader_seal(reader, &domain);
+                        c_assert(!r);
+
+                        group = c_ini_domain_iterate(domain);
+                        if (moved)
+                                c_assert(reused == c_ini_group_iterate(group));
+                        else if (reused)
+                                c_assert(c_ini_group_iterate(group)->arena == domain->arena);
+
+                        test_reader_assert_arenas(domain, arena);
+                }
+
+                test_reader_assert_equal(fresh, domain);
+                test_reader_assert_lookups_equal(fresh, domain);
+        }
+
+        /* domains still referenced elsewhere are left untouched, and nothing is reused */
+        {
+                _c_cleanup_(c_ini_domain_unrefp) CIniDomain *previous = NULL;
+                _c_cleanup_(c_ini_domain_unrefp) CIniDomain *domain = NULL;
+                _c_cleanup_(c_ini_domain_unrefp) CIniDomain *fresh = NULL;
+                _c_cleanup_(c_ini_reader_freep) CIniReader *reader = NULL;
+
+                r = c_ini_reader_parse(&previous, 0, (const uint8_t *)input, n_input);
+                c_assert(!r);
+                r = c_ini_reader_parse(&fresh, 0, (const uint8_t *)input, n_input);
+                c_assert(!r);
+
+                r = c_ini_reader_new(&reader);
+                c_assert(!r);
+                c_ini_reader_reuse(reader, previous);
+                r = c_ini_reader_feed(reader, (const uint8_t *)changed, n_input);
+                c_assert(!r);
+                r = c_ini_reader_seal(reader, &domain);
+                c_assert(!r);
+
+                test_reader_assert_equal(fresh, previous);
+                test_reader_assert_arenas(domain, NULL);
+        }
+
+        /* parallel feeds fall back to the serial reader to reuse objects */
+        {
+                _c_cleanup_(c_ini_domain_unrefp) CIniDomain *domain = NULL;
+                _c_cleanup_(c_ini_domain_unrefp) CIniDomain *fresh = NULL;
+                _c_cleanup_(c_ini_reader_freep) CIniReader *reader = NULL;
+                CIniEntry *reused;
+
+                r = c_ini_reader_parse(&domain, 0, (const uint8_t *)input, n_input);
+                c_assert(!r);
+                r = c_ini_reader_parse(&fresh, 0, (const uint8_t *)changed, n_input);
+                c_assert(!r);
+
+                reused = c_ini_group_iterate(c_ini_domain_iterate(domain));
+
+                r = c_ini_reader_new(&reader);
+                c_assert(!r);
+                c_ini_reader_reuse(reader, domain);
+                domain = c_ini_domain_unref(domain);
+                r = c_ini_reader_feed_parallel(reader, (const uint8_t *)changed, n_input, 4);
+                c_assert(!r);
+                r = c_ini_reader_seal(reader, &domain);
+                c_assert(!r);
+
+                c_assert(reused == c_ini_group_iterate(c_ini_domain_iterate(domain)));
+                test_reader_assert_equal(fresh, domain);
+        }
+}
+
+static int test_reader_diff_count(unsigned int event,
+                                  CIniGroup *old_group,
+                                  CIniEntry *old_entry,
+                                  CIniGroup *new_group,
+                                  CIniEntry *new_entry,
+                                  void *userdata) {
+        size_t *counts = userdata;
+
+        c_assert(event <= C_INI_DIFF_ENTRY_CHANGED);
+        c_assert(!!old_group == (event != C_INI_DIFF_GROUP_ADDED));
+        c_assert(!!new_group == (event != C_INI_DIFF_GROUP_REMOVED));
+        c_assert(!!old_entry == (event == C_INI_DIFF_ENTRY_REMOVED || event == C_INI_DIFF_ENTRY_CHANGED));
+        c_assert(!!new_entry == (event == C_INI_DIFF_ENTRY_ADDED || event == C_INI_DIFF_ENTRY_CHANGED));
+
+        ++counts[event];
+        return 0;
+}
+
+static void test_reader_diff_naive_groups(CIniGroup *old_group, CIniGroup *new_group, size_t *counts) {
+        CIniEntry *old_entry, *new_entry;
+        const char *key, *a, *b;
+        size_t n_key, n_a, n_b;
+
+        for (old_entry = c_ini_group_iterate(old_group); old_entry; old_entry = c_ini_entry_next(old_entry)) {
+                key = c_ini_entry_get_key(old_entry, &n_key);
+                if (c_ini_group_find(old_group, key, n_key) != old_entry)
+                        continue;
+
+                new_entry = c_ini_group_find(new_group, key, n_key);
+                if (!new_entry) {
+                        ++counts[C_INI_DIFF_ENTRY_REMOVED];
+                        continue;
+                }
+
+                a = c_ini_entry_get_value(old_entry, &n_a);
+                b = c_ini_entry_get_value(new_entry, &n_b);
+                if (n_a != n_b || memcmp(a, b, n_a))
+                        ++counts[C_INI_DIFF_ENTRY_CHANGED];
+        }
+
+        for (new_entry = c_ini_group_iterate(new_group); new_entry; new_entry = c_ini_entry_next(new_entry)) {
+                key = c_ini_entry_get_key(new_entry, &n_key);
+                if (c_ini_group_find(new_group, key, n_key) == new_entry &&
+                    !c_ini_group_find(old_group, key, n_key))
+                        ++counts[C_INI_DIFF_ENTRY_ADDED];
+        }
+}
+
+static void test_reader_diff_naive(CIniDomain *old_domain, CIniDomain *new_domain, size_t *counts) {
+        CIniGroup *old_group, *new_group;
+        const char *label;
+        size_t n_label;
+
+        test_reader_diff_naive_groups(c_ini_domain_get_null_group(old_domain),
+                                      c_ini_domain_get_null_group(new_domain),
+                                      counts);
+
+        for (old_group = c_ini_domain_iterate(old_domain); old_group; old_group = c_ini_group_next(old_group)) {
+                label = c_ini_group_get_label(old_group, &n_label);
+                if (c_ini_domain_find(old_domain, label, n_label) != old_group)
+                        continue;
+
+                new_group = c_ini_domain_find(new_domain, label, n_label);
+                if (new_group)
+                        test_reader_diff_naive_groups(old_group, new_group, counts);
+                else
+                        ++counts[C_INI_DIFF_GROUP_REMOVED];
+        }
+
+        for (new_group = c_ini_domain_iterate(new_domain); new_group; new_group = c_ini_group_next(new_group)) {
+                label = c_ini_group_get_label(new_group, &n_label);
+                if (c_ini_domain_find(new_domain, label, n_label) == new_group &&
+                    !c_ini_domain_find(old_domain, label, n_label))
+                        ++counts[C_INI_DIFF_GROUP_ADDED];
+        }
+}
+
+static void test_reader_diff(void) {
+        const unsigned int modes[] = {
+                0,
+                C_INI_MODE_MERGE_GROUPS | C_INI_MODE_OVERRIDE_ENTRIES,
+                C_INI_MODE_KEEP_DUPLICATE_GROUPS | C_INI_MODE_KEEP_DUPLICATE_ENTRIES,
+        };
+        _c_cleanup_(c_freep) char *input = NULL, *changed = NULL;
+        size_t i, n_input;
+        int r;
+
+        input = test_reader_generate(256 * 1024, &n_input);
+        changed = malloc(n_input);
+        c_assert(changed);
+        c_memcpy(changed, input, n_input);
+        for (i = 1024; i < n_input; i += 4093)
+                if (changed[i] != '\n')
+                        changed[i] = 'X';
+
+        for (i = 0; i < sizeof(modes) / sizeof(*modes); ++i) {
+                _c_cleanup_(c_ini_domain_unrefp) CIniDomain *a = NULL, *b = NULL;
+                _c_cleanup_(c_ini_domain_unrefp) CIniDomain *frozen_a = NULL, *frozen_b = NULL;
+                size_t expected[C_INI_DIFF_ENTRY_CHANGED + 1] = {};
+                size_t counts[C_INI_DIFF_ENTRY_CHANGED + 1] = {};
+                size_t frozen_counts[C_INI_DIFF_ENTRY_CHANGED + 1] = {};
+                size_t none[C_INI_DIFF_ENTRY_CHANGED + 1] = {};
+
+                r = c_ini_reader_parse(&a, modes[i], (const uint8_t *)input, n_input);
+                c_assert(!r);
+                r = c_ini_reader_parse(&b, modes[i], (const uint8_t *)changed, n_input);
+                c_assert(!r);
+                r = c_ini_domain_freeze(a, &frozen_a);
+                c_assert(!r);
+                r = c_ini_domain_freeze(b, &frozen_b);
+                c_assert(!r);
+
+                test_reader_diff_naive(a, b, expected);
+                c_assert(expected[C_INI_DIFF_ENTRY_CHANGED] > 0);
+
+                r = c_ini_domain_diff(a, b, test_reader_diff_count, counts);
+                c_assert(!r);
+                c_assert(!memcmp(counts, expected, sizeof(counts)));
+
+                r = c_ini_domain_diff(frozen_a, b, test_reader_diff_count, frozen_counts);
+                c_assert(!r);
+                c_assert(!memcmp(frozen_counts, expected, sizeof(counts)));
+
+                r = c_ini_domain_diff(a, frozen_a, test_reader_diff_count, none);
+                c_assert(!r);
+                r = c_ini_domain_diff(b, b, test_reader_diff_count, none);
+                c_assert(!r);
+                c_assert(!memcmp(none, (size_t[C_INI_DIFF_ENTRY_CHANGED + 1]){}, sizeof(none)));
+        }
+
+        /* explicit changes */
+        {
+                _c_cleanup_(c_ini_domain_unrefp) CIniDomain *a = NULL, *b = NULL;
+                const char *old_input = "k=v\n[A]\nx=1\ny=2\n[B]\nz=3\n";
+                const char *new_input = "k=w\n[A]\nx=1\ny=3\nq=4\n[C]\n";
+                size_t counts[C_INI_DIFF_ENTRY_CHANGED + 1] = {};
+
+                r = c_ini_reader_parse(&a, 0, (const uint8_t *)old_input, strlen(old_input));
+                c_assert(!r);
+                r = c_ini_reader_parse(&b, 0, (const uint8_t *)new_input, strlen(new_input));
+                c_assert(!r);
+
+                r = c_ini_domain_diff(a, b, test_reader_diff_count, counts);
+                c_assert(!r);
+                c_assert(counts[C_INI_DIFF_GROUP_ADDED] == 1);
+                c_assert(counts[C_INI_DIFF_GROUP_REMOVED] == 1);
+                c_assert(counts[C_INI_DIFF_ENTRY_ADDED] == 1);
+                c_assert(counts[C_INI_DIFF_ENTRY_REMOVED] == 0);
+                c_assert(counts[C_INI_DIFF_ENTRY_CHANGED] == 2);
+
+                /* value hashes are cached, and do not change the result */
+                c_assert(c_ini_group_find(c_ini_domain_find(a, "A", -1), "x", -1)->value_hash);
+                c_assert(c_ini_group_find(c_ini_domain_find(a, "A", -1), "x", -1)->value_hash ==
+                         c_ini_group_find(c_ini_domain_find(b, "A", -1), "x", -1)->value_hash);
+                c_assert(c_ini_group_find(c_ini_domain_find(a, "A", -1), "y", -1)->value_hash !=
+                         c_ini_group_find(c_ini_domain_find(b, "A", -1), "y", -1)->value_hash);
+
+                memset(counts, 0, sizeof(counts));
+                r = c_ini_domain_diff(a, b, test_reader_diff_count, counts);
+                c_assert(!r);
+                c_assert(counts[C_INI_DIFF_ENTRY_CHANGED] == 2);
+        }
+}
+
+static const char *test_reader_watch_value(CIniSnapshot *snapshot, const char *label) {
+        CIniGroup *group;
+        CIniEntry *entry;
+
+        group = c_ini_domain_find(c_ini_snapshot_get_domain(snapshot), label, -1);
+        if (!group)
+                return NULL;
+
+        entry = c_ini_group_find(group, "k", -1);
+        c_assert(entry);
+        return c_ini_entry_get_value(entry, NULL);
+}
+
+static void test_reader_watch(void) {
+        _c_cleanup_(c_ini_watch_freep) CIniWatch *watch = NULL;
+        _c_cleanup_(c_ini_snapshot_releasep) CIniSnapshot *first = NULL;
+        _c_cleanup_(c_ini_snapshot_releasep) CIniSnapshot *second = NULL;
+        char root[] = "/tmp/test-c-ini-XXXXXX", a[4096], b[4096], d[4096], sub[4096], tmp[4096];
+        const char *paths[] = { a, b, d, NULL };
+        CIniSnapshot *snapshot;
+        int r;
+
+        c_assert(mkdtemp(root));
+        snprintf(a, sizeof(a), "%s/a.conf", root);
+        snprintf(b, sizeof(b), "%s/b.conf", root);
+        snprintf(d, sizeof(d), "%s/sub/d.conf", root);
+        snprintf(sub, sizeof(sub), "%s/sub", root);
+        snprintf(tmp, sizeof(tmp), "%s/b.tmp", root);
+
+        /* missing files, and missing parent directories, are treated as empty */
+        test_reader_write_file(root, "a.conf", "[g]\nk=1\n");
+        r = c_ini_watch_new(&watch, 0, paths);
+        c_assert(!r);
+        c_assert(c_ini_watch_get_fd(watch) >= 0);
+
+        first = c_ini_watch_acquire(watch);
+        c_assert(!strcmp(test_reader_watch_value(first, "g"), "1"));
+        c_assert(!test_reader_watch_value(first, "h"));
+
+        r = c_ini_watch_dispatch(watch);
+        c_assert(!r);
+
+        /* modifications publish a new snapshot, old ones stay intact */
+        test_reader_write_file(root, "a.conf", "[g]\nk=2\n");
+        r = c_ini_watch_dispatch(watch);
+        c_assert(r == 1);
+
+        second = c_ini_watch_acquire(watch);
+        c_assert(second != first);
+        c_assert(!strcmp(test_reader_watch_value(second, "g"), "2"));
+        c_assert(!strcmp(test_reader_watch_value(first, "g"), "1"));
+        second = c_ini_snapshot_release(second);
+
+        /* unrelated files in the same directory are ignored */
+        test_reader_write_file(root, "c.conf", "[g]\nk=3\n");
+        r = c_ini_watch_dispatch(watch);
+        c_assert(!r);
+
+        /* files that are created atomically are picked up */
+        test_reader_write_file(root, "b.tmp", "[h]\nk=4\n");
+        c_assert(!rename(tmp, b));
+        r = c_ini_watch_dispatch(watch);
+        c_assert(r == 1);
+
+        snapshot = c_ini_watch_acquire(watch);
+        c_assert(!strcmp(test_reader_watch_value(snapshot, "g"), "2"));
+        c_assert(!strcmp(test_reader_watch_value(snapshot, "h"), "4"));
+        c_ini_snapshot_release(snapshot);
+
+        /* and so are removals */
+        c_assert(!unlink(b));
+        r = c_ini_watch_dispatch(watch);
+        c_assert(r == 1);
+
+        snapshot = c_ini_watch_acquire(watch);
+        c_assert(!test_reader_watch_value(snapshot, "h"));
+        c_ini_snapshot_release(snapshot);
+
+        /* parent directories that show up later are watched */
+        c_assert(!mkdir(sub, 0755));
+        r = c_ini_watch_dispatch(watch);
+        c_assert(r == 1);
+
+        test_reader_write_file(root, "sub/d.conf", "[i]\nk=5\n");
+        r = c_ini_watch_dispatch(watch);
+        c_assert(r == 1);
+
+        snapshot = c_ini_watch_acquire(watch);
+        c_assert(!strcmp(test_reader_watch_value(snapshot, "i"), "5"));
+        c_ini_snapshot_release(snapshot);
+
+        /* and so are parent directories that are removed and created again */
+        c_assert(!unlink(d));
+        c_assert(!rmdir(sub));
+        r = c_ini_watch_dispatch(watch);
+        c_assert(r == 1);
+
+        snapshot = c_ini_watch_acquire(watch);
+        c_assert(!test_reader_watch_value(snapshot, "i"));
+        c_ini_snapshot_release(snapshot);
+
+        c_assert(!mkdir(sub, 0755));
+        r = c_ini_watch_dispatch(watch);
+        c_assert(r == 1);
+
+        test_reader_write_file(root, "sub/d.conf", "[i]\nk=6\n");
+        r = c_ini_watch_dispatch(watch);
+        c_assert(r == 1);
+
+        snapshot = c_ini_watch_acquire(watch);
+        c_assert(!strcmp(test_reader_watch_value(snapshot, "i"), "6"));
+        c_ini_snapshot_release(snapshot);
+
+        /* snapshots outlive their watch */
+        watch = c_ini_watch_free(watch);
+        c_assert(!strcmp(test_reader_watch_value(first, "g"), "1"));
+
+        snprintf(tmp, sizeof(tmp), "%s/c.conf", root);
+        c_assert(!unlink(a));
+        c_assert(!unlink(d));
+        c_assert(!unlink(tmp));
+        c_assert(!rmdir(sub));
+        c_assert(!rmdir(root));
+}
+
+static int test_reader_callbacks_group(const char *label, size_t n_label, void *userdata) {
+        fprintf(userdata, "[%.*s]\n", (int)n_label, label);
+        return 0;
+}
+
+static int test_reader_callbacks_entry(const char *key, size_t n_key, const char *value, size_t n_value, void *userdata) {
+        fprintf(userdata, "<%.*s>=<%.*s>\n", (int)n_key, key, (int)n_value, value);
+        return 0;
+}
+
+static int test_reader_callbacks_comment(const char *comment, size_t n_comment, void *userdata) {
+        fprintf(userdata, "#<%.*s>\n", (int)n_comment, comment);
+        return 0;
+}
+
+static int test_reader_callbacks_malformed(const char *line, size_t n_line, void *userdata) {
+        fprintf(userdata, "!<%.*s>\n", (int)n_line, line);
+        return 0;
+}
+
+static int test_reader_callbacks_abort(const char *key, size_t n_key, const char *value, size_t n_value, void *userdata) {
+        return -ENOTRECOVERABLE;
+}
+
+static int test_reader_callbacks_positive(const char *key, size_t n_key, const char *value, size_t n_value, void *userdata) {
+        return C_INI_E_LIMIT;
+}
+
+static char *test_reader_callbacks_run(const CIniCallbacks *callbacks,
+                                       unsigned int mode,
+                                       const char *data,
+                                       size_t n_data,
+                                       size_t n_chunk) {
+        _c_cleanup_(c_ini_reader_freep) CIniReader *reader = NULL;
+        CIniDomain *domain;
+        char *record = NULL;
+        size_t n_record, n;
+        FILE *f;
+        int r;
+
+        f = open_memstream(&record, &n_record);
+        c_assert(f);
+
+        r = c_ini_reader_new(&reader);
+        c_assert(!r);
+        c_ini_reader_set_mode(reader, mode);
+        c_ini_reader_set_callbacks(reader, callbacks, f);
+
+        for ( ; n_data; data += n, n_data -= n) {
+                n = c_min(n_data, n_chunk);
+                r = c_ini_reader_feed(reader, (const uint8_t *)data, n);
+                c_assert(!r);
+        }
+
+        /* no domain is built */
+        r = c_ini_reader_seal(reader, &domain);
+        c_assert(!r);
+        c_assert(!domain);
+
+        c_assert(!fclose(f));
+        return record;
+}
+
+static char *test_reader_callbacks_replay(unsigned int mode, const char *data, size_t n_data) {
+        CIniDomain *domain;
+        CIniGroup *group;
+        CIniEntry *entry;
+        char *record = NULL;
+        const char *k, *v;
+        size_t n_record, n_k, n_v;
+        FILE *f;
+        int r;
+
+        /*
+         * Replay the groups and entries of a domain that keeps all
+         * duplicates, which must match the callbacks of a serial parse.
+         */
+
+        r = c_ini_reader_parse(&domain,
+                               mode | C_INI_MODE_KEEP_DUPLICATE_GROUPS | C_INI_MODE_KEEP_DUPLICATE_ENTRIES,
+                               (const uint8_t *)data,
+                               n_data);
+        c_assert(!r);
+
+        f = open_memstream(&record, &n_record);
+        c_assert(f);
+
+        group = c_ini_domain_get_null_group(domain);
+        do {
+                if (group != c_ini_domain_get_null_group(domain)) {
+                        k = c_ini_group_get_label(group, &n_k);
+                        test_reader_callbacks_group(k, n_k, f);
+                }
+
+                for (entry = c_ini_group_iterate(group); entry; entry = c_ini_entry_next(entry)) {
+                        k = c_ini_entry_get_key(entry, &n_k);
+                        v = c_ini_entry_get_value(entry, &n_v);
+                        test_reader_callbacks_entry(k, n_k, v, n_v, f);
+                }
+
+                group = group == c_ini_domain_get_null_group(domain) ?
+                        c_ini_domain_iterate(domain) : c_ini_group_next(group);
+        } while (group);
+
+        c_assert(!fclose(f));
+        c_ini_domain_unref(domain);
+        return record;
+}
+
+static void test_reader_callbacks(void) {
+        static const char input[] = "k0=v0\n"
+                                    "[g]\n"
+                                    "k = v\n"
+                                    "# c\n"
+                                    "\n"
+                                    "bad\n"
+                                    " [x] \r\n"
+                                    " k2\t=\tv2\r\n"
+                                    "[g]\n"
+                                    "k=dup";
+        static const CIniCallbacks all = {
+                .group = test_reader_callbacks_group,
+                .entry = test_reader_callbacks_entry,
+                .comment = test_reader_callbacks_comment,
+                .malformed = test_reader_callbacks_malformed,
+        };
+        static const CIniCallbacks some = {
+                .group = test_reader_callbacks_group,
+                .entry = test_reader_callbacks_entry,
+        };
+        static const CIniCallbacks abort = {
+                .entry = test_reader_callbacks_abort,
+        };
+        static const CIniCallbacks positive = {
+                .entry = test_reader_callbacks_positive,
+        };
+        _c_cleanup_(c_freep) char *data = NULL;
+        CIniReader *reader;
+        CIniDomain *domain;
+        char *a, *b;
+        size_t n_data;
+        int r;
+
+        /* lines are classified exactly like for domains */
+        a = test_reader_callbacks_run(&all, 0, input, strlen(input), SIZE_MAX);
+        c_assert(!strcmp(a,
+                         "<k0>=<v0>\n"
+                         "[g]\n"
+                         "<k>=<v>\n"
+                         "#< c>\n"
+                         "!<bad>\n"
+                         "!< [x] \r>\n"
+                         "< k2\t>=<\tv2\r>\n"
+                         "[g]\n"
+                         "<k>=<dup>\n"));
+        free(a);
+
+        a = test_reader_callbacks_run(&all, C_INI_MODE_EXTENDED_WHITESPACE, input, strlen(input), 3);
+        c_assert(!strcmp(a,
+                         "<k0>=<v0>\n"
+                         "[g]\n"
+                         "<k>=<v>\n"
+                         "#< c>\n"
+                         "!<bad>\n"
+                         "[x]\n"
+                         "<k2>=<v2>\n"
+                         "[g]\n"
+                         "<k>=<dup>\n"));
+        free(a);
+
+        /* any chunking reports the same groups and entries as a domain */
+        data = test_reader_generate(256 * 1024, &n_data);
+        a = test_reader_callbacks_run(&some, 0, data, n_data, 7);
+        b = test_reader_callbacks_replay(0, data, n_data);
+        c_assert(!strcmp(a, b));
+        free(a);
+        free(b);
+
+        a = test_reader_callbacks_run(&some, C_INI_MODE_EXTENDED_WHITESPACE, input, strlen(input), 1);
+        b = test_reader_callbacks_replay(C_INI_MODE_EXTENDED_WHITESPACE, input, strlen(input));
+        c_assert(!strcmp(a, b));
+        free(a);
+        free(b);
+
+        /* callbacks abort parsing */
+        r = c_ini_reader_new(&reader);
+        c_assert(!r);
+        c_ini_reader_set_callbacks(reader, &abort, NULL);
+        r = c_ini_reader_feed(reader, (const uint8_t *)input, strlen(input));
+        c_assert(r == -ENOTRECOVERABLE);
+        c_ini_reader_free(reader);
+
+        /* positive values cannot be mistaken for codes of the library */
+        r = c_ini_reader_new(&reader);
+        c_assert(!r);
+        c_ini_reader_set_callbacks(reader, &positive, NULL);
+        r = c_ini_reader_feed(reader, (const uint8_t *)input, strlen(input));
+        c_assert(r == C_INI_E_CALLBACK);
+        c_ini_reader_free(reader);
+
+        /* and can be cleared again */
+        r = c_ini_reader_new(&reader);
+        c_assert(!r);
+        c_ini_reader_set_callbacks(reader, &abort, NULL);
+        c_ini_reader_set_callbacks(reader, NULL, NULL);
+        r = c_ini_reader_feed(reader, (const uint8_t *)input, strlen(input));
+        c_assert(!r);
+        r = c_ini_reader_seal(reader, &domain);
+        c_assert(!r);
+        c_assert(domain);
+        c_ini_domain_unref(domain);
+        c_ini_reader_free(reader);
+}
+
+static char *test_reader_tokenize(unsigned int mode, const char *data, size_t n_data, size_t *n_blankp) {
+        CIniTokenizer tokenizer = C_INI_TOKENIZER_NULL(tokenizer);
+        CIniToken token = C_INI_TOKEN_NULL(token);
+        char *record = NULL;
+        size_t n_record, i_line = 0;
+        FILE *f;
+
+        f = open_memstream(&record, &n_record);
+        c_assert(f);
+
+        *n_blankp = 0;
+        c_ini_tokenizer_init(&tokenizer, data, n_data, mode);
+        while (c_ini_tokenizer_next(&tokenizer, &token)) {
+                /* tokens cover the entire input */
+                c_assert(token.i_line == i_line);
+                c_assert(token.n_line);
+                i_line += token.n_line;
+
+                switch (token.type) {
+                case C_INI_TOKEN_BLANK:
+                        ++*n_blankp;
+                        break;
+                case C_INI_TOKEN_COMMENT:
+                        test_reader_callbacks_comment(token.value, token.n_value, f);
+                        break;
+                case C_INI_TOKEN_GROUP:
+                        test_reader_callbacks_group(token.key, token.n_key, f);
+                        break;
+                case C_INI_TOKEN_ENTRY:
+                        test_reader_callbacks_entry(token.key, token.n_key, token.value, token.n_value, f);
+                        break;
+                case C_INI_TOKEN_MALFORMED:
+                        c_assert(data[token.i_line + token.n_line - 1] == '\n' ||
+                                 token.i_line + token.n_line == n_data);
+                        test_reader_callbacks_malformed(data + token.i_line,
+                                                        token.n_line - (data[token.i_line + token.n_line - 1] == '\n'),
+                                                        f);
+                        break;
+                default:
+                        c_assert(0);
+                }
+        }
+
+        c_assert(i_line == n_data);
+        c_assert(!c_ini_tokenizer_next(&tokenizer, &token));
+
+        c_assert(!fclose(f));
+        return record;
+}
+
+static void test_reader_tokenizer(void) {
+        static const CIniCallbacks callbacks = {
+                .group = test_reader_callbacks_group,
+                .entry = test_reader_callbacks_entry,
+                .comment = test_reader_callbacks_comment,
+                .malformed = test_reader_callbacks_malformed,
+        };
+        static const char input[] = "# c\n"
+                                    "\n"
+                                    "[g]\n"
+                                    " \t\r\n"
+                                    "k = v\n"
+                                    "bad";
+        _c_cleanup_(c_freep) char *data = NULL;
+        size_t n_data, n_blank;
+        char *a, *b;
+
+        /* tokens match the lines reported to callbacks in all modes */
+        a = test_reader_tokenize(0, input, strlen(input), &n_blank);
+        b = test_reader_callbacks_run(&callbacks, 0, input, strlen(input), SIZE_MAX);
+        c_assert(!strcmp(a, b));
+        c_assert(!strcmp(a, "#< c>\n[g]\n!< \t\r>\n<k>=<v>\n!<bad>\n"));
+        c_assert(n_blank == 1);
+        free(a);
+        free(b);
+
+        a = test_reader_tokenize(C_INI_MODE_EXTENDED_WHITESPACE, input, strlen(input), &n_blank);
+        b = test_reader_callbacks_run(&callbacks, C_INI_MODE_EXTENDED_WHITESPACE, input, strlen(input), SIZE_MAX);
+        c_assert(!strcmp(a, b));
+        c_assert(n_blank == 2);
+        free(a);
+        free(b);
+
+        data = test_reader_generate(256 * 1024, &n_data);
+        a = test_reader_tokenize(0, data, n_data, &n_blank);
+        b = test_reader_callbacks_run(&callbacks, 0, data, n_data, 4096);
+        c_assert(!strcmp(a, b));
+        c_assert(n_blank > 0);
+        free(a);
+        free(b);
+
+        /* empty input has no tokens */
+        a = test_reader_tokenize(0, "", 0, &n_blank);
+        c_assert(!strcmp(a, ""));
+        c_assert(!n_blank);
+        free(a);
+}
+
+static int test_reader_limit(const CIniLimits *limits, const char *data, size_t n_chunk) {
+        _c_cleanup_(c_ini_reader_freep) CIniReader *reader = NULL;
+        _c_cleanup_(c_ini_domain_unrefp) CIniDomain *domain = NULL;
+        size_t n, n_data = strlen(data);
+        int r;
+
+        r = c_ini_reader_new(&reader);
+        c_assert(!r);
+        c_ini_reader_set_limits(reader, limits);
+
+        for ( ; n_data; data += n, n_data -= n) {
+                n = c_min(n_data, n_chunk);
+                r = c_ini_reader_feed(reader, (const uint8_t *)data, n);
+                if (r)
+                        return r;
+        }
+
+        return c_ini_reader_seal(reader, &domain);
+}
+
+static void test_reader_limits(void) {
+        _c_cleanup_(c_ini_reader_freep) CIniReader *reader = NULL;
+        _c_cleanup_(c_freep) char *data = NULL;
+        CIniLimits limits;
+        CIniDomain *domain;
+        const char *label;
+        size_t n_data;
+        int r;
+
+        /* limits are inclusive, and all of them are checked */
+        limits = (CIniLimits){ .max_line = 8 };
+        c_assert(!test_reader_limit(&limits, "[abcde]\nk=vvvvv\n", SIZE_MAX));
+        c_assert(test_reader_limit(&limits, "[abcdef]\n", SIZE_MAX) == C_INI_E_LIMIT);
+        c_assert(test_reader_limit(&limits, "k=vvvvvvv", SIZE_MAX) == C_INI_E_LIMIT);
+        c_assert(test_reader_limit(&limits, "k=vvvvvv\n", 1) == C_INI_E_LIMIT);
+
+        limits = (CIniLimits){ .max_label = 3, .max_key = 2, .max_value = 1 };
+        c_assert(!test_reader_limit(&limits, "[abc]\nkk = v\n# comment\nmalformed\n", SIZE_MAX));
+        c_assert(test_reader_limit(&limits, "[abcd]\n", 3) == C_INI_E_LIMIT);
+        c_assert(test_reader_limit(&limits, "kkk=v\n", SIZE_MAX) == C_INI_E_LIMIT);
+        c_assert(test_reader_limit(&limits, "k=vv\n", SIZE_MAX) == C_INI_E_LIMIT);
+
+        limits = (CIniLimits){ .max_groups = 2, .max_entries = 2 };
+        c_assert(!test_reader_limit(&limits, "a=b\nc=d\n[g]\na=b\nc=d\n[g]\na=b\nc=d\n", SIZE_MAX));
+        c_assert(test_reader_limit(&limits, "[a]\n[b]\n[c]\n", SIZE_MAX) == C_INI_E_LIMIT);
+        c_assert(test_reader_limit(&limits, "[a]\na=b\nc=d\ne=f\n", SIZE_MAX) == C_INI_E_LIMIT);
+
+        /* entries are counted per group, even if it is merged or continued */
+        limits = (CIniLimits){ .max_entries = 2 };
+        r = c_ini_reader_new(&reader);
+        c_assert(!r);
+        c_ini_reader_set_mode(reader, C_INI_MODE_MERGE_GROUPS);
+        c_ini_reader_set_limits(reader, &limits);
+        r = c_ini_reader_feed(reader, (const uint8_t *)"[g]\na=b\n[h]\n[g]\nc=d\n", 20);
+        c_assert(!r);
+        r = c_ini_reader_feed(reader, (const uint8_t *)"e=f\n", 4);
+        c_assert(r == C_INI_E_LIMIT);
+        reader = c_ini_reader_free(reader);
+
+        r = c_ini_reader_new(&reader);
+        c_assert(!r);
+        c_ini_reader_set_limits(reader, &limits);
+        r = c_ini_reader_feed(reader, (const uint8_t *)"a=b\nc=d\n", 8);
+        c_assert(!r);
+        r = c_ini_reader_flush(reader);
+        c_assert(!r);
+        r = c_ini_reader_feed(reader, (const uint8_t *)"e=f\n", 4);
+        c_assert(r == C_INI_E_LIMIT);
+        reader = c_ini_reader_free(reader);
+
+        /* duplicates that replace or are discarded do not grow the group */
+        c_assert(!test_reader_limit(&limits, "[g]\na=b\nc=d\na=x\nc=y\n", SIZE_MAX));
+
+        r = c_ini_reader_new(&reader);
+        c_assert(!r);
+        c_ini_reader_set_mode(reader, C_INI_MODE_OVERRIDE_ENTRIES);
+        c_ini_reader_set_limits(reader, &limits);
+        r = c_ini_reader_feed(reader, (const uint8_t *)"[g]\na=b\nc=d\na=x\n", 16);
+        c_assert(!r);
+        r = c_ini_reader_seal(reader, &domain);
+        c_assert(!r);
+        c_assert(!strcmp(c_ini_entry_get_value(c_ini_group_find(c_ini_domain_find(domain, "g", -1), "a", -1), NULL), "x"));
+        domain = c_ini_domain_unref(domain);
+        r = c_ini_reader_feed(reader, (const uint8_t *)"[g]\na=b\nc=d\ne=f\n", 16);
+        c_assert(r == C_INI_E_LIMIT);
+        reader = c_ini_reader_free(reader);
+
+        r = c_ini_reader_new(&reader);
+        c_assert(!r);
+        c_ini_reader_set_mode(reader, C_INI_MODE_KEEP_DUPLICATE_ENTRIES);
+        c_ini_reader_set_limits(reader, &limits);
+        r = c_ini_reader_feed(reader, (const uint8_t *)"[g]\na=b\nc=d\na=x\n", 16);
+        c_assert(r == C_INI_E_LIMIT);
+        reader = c_ini_reader_free(reader);
+
+        limits = (CIniLimits){ .max_bytes = 12 };
+        c_assert(!test_reader_limit(&limits, "[g]\na=b\n\n\n\n\n", SIZE_MAX));
+        c_assert(test_reader_limit(&limits, "[g]\na=b\n\n\n\n\n\n", SIZE_MAX) == C_INI_E_LIMIT);
+        c_assert(test_reader_limit(&limits, "[g]\na=b\n\n\n\n\n\n", 1) == C_INI_E_LIMIT);
+
+        /* overlong lines are refused before they are buffered */
+        data = test_reader_generate(256 * 1024, &n_data);
+        memset(data, 'x', n_data);
+
+        r = c_ini_reader_new(&reader);
+        c_assert(!r);
+        c_ini_reader_set_limits(reader, &(CIniLimits){ .max_line = 1024 });
+        r = c_ini_reader_feed(reader, (const uint8_t *)data, n_data);
+        c_assert(r == C_INI_E_LIMIT);
+        c_assert(!reader->z_line);
+        reader = c_ini_reader_free(reader);
+
+        /* parallel feeds are subject to the limits as well */
+        free(data);
+        data = test_reader_generate(1024 * 1024, &n_data);
+
+        r = c_ini_reader_new(&reader);
+        c_assert(!r);
+        c_ini_reader_set_limits(reader, &(CIniLimits){ .max_bytes = n_data - 1 });
+        r = c_ini_reader_feed_parallel(reader, (const uint8_t *)data, n_data, 4);
+        c_assert(r == C_INI_E_LIMIT);
+        reader = c_ini_reader_free(reader);
+
+        r = c_ini_reader_new(&reader);
+        c_assert(!r);
+        c_ini_reader_set_limits(reader, &(CIniLimits){ .max_bytes = n_data });
+        r = c_ini_reader_feed_parallel(reader, (const uint8_t *)data, n_data, 4);
+        c_assert(!r);
+        r = c_ini_reader_seal(reader, &domain);
+        c_assert(!r);
+        c_ini_domain_unref(domain);
+
+        /* the serial fallback still borrows the data, if requested */
+        c_ini_reader_set_mode(reader, C_INI_MODE_BORROW_DATA);
+        r = c_ini_reader_feed_parallel(reader, (const uint8_t *)data, n_data, 4);
+        c_assert(!r);
+        r = c_ini_reader_seal(reader, &domain);
+        c_assert(!r);
+        label = c_ini_group_get_label(c_ini_domain_iterate(domain), NULL);
+        c_assert(label >= data && label < data + n_data);
+        c_ini_domain_unref(domain);
+        c_ini_reader_set_mode(reader, 0);
+
+        /* the accounting starts over with each parsing round */
+        r = c_ini_reader_feed(reader, (const uint8_t *)data, n_data);
+        c_assert(!r);
+        r = c_ini_reader_seal(reader, &domain);
+        c_assert(!r);
+        c_ini_domain_unref(domain);
+
+        /* and limits can be cleared */
+        c_ini_reader_set_limits(reader, NULL);
+        r = c_ini_reader_feed(reader, (const uint8_t *)data, n_data);
+        c_assert(!r);
+        r = c_ini_reader_feed(reader, (const uint8_t *)data, n_data);
+        c_assert(!r);
+        r = c_ini_reader_seal(reader, &domain);
+        c_assert(!r);
+        c_ini_domain_unref(domain);
+}
+
 int main(int argc, char *argv[]) {
         test_reader_normal_whitespace();
         test_reader_extended_whitespace();
+        test_reader_borrow();
+        test_reader_chunks();
+        test_reader_fd();
+        test_reader_parallel();
+        test_reader_index();
+        test_reader_freeze();
+        test_reader_dropins();
+        test_reader_cache();
+        test_reader_write();
+        test_reader_reuse();
+        test_reader_diff();
+        test_reader_watch();
+        test_reader_callbacks();
+        test_reader_tokenizer();
+        test_reader_limits();
         return 0;
 }
@@ -0,0 +1,264 @@
+/*
+ * Tests for Thread Safety
+ * This test runs concurrent lookups on shared domains from multiple threads,
+ * verifying that sealed domains can be queried without synchronization. If
+ * built with atomic reference counters, the threads additionally acquire and
+ * release references, and the last thread destroys the domain.
+ */
+
+#undef NDEBUG
+#include <assert.h>
+#include <c-stdaux.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "c-ini.h"
+#include "c-ini-private.h"
+
+#define TEST_THREADS_N_THREADS (8U)
+#define TEST_THREADS_N_GROUPS (64U)
+#define TEST_THREADS_N_ENTRIES (32U)
+#define TEST_THREADS_N_ROUNDS (20000U)
+
+typedef struct TestThreadsLookup TestThreadsLookup;
+typedef struct TestThreadsWatch TestThreadsWatch;
+
+struct TestThreadsLookup {
+        CIniDomain *domain;
+        unsigned int seed;
+};
+
+struct TestThreadsWatch {
+        CIniWatch *watch;
+        atomic_bool done;
+};
+
+static char *test_threads_generate(unsigned int version, size_t *n_datap) {
+        char *data = NULL;
+        size_t n_data = 0;
+        unsigned int i, j;
+        FILE *f;
+
+        f = open_memstream(&data, &n_data);
+        c_assert(f);
+
+        for (i = 0; i < TEST_THREADS_N_GROUPS; ++i) {
+                fprintf(f, "[group%u]\n", i);
+                for (j = 0; j < TEST_THREADS_N_ENTRIES; ++j)
+                        fprintf(f, "key%u=value%u-%u-%u\n", j, i, j, version);
+        }
+
+        c_assert(!fclose(f));
+
+        *n_datap = n_data;
+        return data;
+}
+
+static CIniDomain *test_threads_parse(unsigned int mode) {
+        _c_cleanup_(c_freep) char *data = NULL;
+        CIniDomain *domain;
+        size_t n_data;
+        int r;
+
+        data = test_threads_generate(0, &n_data);
+        r = c_ini_reader_parse(&domain, mode, (const uint8_t *)data, n_data);
+        c_assert(!r);
+
+        return domain;
+}
+
+static unsigned int test_threads_lookup(CIniDomain *domain, unsigned int *seed, bool ref) {
+        char label[64], key[64], value[64];
+        unsigned int g, e, version;
+        CIniEntry *found, *entry;
+        CIniGroup *group;
+        const char *v;
+        uint64_t u;
+        size_t n;
+
+        g = rand_r(seed) % TEST_THREADS_N_GROUPS;
+        e = rand_r(seed) % TEST_THREADS_N_ENTRIES;
+        snprintf(label, sizeof(label), "group%u", g);
+        snprintf(key, sizeof(key), "key%u", e);
+
+        group = c_ini_domain_find(domain, label, -1);
+        c_assert(group);
+        found = c_ini_group_find(group, key, -1);
+        c_assert(found);
+
+        if (ref) {
+                c_ini_group_ref(group);
+                c_ini_entry_ref(found);
+        }
+
+        v = c_ini_entry_get_value(found, &n);
+        c_assert(sscanf(v, "value%*u-%*u-%u", &version) == 1);
+        snprintf(value, sizeof(value), "value%u-%u-%u", g, e, version);
+        c_assert(n == strlen(value) && !memcmp(v, value, n));
+
+        /* typed and decoded values are cached concurrently */
+        c_assert(c_ini_entry_get_uint64(found, &u) == -EINVAL);
+        c_assert(!c_ini_entry_get_string(found, &v, &n) && n == strlen(value));
+
+        /* walk the group, which must not change underneath */
+        n = 0;
+        for (entry = c_ini_group_iterate(group); entry; entry = c_ini_entry_next(entry))
+                ++n;
+        c_assert(n == TEST_THREADS_N_ENTRIES);
+
+        if (ref) {
+                c_ini_entry_unref(found);
+                c_ini_group_unref(group);
+        }
+
+        return version;
+}
+
+static void *test_threads_lookup_fn(void *userdata) {
+        TestThreadsLookup *lookup = userdata;
+        unsigned int i;
+
+        for (i = 0; i < TEST_THREADS_N_ROUNDS; ++i)
+                test_threads_lookup(lookup->domain, &lookup->seed, C_INI_ATOMIC_REFS);
+
+        /* with atomic references, the last thread destroys the domain */
+        if (C_INI_ATOMIC_REFS)
+                c_ini_domain_unref(lookup->domain);
+
+        return NULL;
+}
+
+static void test_threads_run_lookups(CIniDomain *domain) {
+        TestThreadsLookup lookups[TEST_THREADS_N_THREADS];
+        pthread_t threads[TEST_THREADS_N_THREADS];
+        unsigned int i;
+        int r;
+
+        for (i = 0; i < TEST_THREADS_N_THREADS; ++i) {
+                lookups[i] = (TestThreadsLookup){
+                        .domain = C_INI_ATOMIC_REFS ? c_ini_domain_ref(domain) : domain,
+                        .seed = i,
+                };
+                r = pthread_create(&threads[i], NULL, test_threads_lookup_fn, &lookups[i]);
+                c_assert(!r);
+        }
+
+        if (C_INI_ATOMIC_REFS)
+                c_ini_domain_unref(domain);
+
+        for (i = 0; i < TEST_THREADS_N_THREADS; ++i) {
+                r = pthread_join(threads[i], NULL);
+                c_assert(!r);
+        }
+
+        if (!C_INI_ATOMIC_REFS)
+                c_ini_domain_unref(domain);
+}
+
+static void test_threads_lookups(void) {
+        CIniDomain *domain, *frozen;
+        int r;
+
+        /* the lookup trees */
+        domain = test_threads_parse(0);
+        test_threads_run_lookups(domain);
+
+        /* the hash indices */
+        domain = test_threads_parse(C_INI_MODE_HASH_INDEX);
+        test_threads_run_lookups(domain);
+
+        /* the frozen block */
+        domain = test_threads_parse(0);
+        r = c_ini_domain_freeze(domain, &frozen);
+        c_assert(!r);
+        c_ini_domain_unref(domain);
+        test_threads_run_lookups(frozen);
+}
+
+static void *test_threads_watch_fn(void *userdata) {
+        TestThreadsWatch *watch = userdata;
+        unsigned int seed = (unsigned int)(uintptr_t)&seed;
+        unsigned int version, previous = 0;
+        CIniSnapshot *snapshot;
+
+        while (!atomic_load(&watch->done)) {
+                snapshot = c_ini_watch_acquire(watch->watch);
+
+                /* a snapshot is consistent, and never goes back in time */
+                version = test_threads_lookup(c_ini_snapshot_get_domain(snapshot), &seed, false);
+                c_assert(version == test_threads_lookup(c_ini_snapshot_get_domain(snapshot), &seed, false));
+                c_assert(version >= previous);
+                previous = version;
+
+                c_ini_snapshot_release(snapshot);
+        }
+
+        return NULL;
+}
+
+static void test_threads_watch(void) {
+        _c_cleanup_(c_ini_watch_freep) CIniWatch *w = NULL;
+        pthread_t threads[TEST_THREADS_N_THREADS];
+        char root[] = "/tmp/test-c-ini-XXXXXX", path[4096];
+        const char *paths[] = { path, NULL };
+        TestThreadsWatch watch = {};
+        unsigned int i;
+        char *data;
+        size_t n_data;
+        FILE *f;
+        int r;
+
+        c_assert(mkdtemp(root));
+        snprintf(path, sizeof(path), "%s/threads.conf", root);
+
+        data = test_threads_generate(0, &n_data);
+        f = fopen(path, "we");
+        c_assert(f);
+        c_assert(fwrite(data, 1, n_data, f) == n_data);
+        c_assert(!fclose(f));
+        free(data);
+
+        r = c_ini_watch_new(&w, 0, paths);
+        c_assert(!r);
+
+        watch.watch = w;
+        atomic_init(&watch.done, false);
+
+        for (i = 0; i < TEST_THREADS_N_THREADS; ++i) {
+                r = pthread_create(&threads[i], NULL, test_threads_watch_fn, &watch);
+                c_assert(!r);
+        }
+
+        /* republish new versions while the readers keep acquiring snapshots */
+        for (i = 1; i <= 64; ++i) {
+                data = test_threads_generate(i, &n_data);
+                f = fopen(path, "we");
+                c_assert(f);
+                c_assert(fwrite(data, 1, n_data, f) == n_data);
+                c_assert(!fclose(f));
+                free(data);
+
+                r = c_ini_watch_reload(w);
+                c_assert(!r);
+        }
+
+        atomic_store(&watch.done, true);
+
+        for (i = 0; i < TEST_THREADS_N_THREADS; ++i) {
+                r = pthread_join(threads[i], NULL);
+                c_assert(!r);
+        }
+
+        c_assert(!unlink(path));
+        c_assert(!rmdir(root));
+}
+
+int main(int argc, char *argv[]) {
+        test_threads_lookups();
+        test_threads_watch();
+        return 0;
+}